@@ -0,0 +1,344 @@
+#include <cstdlib>
+#include <cstddef>
+#include <algorithm>
+#include <utility>
+
+#include "acmacs-base/brotli.hh"
+
+// ----------------------------------------------------------------------
+
+namespace acmacs::file::brotli_internal
+{
+    constexpr size_t BlockHeader = alignof(std::max_align_t); // capacity is stored in front of the block, keeps returned address aligned
+    constexpr size_t MaxCached = 256 * 1024 * 1024;          // blocks released beyond that are returned to the system
+    constexpr size_t MinOutputChunk = 4096;
+
+    static inline size_t& block_capacity(void* block) { return *reinterpret_cast<size_t*>(block); }
+
+} // namespace acmacs::file::brotli_internal
+
+// ----------------------------------------------------------------------
+
+acmacs::file::brotli_internal::memory_pool::~memory_pool()
+{
+    for (auto* block : free_)
+        std::free(block);
+
+} // acmacs::file::brotli_internal::memory_pool::~memory_pool
+
+// ----------------------------------------------------------------------
+
+// the smallest cached block of at least size (and not more than twice larger) is reused
+void* acmacs::file::brotli_internal::memory_pool::allocate(void* pool, size_t size)
+{
+    auto& self = *reinterpret_cast<memory_pool*>(pool);
+    auto best = self.free_.end();
+    for (auto it = self.free_.begin(); it != self.free_.end(); ++it) {
+        if (const auto capacity = block_capacity(*it); capacity >= size && capacity <= (size * 2) && (best == self.free_.end() || capacity < block_capacity(*best)))
+            best = it;
+    }
+    void* block;
+    if (best != self.free_.end()) {
+        block = *best;
+        self.cached_ -= block_capacity(block);
+        *best = self.free_.back();
+        self.free_.pop_back();
+    }
+    else {
+        block = std::malloc(size + BlockHeader);
+        if (!block)
+            return nullptr;
+        block_capacity(block) = size;
+    }
+    return reinterpret_cast<char*>(block) + BlockHeader;
+
+} // acmacs::file::brotli_internal::memory_pool::allocate
+
+// ----------------------------------------------------------------------
+
+void acmacs::file::brotli_internal::memory_pool::release(void* pool, void* address)
+{
+    if (!address)
+        return;
+    auto& self = *reinterpret_cast<memory_pool*>(pool);
+    void* block = reinterpret_cast<char*>(address) - BlockHeader;
+    if ((self.cached_ + block_capacity(block)) > MaxCached) {
+        std::free(block);
+    }
+    else {
+        self.cached_ += block_capacity(block);
+        self.free_.push_back(block);
+    }
+
+} // acmacs::file::brotli_internal::memory_pool::release
+
+// ======================================================================
+
+acmacs::file::brotli_encoder::brotli_encoder(int quality, int lgwin)
+    : quality_{std::clamp(quality, BROTLI_MIN_QUALITY, BROTLI_MAX_QUALITY)}, lgwin_{std::clamp(lgwin, BROTLI_MIN_WINDOW_BITS, BROTLI_MAX_WINDOW_BITS)}, pool_{std::make_unique<brotli_internal::memory_pool>()}
+{
+} // acmacs::file::brotli_encoder::brotli_encoder
+
+// ----------------------------------------------------------------------
+
+acmacs::file::brotli_encoder::~brotli_encoder()
+{
+    if (state_)
+        BrotliEncoderDestroyInstance(state_);
+
+} // acmacs::file::brotli_encoder::~brotli_encoder
+
+// ----------------------------------------------------------------------
+
+acmacs::file::brotli_encoder::brotli_encoder(brotli_encoder&& rhs) noexcept
+    : quality_{rhs.quality_}, lgwin_{rhs.lgwin_}, size_hint_{rhs.size_hint_}, pool_{std::move(rhs.pool_)}, state_{std::exchange(rhs.state_, nullptr)}
+{
+} // acmacs::file::brotli_encoder::brotli_encoder
+
+// ----------------------------------------------------------------------
+
+acmacs::file::brotli_encoder& acmacs::file::brotli_encoder::operator=(brotli_encoder&& rhs) noexcept
+{
+    if (this != &rhs) {
+        if (state_)
+            BrotliEncoderDestroyInstance(state_); // before pool_ is replaced
+        quality_ = rhs.quality_;
+        lgwin_ = rhs.lgwin_;
+        size_hint_ = rhs.size_hint_;
+        pool_ = std::move(rhs.pool_);
+        state_ = std::exchange(rhs.state_, nullptr);
+    }
+    return *this;
+
+} // acmacs::file::brotli_encoder::operator=
+
+// ----------------------------------------------------------------------
+
+void acmacs::file::brotli_encoder::process(std::string_view input, BrotliEncoderOperation operation, std::string& output)
+{
+    using namespace brotli_internal;
+
+    if (!state_) {
+        if (!pool_) // moved from
+            pool_ = std::make_unique<memory_pool>();
+        state_ = BrotliEncoderCreateInstance(&memory_pool::allocate, &memory_pool::release, pool_.get());
+        if (!state_)
+            throw BrotliError{"brotli compression failed during initialization"};
+        BrotliEncoderSetParameter(state_, BROTLI_PARAM_QUALITY, static_cast<uint32_t>(quality_));
+        BrotliEncoderSetParameter(state_, BROTLI_PARAM_LGWIN, static_cast<uint32_t>(lgwin_));
+        if (size_hint_ > 0)
+            BrotliEncoderSetParameter(state_, BROTLI_PARAM_SIZE_HINT, static_cast<uint32_t>(std::min(size_hint_, static_cast<size_t>(1u << 30))));
+        size_hint_ = 0;
+    }
+
+    size_t available_in = input.size();
+    const auto* next_in = reinterpret_cast<const uint8_t*>(input.data());
+    size_t used = output.size();
+    // finishing in one go: max compressed size avoids growing output, otherwise output grows geometrically
+    const auto bound = operation == BROTLI_OPERATION_FINISH ? BrotliEncoderMaxCompressedSize(input.size()) : 0;
+    output.resize(used + std::max(bound > 0 ? bound : input.size() / 4, MinOutputChunk));
+    for (;;) {
+        auto* next_out = reinterpret_cast<uint8_t*>(output.data() + used);
+        size_t available_out = output.size() - used;
+        if (BrotliEncoderCompressStream(state_, operation, &available_in, &next_in, &available_out, &next_out, nullptr) == BROTLI_FALSE) {
+            BrotliEncoderDestroyInstance(state_);
+            state_ = nullptr;
+            output.resize(used);
+            throw BrotliError{"brotli compression failed"};
+        }
+        used = output.size() - available_out;
+        if (operation == BROTLI_OPERATION_FINISH ? BrotliEncoderIsFinished(state_) == BROTLI_TRUE : (available_in == 0 && BrotliEncoderHasMoreOutput(state_) == BROTLI_FALSE))
+            break;
+        if (available_out == 0)
+            output.resize(output.size() * 2);
+    }
+    output.resize(used);
+
+} // acmacs::file::brotli_encoder::process
+
+// ----------------------------------------------------------------------
+
+void acmacs::file::brotli_encoder::finish(std::string& output)
+{
+    process({}, BROTLI_OPERATION_FINISH, output);
+    BrotliEncoderDestroyInstance(state_); // memory goes to pool_ for the next stream
+    state_ = nullptr;
+
+} // acmacs::file::brotli_encoder::finish
+
+// ----------------------------------------------------------------------
+
+void acmacs::file::brotli_encoder::compress(std::string_view input, std::string& output)
+{
+    output.clear();
+    if (!state_ && size_hint_ == 0)
+        size_hint_ = input.size();
+    process(input, BROTLI_OPERATION_FINISH, output);
+    BrotliEncoderDestroyInstance(state_);
+    state_ = nullptr;
+
+} // acmacs::file::brotli_encoder::compress
+
+// ----------------------------------------------------------------------
+
+std::string acmacs::file::brotli_encoder::compress(std::string_view input)
+{
+    std::string output;
+    compress(input, output);
+    return output;
+
+} // acmacs::file::brotli_encoder::compress
+
+// ======================================================================
+
+acmacs::file::brotli_decoder::brotli_decoder()
+    : pool_{std::make_unique<brotli_internal::memory_pool>()}
+{
+} // acmacs::file::brotli_decoder::brotli_decoder
+
+// ----------------------------------------------------------------------
+
+acmacs::file::brotli_decoder::~brotli_decoder()
+{
+    reset();
+
+} // acmacs::file::brotli_decoder::~brotli_decoder
+
+// ----------------------------------------------------------------------
+
+acmacs::file::brotli_decoder::brotli_decoder(brotli_decoder&& rhs) noexcept
+    : pool_{std::move(rhs.pool_)}, state_{std::exchange(rhs.state_, nullptr)}
+{
+} // acmacs::file::brotli_decoder::brotli_decoder
+
+// ----------------------------------------------------------------------
+
+acmacs::file::brotli_decoder& acmacs::file::brotli_decoder::operator=(brotli_decoder&& rhs) noexcept
+{
+    if (this != &rhs) {
+        reset(); // before pool_ is replaced
+        pool_ = std::move(rhs.pool_);
+        state_ = std::exchange(rhs.state_, nullptr);
+    }
+    return *this;
+
+} // acmacs::file::brotli_decoder::operator=
+
+// ----------------------------------------------------------------------
+
+void acmacs::file::brotli_decoder::reset()
+{
+    if (state_) {
+        BrotliDecoderDestroyInstance(state_); // memory goes to pool_ for the next stream
+        state_ = nullptr;
+    }
+
+} // acmacs::file::brotli_decoder::reset
+
+// ----------------------------------------------------------------------
+
+bool acmacs::file::brotli_decoder::push(std::string_view input, std::string& output)
+{
+    using namespace brotli_internal;
+
+    if (!state_) {
+        if (!pool_) // moved from
+            pool_ = std::make_unique<memory_pool>();
+        state_ = BrotliDecoderCreateInstance(&memory_pool::allocate, &memory_pool::release, pool_.get());
+        if (!state_)
+            throw BrotliError{"brotli decompression failed during initialization"};
+    }
+
+    const auto* next_in = reinterpret_cast<const uint8_t*>(input.data());
+    size_t available_in = input.size();
+    size_t used = output.size();
+    output.resize(used + std::max(input.size() * 4, MinOutputChunk));
+    BrotliDecoderResult result;
+    for (;;) {
+        auto* next_out = reinterpret_cast<uint8_t*>(output.data() + used);
+        size_t available_out = output.size() - used;
+        result = BrotliDecoderDecompressStream(state_, &available_in, &next_in, &available_out, &next_out, nullptr);
+        used = output.size() - available_out;
+        // when the input is consumed and output is full, decoder reports NEEDS_MORE_INPUT even if it holds more output
+        if (result != BROTLI_DECODER_RESULT_NEEDS_MORE_OUTPUT && (result != BROTLI_DECODER_RESULT_NEEDS_MORE_INPUT || BrotliDecoderHasMoreOutput(state_) == BROTLI_FALSE))
+            break;
+        output.resize(output.size() * 2);
+    }
+    output.resize(used);
+
+    switch (result) {
+        case BROTLI_DECODER_RESULT_SUCCESS:
+            reset();
+            if (available_in > 0)
+                throw BrotliError{fmt::format("brotli decompression failed: {} bytes after the end of stream", available_in)};
+            return true;
+        case BROTLI_DECODER_RESULT_NEEDS_MORE_INPUT:
+            return false;
+        case BROTLI_DECODER_RESULT_ERROR:
+        case BROTLI_DECODER_RESULT_NEEDS_MORE_OUTPUT:
+            break;
+    }
+    const std::string error{BrotliDecoderErrorString(BrotliDecoderGetErrorCode(state_))};
+    reset();
+    throw BrotliError{fmt::format("brotli decompression failed: {}", error)};
+
+} // acmacs::file::brotli_decoder::push
+
+// ----------------------------------------------------------------------
+
+void acmacs::file::brotli_decoder::finish()
+{
+    if (state_) {
+        reset();
+        throw BrotliError{"brotli decompression failed: unexpected end of input"};
+    }
+
+} // acmacs::file::brotli_decoder::finish
+
+// ----------------------------------------------------------------------
+
+void acmacs::file::brotli_decoder::decompress(std::string_view input, std::string& output)
+{
+    output.clear();
+    if (!push(input, output)) {
+        reset();
+        throw BrotliError{"brotli decompression failed: unexpected end of input"};
+    }
+
+} // acmacs::file::brotli_decoder::decompress
+
+// ----------------------------------------------------------------------
+
+std::string acmacs::file::brotli_decoder::decompress(std::string_view input)
+{
+    std::string output;
+    decompress(input, output);
+    return output;
+
+} // acmacs::file::brotli_decoder::decompress
+
+// ======================================================================
+
+std::string acmacs::file::brotli_compress(std::string_view input, const compression_policy& policy)
+{
+    return brotli_encoder{policy}.compress(input);
+
+} // acmacs::file::brotli_compress
+
+// ----------------------------------------------------------------------
+
+void acmacs::file::brotli_decompress(std::string_view input, std::string& output, bool check_if_compressed)
+{
+    brotli_decoder decoder;
+    output.clear();
+    const auto finished = decoder.push(input, output);
+    if (check_if_compressed ? (!finished || !output.empty()) : finished)
+        return;
+    throw BrotliError{"brotli decompression failed: unexpected end of input"};
+
+} // acmacs::file::brotli_decompress
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
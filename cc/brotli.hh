@@ -4,6 +4,8 @@
 #include <string>
 #include <string_view>
 #include <stdexcept>
+#include <memory>
+#include <vector>
 
 #pragma GCC diagnostic push
 #ifdef __clang__
@@ -17,6 +19,7 @@
 #pragma GCC diagnostic pop
 
 #include "acmacs-base/fmt.hh"
+#include "acmacs-base/compression.hh"
 
 // ----------------------------------------------------------------------
 
@@ -24,55 +27,111 @@ namespace acmacs::file
 {
     struct BrotliError : public std::runtime_error { using std::runtime_error::runtime_error; };
 
+    namespace brotli_internal
+    {
+        // brotli has no API to reset encoder/decoder state, a new instance is created for every stream.
+        // Memory released by the previous instance is kept here and handed to the next one, so that
+        // per-record compression with the same encoder object does not allocate and page-fault hash tables for every record.
+        class memory_pool
+        {
+          public:
+            memory_pool() = default;
+            ~memory_pool();
+            memory_pool(const memory_pool&) = delete;
+            memory_pool& operator=(const memory_pool&) = delete;
+
+            static void* allocate(void* pool, size_t size);
+            static void release(void* pool, void* address);
+
+          private:
+            std::vector<void*> free_; // blocks with their capacity stored in front of them
+            size_t cached_{0};        // total capacity of blocks in free_
+        };
+
+    } // namespace brotli_internal
+
       // ----------------------------------------------------------------------
 
-    inline std::string brotli_compress(std::string_view input)
+    // quality: fastest - 1, balanced - 5, best - 11, explicit level is clamped to 0-11
+    constexpr compression_levels brotli_levels{.fastest = 1, .balanced = 5, .best = BROTLI_MAX_QUALITY, .min = BROTLI_MIN_QUALITY, .max = BROTLI_MAX_QUALITY};
+
+    // Streaming encoder, push() may be called any number of times, finish() completes the stream and the next push() starts a new one
+    // with the same parameters reusing memory of the previous one.
+    class brotli_encoder
     {
-        std::string output(std::min(input.size() / 2 + 1, 1024ul * 1024), 0);
-        BrotliEncoderState* state = BrotliEncoderCreateInstance(nullptr, nullptr, nullptr);
-        size_t available_in = input.size();
-        const auto* next_in = reinterpret_cast<const uint8_t*>(input.data());
-        auto* next_out = reinterpret_cast<uint8_t*>(output.data());
-        size_t available_out = output.size();
-        while (!BrotliEncoderIsFinished(state)) {
-            if (BrotliEncoderCompressStream(state, BROTLI_OPERATION_FINISH, &available_in, &next_in, &available_out, &next_out, nullptr) == BROTLI_FALSE)
-                throw BrotliError{fmt::format("BrotliCompress failed")};
-            if (available_out == 0) {
-                const auto used = output.size();
-                output.resize(used * 2, 0);
-                next_out = reinterpret_cast<uint8_t*>(output.data() + used);
-                available_out = output.size() - used;
-            }
-        }
-        BrotliEncoderDestroyInstance(state);
-        output.resize(output.size() - available_out);
-        return output;
-    }
+      public:
+        explicit brotli_encoder(int quality = BROTLI_DEFAULT_QUALITY, int lgwin = BROTLI_DEFAULT_WINDOW);
+        explicit brotli_encoder(const compression_policy& policy, int lgwin = BROTLI_DEFAULT_WINDOW) : brotli_encoder(policy.level_for(brotli_levels), lgwin) {}
+        ~brotli_encoder();
+        brotli_encoder(const brotli_encoder&) = delete;
+        brotli_encoder(brotli_encoder&& rhs) noexcept;
+        brotli_encoder& operator=(const brotli_encoder&) = delete;
+        brotli_encoder& operator=(brotli_encoder&& rhs) noexcept;
+
+        void size_hint(size_t size) { size_hint_ = size; } // expected size of the next stream, improves compression of small payloads
+
+        // compressed data available so far is appended to output
+        void push(std::string_view input, std::string& output) { process(input, BROTLI_OPERATION_PROCESS, output); }
+        void flush(std::string& output) { process({}, BROTLI_OPERATION_FLUSH, output); } // everything pushed so far becomes decodable
+        void finish(std::string& output);
+
+        // whole stream: push(input) + finish(), output content is replaced
+        void compress(std::string_view input, std::string& output);
+        std::string compress(std::string_view input);
+
+      private:
+        int quality_;
+        int lgwin_;
+        size_t size_hint_{0};
+        std::unique_ptr<brotli_internal::memory_pool> pool_;
+        BrotliEncoderState* state_{nullptr}; // created on the first push of a stream
+
+        void process(std::string_view input, BrotliEncoderOperation operation, std::string& output);
+    };
 
       // ----------------------------------------------------------------------
 
+    // Streaming decoder, input of a stream may be pushed in pieces, end of stream resets the decoder for the next stream.
+    class brotli_decoder
+    {
+      public:
+        brotli_decoder();
+        ~brotli_decoder();
+        brotli_decoder(const brotli_decoder&) = delete;
+        brotli_decoder(brotli_decoder&& rhs) noexcept;
+        brotli_decoder& operator=(const brotli_decoder&) = delete;
+        brotli_decoder& operator=(brotli_decoder&& rhs) noexcept;
+
+        // decompressed data is appended to output, returns true if end of the stream is reached, throws BrotliError on invalid input or data after the end of the stream
+        bool push(std::string_view input, std::string& output);
+        void finish(); // throws BrotliError if the stream is incomplete, resets the decoder
+
+        // whole stream, output content is replaced
+        void decompress(std::string_view input, std::string& output);
+        std::string decompress(std::string_view input);
+
+      private:
+        std::unique_ptr<brotli_internal::memory_pool> pool_;
+        BrotliDecoderState* state_{nullptr}; // created on the first push of a stream
+
+        void reset();
+    };
+
+      // ----------------------------------------------------------------------
+
+    // compression is single threaded
+    std::string brotli_compress(std::string_view input, const compression_policy& policy = default_compression_policy());
+
+    // brotli does not record uncompressed size, output grows geometrically
+    // decompresses into output replacing its content, capacity of output is reused
+    // check_if_compressed: input may be a truncated stream (used by brotli_compressed())
+    void brotli_decompress(std::string_view input, std::string& output, bool check_if_compressed = false);
+
     inline std::string brotli_decompress(std::string_view input, bool check_if_compressed = false)
     {
         std::string output;
-        BrotliDecoderState* state = BrotliDecoderCreateInstance(nullptr, nullptr, nullptr);
-        BrotliDecoderResult result = BROTLI_DECODER_RESULT_NEEDS_MORE_OUTPUT;
-        const uint8_t* next_in = reinterpret_cast<const uint8_t*>(input.data());
-        // const auto* next_in = input.data();
-        size_t available_in = input.size();
-        while (result == BROTLI_DECODER_RESULT_NEEDS_MORE_OUTPUT) {
-            size_t available_out = 0;
-            result = BrotliDecoderDecompressStream(state, &available_in, &next_in, &available_out, nullptr, nullptr);
-            const uint8_t* next_out = BrotliDecoderTakeOutput(state, &available_out);
-            // fmt::print(">>>> result: {} available_out: {}\n", result, available_out);
-            if (available_out != 0)
-                output.insert(output.end(), next_out, next_out + available_out);
-        }
-        BrotliDecoderDestroyInstance(state);
-        if (check_if_compressed && ((result == BROTLI_DECODER_RESULT_SUCCESS && !output.empty()) || result == BROTLI_DECODER_RESULT_NEEDS_MORE_INPUT))
-            return output;
-        else if (result == BROTLI_DECODER_RESULT_SUCCESS && !available_in)
-            return output;
-        throw BrotliError{fmt::format("BrotliDecompress failed: {}", result)};
+        brotli_decompress(input, output, check_if_compressed);
+        return output;
     }
 
     // ----------------------------------------------------------------------
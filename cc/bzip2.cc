@@ -0,0 +1,233 @@
+#include <stdexcept>
+#include <limits>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <algorithm>
+#include <bzlib.h>
+
+#include "acmacs-base/bzip2.hh"
+
+// ----------------------------------------------------------------------
+
+namespace acmacs::file::bz2_internal
+{
+    constexpr size_t BufSize = 409600;
+    constexpr size_t MaxChunk = std::numeric_limits<unsigned int>::max(); // avail_in and avail_out are 32 bit
+    constexpr size_t BlockUnit = 100000;                                   // bzip2 block size is level * 100k
+    constexpr const unsigned char sBlockMagic[] = {0x31, 0x41, 0x59, 0x26, 0x53, 0x59}; // BCD pi, starts every compressed block
+    constexpr const unsigned char sEndMagic[] = {0x17, 0x72, 0x45, 0x38, 0x50, 0x90};   // BCD sqrt(pi), end of stream (first block of an empty stream)
+
+    // calls func(task_no) for task_no in [0, number_of_tasks) using up to threads threads, the first exception is rethrown
+    template <typename F> static void parallel_for(size_t number_of_tasks, uint32_t threads, F&& func)
+    {
+        std::atomic<size_t> next_task{0};
+        std::exception_ptr error;
+        std::mutex error_access;
+
+        const auto worker = [&]() {
+            try {
+                for (auto task_no = next_task++; task_no < number_of_tasks; task_no = next_task++)
+                    func(task_no);
+            }
+            catch (std::exception&) {
+                std::lock_guard<std::mutex> lock{error_access};
+                if (!error)
+                    error = std::current_exception();
+                next_task = number_of_tasks;
+            }
+        };
+
+        std::vector<std::thread> workers;
+        for (uint32_t thread_no = 1; thread_no < std::min(static_cast<size_t>(threads), number_of_tasks); ++thread_no)
+            workers.emplace_back(worker);
+        worker();
+        for (auto& thread : workers)
+            thread.join();
+        if (error)
+            std::rethrow_exception(error);
+    }
+
+    static std::string compress_block(std::string_view input, int level);
+    static size_t decompress_stream(std::string_view input, std::string& output, size_t& offset);
+    static void decompress_serial(std::string_view input, std::string& output);
+    static std::vector<size_t> stream_starts(std::string_view input);
+
+} // namespace acmacs::file::bz2_internal
+
+// ----------------------------------------------------------------------
+
+std::string acmacs::file::bz2_compress(std::string_view input, const compression_policy& policy)
+{
+    using namespace bz2_internal;
+
+    const auto level = policy.level_for(bz2_levels);
+    const auto block_size = static_cast<size_t>(level) * BlockUnit;
+    if (input.size() <= block_size)
+        return compress_block(input, level);
+
+    const auto threads = policy.threads == 0 ? std::thread::hardware_concurrency() : policy.threads;
+    const size_t number_of_blocks = (input.size() + block_size - 1) / block_size;
+    std::vector<std::string> blocks(number_of_blocks);
+    parallel_for(number_of_blocks, threads, [&](size_t block_no) { blocks[block_no] = compress_block(input.substr(block_no * block_size, block_size), level); });
+
+    size_t compressed_size = 0;
+    for (const auto& block : blocks)
+        compressed_size += block.size();
+    std::string output;
+    output.reserve(compressed_size);
+    for (const auto& block : blocks)
+        output.append(block);
+    return output;
+
+} // acmacs::file::bz2_compress
+
+// ----------------------------------------------------------------------
+
+// input is at most 900k, i.e. always fits into 32 bit lengths
+std::string acmacs::file::bz2_internal::compress_block(std::string_view input, int level)
+{
+    std::string output(input.size() + input.size() / 100 + 600, ' '); // worst case size according to bzip2 manual
+    auto output_size = static_cast<unsigned int>(output.size());
+    if (const auto res = BZ2_bzBuffToBuffCompress(output.data(), &output_size, const_cast<char*>(input.data()), static_cast<unsigned int>(input.size()), level, 0 /* verbosity */,
+                                                  0 /* default work factor */);
+        res != BZ_OK)
+        throw std::runtime_error("bz2 compression failed, code: " + std::to_string(res));
+    output.resize(output_size);
+    return output;
+
+} // acmacs::file::bz2_internal::compress_block
+
+// ----------------------------------------------------------------------
+
+std::string acmacs::file::bz2_decompress(std::string_view input, uint32_t threads)
+{
+    std::string output;
+    bz2_decompress(input, output, threads);
+    return output;
+
+} // acmacs::file::bz2_decompress
+
+// ----------------------------------------------------------------------
+
+void acmacs::file::bz2_decompress(std::string_view input, std::string& output, uint32_t threads)
+{
+    using namespace bz2_internal;
+
+    if (threads == 0)
+        threads = std::thread::hardware_concurrency();
+    if (threads > 1) {
+        if (const auto starts = stream_starts(input); starts.size() > 1) {
+            try {
+                std::vector<std::string> streams(starts.size());
+                parallel_for(starts.size(), threads, [&](size_t stream_no) {
+                    const auto stream_end = stream_no + 1 < starts.size() ? starts[stream_no + 1] : input.size();
+                    const auto stream = input.substr(starts[stream_no], stream_end - starts[stream_no]);
+                    auto& part = streams[stream_no];
+                    part.resize(std::max(stream.size() * 4, BufSize));
+                    size_t offset = 0;
+                    if (decompress_stream(stream, part, offset) != stream.size())
+                        throw std::runtime_error("bz2 decompression failed: stream boundary mismatch"); // trailing garbage or false boundary
+                    part.resize(offset);
+                });
+                size_t total = 0;
+                for (const auto& part : streams)
+                    total += part.size();
+                output.resize(total);
+                size_t offset = 0;
+                for (const auto& part : streams) {
+                    std::memcpy(output.data() + offset, part.data(), part.size());
+                    offset += part.size();
+                }
+                return;
+            }
+            catch (std::exception&) {
+                // boundary detection is heuristic, serial decompression either succeeds or reports the actual problem
+            }
+        }
+    }
+    decompress_serial(input, output);
+
+} // acmacs::file::bz2_decompress
+
+// ----------------------------------------------------------------------
+
+// streams written by bzip2 and pbzip2 are byte aligned and start with "BZh", level digit and either block or end-of-stream magic
+std::vector<size_t> acmacs::file::bz2_internal::stream_starts(std::string_view input)
+{
+    constexpr size_t header_size = 4;
+    std::vector<size_t> starts{0};
+    for (auto pos = input.find("BZh", 1); pos != std::string_view::npos && (pos + header_size + sizeof(sBlockMagic)) <= input.size(); pos = input.find("BZh", pos + 1)) {
+        const auto* magic = input.data() + pos + header_size;
+        if (input[pos + 3] >= '1' && input[pos + 3] <= '9' && (std::memcmp(magic, sBlockMagic, sizeof(sBlockMagic)) == 0 || std::memcmp(magic, sEndMagic, sizeof(sEndMagic)) == 0))
+            starts.push_back(pos);
+    }
+    return starts;
+
+} // acmacs::file::bz2_internal::stream_starts
+
+// ----------------------------------------------------------------------
+
+void acmacs::file::bz2_internal::decompress_serial(std::string_view input, std::string& output)
+{
+    output.resize(std::max(input.size() * 4, BufSize));
+    size_t offset = 0, consumed = 0;
+    do {
+        consumed += decompress_stream(input.substr(consumed), output, offset);
+    } while ((input.size() - consumed) >= sizeof(sBz2Sig) && bz2_compressed(input.data() + consumed)); // bzip2 ignores trailing garbage after the last stream
+    output.resize(offset);
+
+} // acmacs::file::bz2_internal::decompress_serial
+
+// ----------------------------------------------------------------------
+
+// decompresses one stream writing to output starting at offset, output is doubled when full, returns number of input bytes consumed
+size_t acmacs::file::bz2_internal::decompress_stream(std::string_view input, std::string& output, size_t& offset)
+{
+    bz_stream strm;
+    strm.bzalloc = nullptr;
+    strm.bzfree = nullptr;
+    strm.opaque = nullptr;
+    if (BZ2_bzDecompressInit(&strm, 0 /*verbosity*/, 0 /* not small */) != BZ_OK)
+        throw std::runtime_error("bz2 decompression failed during initialization");
+    try {
+        size_t input_offset = 0;
+        strm.avail_in = 0;
+        bool output_pending = false; // previous call filled output completely and may have more to emit
+        for (;;) {
+            if (strm.avail_in == 0) {
+                if (input_offset == input.size() && !output_pending)
+                    throw std::runtime_error("bz2 decompression failed: unexpected end of input");
+                strm.next_in = const_cast<decltype(strm.next_in)>(input.data() + input_offset);
+                strm.avail_in = static_cast<decltype(strm.avail_in)>(std::min(input.size() - input_offset, MaxChunk));
+                input_offset += strm.avail_in;
+            }
+            if (offset == output.size())
+                output.resize(output.size() * 2);
+            const auto out_chunk = std::min(output.size() - offset, MaxChunk);
+            strm.next_out = output.data() + offset;
+            strm.avail_out = static_cast<decltype(strm.avail_out)>(out_chunk);
+            auto const r = BZ2_bzDecompress(&strm);
+            offset += out_chunk - strm.avail_out;
+            output_pending = strm.avail_out == 0;
+            if (r == BZ_STREAM_END)
+                break;
+            else if (r != BZ_OK)
+                throw std::runtime_error("bz2 decompression failed, code: " + std::to_string(r));
+        }
+        const auto consumed = input_offset - strm.avail_in;
+        BZ2_bzDecompressEnd(&strm);
+        return consumed;
+    }
+    catch (std::exception&) {
+        BZ2_bzDecompressEnd(&strm);
+        throw;
+    }
+
+} // acmacs::file::bz2_internal::decompress_stream
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
@@ -2,7 +2,10 @@
 
 #include <string>
 #include <string_view>
-#include <bzlib.h>
+#include <cstdint>
+#include <cstring>
+
+#include "acmacs-base/compression.hh"
 
 // ----------------------------------------------------------------------
 
@@ -23,57 +26,17 @@ namespace acmacs::file
 
       // ----------------------------------------------------------------------
 
-    inline std::string bz2_compress(std::string /*input*/)
-    {
-        throw std::runtime_error("acmacs::file::bz2_compress not implemented");
-        // lzma_stream strm = LZMA_STREAM_INIT; /* alloc and init lzma_stream struct */
-        // if (lzma_easy_encoder(&strm, 9 | LZMA_PRESET_EXTREME, LZMA_CHECK_CRC64) != LZMA_OK) {
-        //     throw std::runtime_error("lzma compression failed 1");
-        // }
-        // return xz_internal::process(&strm, input);
-    }
-
-      // ----------------------------------------------------------------------
-
-    inline std::string bz2_decompress(std::string_view input)
-    {
-        constexpr ssize_t BufSize = 409600;
-        bz_stream strm;
-        strm.bzalloc = nullptr;
-        strm.bzfree = nullptr;
-        strm.opaque = nullptr;
-        if (BZ2_bzDecompressInit(&strm, 0 /*verbosity*/, 0 /* not small */) != BZ_OK)
-            throw std::runtime_error("bz2 decompression failed during initialization");
-        try {
-            strm.next_in = const_cast<decltype(strm.next_in)>(input.data());
-            strm.avail_in = static_cast<decltype(strm.avail_in)>(input.size());
-            std::string output(BufSize, ' ');
-            ssize_t offset = 0;
-            for (;;) {
-                strm.next_out = const_cast<decltype(strm.next_out)>(&*(output.begin() + offset));
-                strm.avail_out = BufSize;
-                auto const r = BZ2_bzDecompress(&strm);
-                if (r == BZ_OK) {
-                    if (strm.avail_out > 0)
-                        throw std::runtime_error("bz2 decompression failed: unexpected end of input");
-                    offset += BufSize;
-                    output.resize(static_cast<size_t>(offset + BufSize));
-                }
-                else if (r == BZ_STREAM_END) {
-                    output.resize(static_cast<size_t>(offset + BufSize) - strm.avail_out);
-                    break;
-                }
-                else
-                    throw std::runtime_error("bz2 decompression failed, code: " + std::to_string(r));
-            }
-            BZ2_bzDecompressEnd(&strm);
-            return output;
-        }
-        catch (std::exception&) {
-            BZ2_bzDecompressEnd(&strm);
-            throw;
-        }
-    }
+      // levels (block size in 100k units): fastest - 1, balanced - 6, best - 9, explicit level is clamped to 1-9
+    constexpr compression_levels bz2_levels{.fastest = 1, .balanced = 6, .best = 9, .min = 1, .max = 9};
+      // pbzip2 style: input larger than one block is split into block sized pieces compressed in parallel into independent streams,
+      // result is a multi-stream .bz2 file (understood by bzip2 >= 1.0) and does not depend on the number of threads
+    std::string bz2_compress(std::string_view input, const compression_policy& policy = default_compression_policy());
+
+      // bzip2 does not record uncompressed size, output grows geometrically
+      // multi-stream input (pbzip2, concatenated .bz2 files) is decompressed by streams in parallel, threads: 0 - use all cpus
+      // decompresses into output replacing its content, capacity of output is reused
+    void bz2_decompress(std::string_view input, std::string& output, uint32_t threads = 0);
+    std::string bz2_decompress(std::string_view input, uint32_t threads = 0);
 
 } // namespace acmacs::file
 
@@ -1,3 +1,4 @@
+#include "acmacs-base/static-map.hh"
 #include "acmacs-base/color-amino-acid.hh"
 
 // ----------------------------------------------------------------------
@@ -81,12 +82,14 @@ std::string acmacs::amino_acid_nucleotide_color_css()
 
 // ----------------------------------------------------------------------
 
+static constexpr acmacs::static_map amino_acid_color_of{amino_acid_colors};
+static constexpr acmacs::static_map nucleotide_color_of{nucleotide_colors};
+
+// ----------------------------------------------------------------------
+
 Color acmacs::amino_acid_color(char aa)
 {
-    if (const auto found = std::find_if(std::begin(amino_acid_colors), std::end(amino_acid_colors), [aa](const auto& en) { return aa == en.first; }); found != std::end(amino_acid_colors))
-        return found->second;
-    else
-        return BLACK;
+    return amino_acid_color_of.get_or(aa, BLACK);
 
 } // acmacs::amino_acid_color
 
@@ -94,10 +97,7 @@ Color acmacs::amino_acid_color(char aa)
 
 Color acmacs::nucleotide_color(char nuc)
 {
-    if (const auto found = std::find_if(std::begin(nucleotide_colors), std::end(nucleotide_colors), [nuc](const auto& en) { return nuc == en.first; }); found != std::end(amino_acid_colors))
-        return found->second;
-    else
-        return BLACK;
+    return nucleotide_color_of.get_or(nuc, BLACK);
 
 } // acmacs::nucleotide_color
 
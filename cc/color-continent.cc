@@ -1,67 +1,75 @@
+#include "acmacs-base/static-map.hh"
 #include "acmacs-base/color-continent.hh"
 
 // ----------------------------------------------------------------------
 
-inline Color continent_color(std::string_view continent, const acmacs::continent_colors_t& data)
+using cc = std::pair<std::string_view, Color>;
+
+static constexpr std::array sContinentColorsTable{
+    cc{"EUROPE",            0x00FF00},
+    cc{"CENTRAL-AMERICA",   0xAAF9FF},
+    cc{"MIDDLE-EAST",       0x8000FF},
+    cc{"NORTH-AMERICA",     0x00008B},
+    cc{"AFRICA",            0xFF8000},
+    cc{"ASIA",              0xFF0000},
+    cc{"RUSSIA",            0xB03060},
+    cc{"AUSTRALIA-OCEANIA", 0xFF69B4},
+    cc{"SOUTH-AMERICA",     0x40E0D0},
+    cc{"ANTARCTICA",        0x808080},
+    cc{"CHINA-SOUTH",       0xFF0000},
+    cc{"CHINA-NORTH",       0x6495ED},
+    cc{"CHINA-UNKNOWN",     0x808080},
+    cc{"UNKNOWN",           0x808080},
+};
+
+static constexpr std::array sContinentColorsDarkTable{
+    cc{"EUROPE",            0x00A800},
+    cc{"CENTRAL-AMERICA",   0x70A4A8},
+    cc{"MIDDLE-EAST",       0x8000FF},
+    cc{"NORTH-AMERICA",     0x00008B},
+    cc{"AFRICA",            0xFF8000},
+    cc{"ASIA",              0xFF0000},
+    cc{"RUSSIA",            0xB03060},
+    cc{"AUSTRALIA-OCEANIA", 0xFF69B4},
+    cc{"SOUTH-AMERICA",     0x40E0D0},
+    cc{"ANTARCTICA",        0x808080},
+    cc{"CHINA-SOUTH",       0xFF0000},
+    cc{"CHINA-NORTH",       0x6495ED},
+    cc{"CHINA-UNKNOWN",     0x808080},
+    cc{"UNKNOWN",           0x808080},
+};
+
+static constexpr acmacs::static_map sContinentColors{sContinentColorsTable};
+static constexpr acmacs::static_map sContinentColorsDark{sContinentColorsDarkTable};
+
+template <typename Map> inline Color continent_color(std::string_view continent, const Map& data)
 {
     using namespace std::string_view_literals;
-    if (auto found = data.find(continent); found != data.end())
-        return found->second;
-    else if (auto found_unknown = data.find("UNKNOWN"sv); found_unknown != data.end())
-        return found_unknown->second;
+    if (const auto* found = data.find(continent); found)
+        return *found;
     else
-        return PINK;
+        return data.get_or("UNKNOWN"sv, PINK);
 }
 
+template <typename Map> inline acmacs::continent_colors_t make_continent_colors(const Map& data)
+{
+    acmacs::continent_colors_t result;
+    for (const auto& [continent, color] : data)
+        result.emplace_not_replace(std::string{continent}, color);
+    return result;
+}
+
+// ----------------------------------------------------------------------
+
 #pragma GCC diagnostic push
 #ifdef __clang__
 #pragma GCC diagnostic ignored "-Wexit-time-destructors"
-#pragma GCC diagnostic ignored "-Wglobal-constructors"
 #endif
 
-using namespace std::string_literals;
-
-static const acmacs::continent_colors_t sContinentColors = {
-    {"EUROPE"s,            0x00FF00},
-    {"CENTRAL-AMERICA"s,   0xAAF9FF},
-    {"MIDDLE-EAST"s,       0x8000FF},
-    {"NORTH-AMERICA"s,     0x00008B},
-    {"AFRICA"s,            0xFF8000},
-    {"ASIA"s,              0xFF0000},
-    {"RUSSIA"s,            0xB03060},
-    {"AUSTRALIA-OCEANIA"s, 0xFF69B4},
-    {"SOUTH-AMERICA"s,     0x40E0D0},
-    {"ANTARCTICA"s,        0x808080},
-    {"CHINA-SOUTH"s,       0xFF0000},
-    {"CHINA-NORTH"s,       0x6495ED},
-    {"CHINA-UNKNOWN"s,     0x808080},
-    {"UNKNOWN"s,           0x808080},
-};
-
-static const acmacs::continent_colors_t sContinentColorsDark = {
-    {"EUROPE"s,            0x00A800},
-    {"CENTRAL-AMERICA"s,   0x70A4A8},
-    {"MIDDLE-EAST"s,       0x8000FF},
-    {"NORTH-AMERICA"s,     0x00008B},
-    {"AFRICA"s,            0xFF8000},
-    {"ASIA"s,              0xFF0000},
-    {"RUSSIA"s,            0xB03060},
-    {"AUSTRALIA-OCEANIA"s, 0xFF69B4},
-    {"SOUTH-AMERICA"s,     0x40E0D0},
-    {"ANTARCTICA"s,        0x808080},
-    {"CHINA-SOUTH"s,       0xFF0000},
-    {"CHINA-NORTH"s,       0x6495ED},
-    {"CHINA-UNKNOWN"s,     0x808080},
-    {"UNKNOWN"s,           0x808080},
-};
-
-#pragma GCC diagnostic pop
-
-// ----------------------------------------------------------------------
-
 const acmacs::continent_colors_t& acmacs::continent_colors()
 {
-    return sContinentColors;
+    static const acmacs::continent_colors_t continent_colors = make_continent_colors(sContinentColors);
+    return continent_colors;
 
 } // acmacs::continent_colors
 
@@ -69,10 +77,13 @@ const acmacs::continent_colors_t& acmacs::continent_colors()
 
 const acmacs::continent_colors_t& acmacs::continent_colors_dark()
 {
-    return sContinentColorsDark;
+    static const acmacs::continent_colors_t continent_colors_dark = make_continent_colors(sContinentColorsDark);
+    return continent_colors_dark;
 
 } // acmacs::continent_colors_dark
 
+#pragma GCC diagnostic pop
+
 // ----------------------------------------------------------------------
 
 Color acmacs::continent_color(std::string_view continent)
@@ -43,8 +43,12 @@ void Color::from_string(std::string_view src)
         else if (std::cmatch m1; std::regex_search(std::begin(src), std::end(src), m1, re_heatmap)) {
             *this = acmacs::color::perceptually_uniform_heatmap(acmacs::string::from_chars<size_t>(m1.str(2)), acmacs::string::from_chars<size_t>(m1.str(1)));
         }
+        else if (const auto* found = find_color_by_name(src); found) { // color-names.icc
+            color_ = *found;
+        }
         else {
-            color_ = find_color_by_name(src); // color-names.icc, throws if not found
+            AD_WARNING("Color::from_string: cannot read Color from \"{}\", PINK is substituted", src);
+            color_ = 0xFFC0CB;
         }
     }
     catch (std::exception&) {
@@ -0,0 +1,71 @@
+#include <cstdlib>
+#include <stdexcept>
+#include <limits>
+
+#include "acmacs-base/fmt.hh"
+#include "acmacs-base/string-from-chars.hh"
+#include "acmacs-base/compression.hh"
+
+// ----------------------------------------------------------------------
+
+static acmacs::file::compression_policy& default_policy()
+{
+    static acmacs::file::compression_policy policy = []() {
+        if (const char* env = std::getenv("ACMACS_COMPRESSION"); env && *env) {
+            try {
+                return acmacs::file::parse_compression_policy(env);
+            }
+            catch (std::exception& err) {
+                fmt::print(stderr, ">> WARNING ACMACS_COMPRESSION ignored: {}\n", err.what());
+            }
+        }
+        return acmacs::file::compression_policy{};
+    }();
+    return policy;
+}
+
+// ----------------------------------------------------------------------
+
+acmacs::file::compression_policy acmacs::file::parse_compression_policy(std::string_view source)
+{
+    compression_policy policy;
+    auto speed = source;
+    if (const auto colon = source.find(':'); colon != std::string_view::npos) {
+        speed = source.substr(0, colon);
+        if (const auto threads = source.substr(colon + 1); threads.empty() || (policy.threads = acmacs::string::from_chars<uint32_t>(threads)) == std::numeric_limits<uint32_t>::max())
+            throw std::invalid_argument{fmt::format("invalid number of threads in compression policy \"{}\"", source)};
+    }
+    if (speed.empty())
+        throw std::invalid_argument{fmt::format("invalid compression policy \"{}\", expected fastest, balanced, best or level[:threads]", source)};
+    else if (speed == "fastest")
+        policy.speed = compression_speed::fastest;
+    else if (speed == "balanced")
+        policy.speed = compression_speed::balanced;
+    else if (speed == "best")
+        policy.speed = compression_speed::best;
+    else if (policy.level = acmacs::string::from_chars<int>(speed); policy.level == std::numeric_limits<int>::max() || policy.level < 0)
+        throw std::invalid_argument{fmt::format("invalid compression policy \"{}\", expected fastest, balanced, best or level[:threads]", source)};
+    return policy;
+
+} // acmacs::file::parse_compression_policy
+
+// ----------------------------------------------------------------------
+
+const acmacs::file::compression_policy& acmacs::file::default_compression_policy()
+{
+    return default_policy();
+
+} // acmacs::file::default_compression_policy
+
+// ----------------------------------------------------------------------
+
+void acmacs::file::set_default_compression_policy(const compression_policy& policy)
+{
+    default_policy() = policy;
+
+} // acmacs::file::set_default_compression_policy
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
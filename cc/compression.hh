@@ -0,0 +1,60 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include <string_view>
+
+// ----------------------------------------------------------------------
+
+namespace acmacs::file
+{
+    enum class compression_speed { fastest, balanced, best };
+
+    // codec levels used for each compression_speed and the range of explicit levels accepted by the codec
+    struct compression_levels
+    {
+        int fastest, balanced, best;
+        int min, max;
+    };
+
+    struct compression_policy
+    {
+        compression_speed speed{compression_speed::best};
+        int level{-1};       // codec specific level, overrides speed if >= 0
+        uint32_t threads{0}; // 0 - use all cpus
+        size_t block_size{0}; // xz: input is split into independent blocks of this size, output is seekable (see acmacs::file::seekable_reader), 0 - codec default
+
+        // level to use for a codec: explicit level clamped to the codec range (the same ACMACS_COMPRESSION level may be used for all codecs)
+        // or the codec level for the speed
+        constexpr int level_for(const compression_levels& levels) const
+        {
+            if (level >= 0)
+                return std::clamp(level, levels.min, levels.max);
+            switch (speed) {
+                case compression_speed::fastest:
+                    return levels.fastest;
+                case compression_speed::balanced:
+                    return levels.balanced;
+                case compression_speed::best:
+                    return levels.best;
+            }
+            return levels.best;
+        }
+    };
+
+    // "fastest", "balanced", "best" or level, optionally followed by :threads, e.g. "balanced:4", "3:1"
+    // throws std::invalid_argument
+    compression_policy parse_compression_policy(std::string_view source);
+
+    // process wide policy used when no policy is passed explicitly,
+    // initially taken from the ACMACS_COMPRESSION environment variable (parsed by parse_compression_policy), best with all cpus if not set
+    const compression_policy& default_compression_policy();
+    void set_default_compression_policy(const compression_policy& policy); // not thread safe, expected to be called on startup
+
+} // namespace acmacs::file
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
@@ -2,7 +2,16 @@
 
 #include <map>
 #include <array>
+#include <vector>
 #include <numeric>
+#include <thread>
+#include <exception>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <string_view>
 
 #include "acmacs-base/fmt.hh"
 
@@ -10,46 +19,89 @@
 
 namespace acmacs
 {
+    // hash used by Counter, specialize for types without std::hash next to the type (see date.hh), specialization must be visible
+    // wherever Counter<Obj> is used, it selects the index type
+    template <typename Obj> struct counter_hash : public std::hash<Obj>
+    {
+    };
+
+    // Entries are kept in a vector indexed by an open addressing hash table (if counter_hash<Obj> is available, std::map otherwise).
+    // entries() returns them in the order of first occurrence without copying, sorted_by_key() returns a copy sorted by key (sorting is
+    // skipped if keys were added in order), prefer entries() and operator[] when order does not matter.
+    // There is no counter() returning std::map anymore, callers using it as a map should use operator[] for lookups.
+    // Const methods do not modify the counter, references returned by min(), max(), etc. stay valid until the next count() or merge().
+    // For parallel counting use per thread counters and merge() them, or Counter::parallel().
     template <typename Obj> class Counter
     {
      public:
-        using container_type = std::map<Obj, size_t>;
-        using value_type = typename container_type::value_type;
+        using value_type = std::pair<Obj, size_t>;
+        using container_type = std::vector<value_type>;
 
         Counter() = default;
         template <typename Iter, typename F> Counter(Iter first, Iter last, F func)
             {
                 for (; first != last; ++first)
-                    ++counter_[func(*first)];
+                    count(func(*first));
             }
         template <typename Container, typename F> Counter(const Container& container, F func) : Counter(std::begin(container), std::end(container), func) {}
 
-        template <typename S> void count(const S& aObj) { ++counter_[Obj{aObj}]; }
-        template <typename S> void count_if(bool cond, const S& aObj) { if (cond) ++counter_[Obj{aObj}]; }
+        // threads: 0 - use all cpus, Iter must be random access
+        template <typename Iter, typename F> static Counter parallel(Iter first, Iter last, F func, size_t threads = 0);
+        template <typename Container, typename F> static Counter parallel(const Container& container, F func, size_t threads = 0) { return parallel(std::begin(container), std::end(container), func, threads); }
+
+        template <typename S> void count(const S& aObj) { ++entry(aObj); }
+        template <typename S> void count_if(bool cond, const S& aObj) { if (cond) ++entry(aObj); }
+        template <typename S> void count(const S& aObj, size_t num) { entry(aObj) += num; }
+
+        void merge(const Counter& other)
+        {
+            if (empty() && !other.empty()) {
+                *this = other;
+                return;
+            }
+            for (const auto& [obj, num] : other.entries_)
+                entry(obj) += num;
+        }
 
-        const auto& min() const { return *std::min_element(counter_.begin(), counter_.end(), [](const auto& e1, const auto& e2) { return e1.second < e2.second; }); }
-        const auto& max() const { return *std::max_element(counter_.begin(), counter_.end(), [](const auto& e1, const auto& e2) { return e1.second < e2.second; }); }
-        const auto& min_value() const { return *std::min_element(counter_.begin(), counter_.end(), [](const auto& e1, const auto& e2) { return e1.first < e2.first; }); }
-        const auto& max_value() const { return *std::max_element(counter_.begin(), counter_.end(), [](const auto& e1, const auto& e2) { return e1.first < e2.first; }); }
+        const auto& min() const { return *std::min_element(entries_.begin(), entries_.end(), [](const auto& e1, const auto& e2) { return e1.second < e2.second; }); }
+        const auto& max() const { return *std::max_element(entries_.begin(), entries_.end(), [](const auto& e1, const auto& e2) { return e1.second < e2.second; }); }
+        const auto& min_value() const { return *std::min_element(entries_.begin(), entries_.end(), [](const auto& e1, const auto& e2) { return e1.first < e2.first; }); }
+        const auto& max_value() const { return *std::max_element(entries_.begin(), entries_.end(), [](const auto& e1, const auto& e2) { return e1.first < e2.first; }); }
 
+        // limit > 0: top-k by partial sort, entries with the same count are ordered by key
         auto sorted_max_first(size_t limit = 0) const
             {
-                std::vector<const value_type*> result(counter_.size());
-                std::transform(std::begin(counter_), std::end(counter_), std::begin(result), [](const auto& ee) { return &ee; });
-                std::sort(result.begin(), result.end(), [](const auto& e1, const auto& e2) { return e1->second > e2->second; });
-                if (limit > 0 && limit < result.size())
+                std::vector<const value_type*> result(entries_.size());
+                std::transform(std::begin(entries_), std::end(entries_), std::begin(result), [](const auto& ee) { return &ee; });
+                const auto order = [](const auto* e1, const auto* e2) { return e1->second > e2->second || (e1->second == e2->second && e1->first < e2->first); };
+                if (limit > 0 && limit < result.size()) {
+                    std::partial_sort(result.begin(), std::next(result.begin(), static_cast<ssize_t>(limit)), result.end(), order);
                     result.erase(std::next(result.begin(), static_cast<ssize_t>(limit)), result.end());
+                }
+                else
+                    std::sort(result.begin(), result.end(), order);
                 return result;
             }
 
-        constexpr const auto& counter() const { return counter_; }
-        constexpr size_t size() const { return counter_.size(); }
-        constexpr bool empty() const { return counter_.empty(); }
+        // in the order of first occurrence
+        const container_type& entries() const noexcept { return entries_; }
+
+        // copy of entries sorted by key, O(n log n) unless keys were added in order
+        container_type sorted_by_key() const
+        {
+            container_type result{entries_};
+            if (!sorted_)
+                std::sort(std::begin(result), std::end(result), [](const auto& e1, const auto& e2) { return e1.first < e2.first; });
+            return result;
+        }
+
+        constexpr size_t size() const { return entries_.size(); }
+        constexpr bool empty() const { return entries_.empty(); }
 
         template <typename S> size_t operator[](const S& look_for) const
         {
-            if (const auto found = counter_.find(look_for); found != counter_.end())
-                return found->second;
+            if (const auto pos = find(look_for); pos != npos)
+                return entries_[pos].second;
             else
                 return 0;
         }
@@ -57,8 +109,9 @@ namespace acmacs
         std::string report(std::string_view format) const
         {
             fmt::memory_buffer out;
-            for (const auto& entry : counter_)
-                format_entry(out, format, entry);
+            const auto tot = total();
+            for (const auto& entry : sorted_by_key())
+                format_entry(out, format, entry, tot);
             return fmt::to_string(out);
         }
 
@@ -67,8 +120,9 @@ namespace acmacs
         std::string report_sorted_max_first(std::string_view format, size_t limit = 0) const
         {
             fmt::memory_buffer out;
+            const auto tot = total();
             for (const auto& entry : sorted_max_first(limit))
-                format_entry(out, format, *entry);
+                format_entry(out, format, *entry, tot);
             return fmt::to_string(out);
         }
 
@@ -76,24 +130,214 @@ namespace acmacs
 
         size_t total() const
         {
-            return std::accumulate(std::begin(counter_), std::end(counter_), 0UL, [](size_t sum, const auto& en) { return sum + en.second; });
+            return std::accumulate(std::begin(entries_), std::end(entries_), 0UL, [](size_t sum, const auto& en) { return sum + en.second; });
         }
 
      private:
-        container_type counter_;
+        static constexpr bool string_key = std::is_convertible_v<const Obj&, std::string_view>;
+        static constexpr bool hashable = string_key || std::is_default_constructible_v<counter_hash<Obj>>;
+        static constexpr size_t npos = static_cast<size_t>(-1);
+        using index_t = std::conditional_t<hashable, std::vector<uint32_t>, std::map<Obj, size_t>>; // hash table: slot contains position + 1, 0 - empty slot
+
+        container_type entries_;
+        index_t index_;
+        bool sorted_{true}; // entries_ were added in key order
+
+        template <typename S> static size_t hash(const S& key)
+        {
+            size_t hsh;
+            if constexpr (string_key)
+                hsh = std::hash<std::string_view>{}(std::string_view{key});
+            else
+                hsh = counter_hash<Obj>{}(key);
+            return static_cast<size_t>((static_cast<uint64_t>(hsh) * 0x9E3779B97F4A7C15ULL) >> 32); // std::hash of integers is identity
+        }
+
+        template <typename S> size_t find(const S& key) const
+        {
+            if constexpr (hashable) {
+                if constexpr (string_key || std::is_same_v<S, Obj>) {
+                    if (index_.empty())
+                        return npos;
+                    const size_t mask = index_.size() - 1;
+                    for (size_t slot = hash(key) & mask; index_[slot] != 0; slot = (slot + 1) & mask) {
+                        if (entries_[index_[slot] - 1].first == key)
+                            return index_[slot] - 1;
+                    }
+                    return npos;
+                }
+                else
+                    return find(Obj{key});
+            }
+            else {
+                if (const auto found = index_.find(Obj{key}); found != index_.end())
+                    return found->second;
+                else
+                    return npos;
+            }
+        }
+
+        template <typename S> size_t& entry(const S& key)
+        {
+            if (const auto pos = find(key); pos != npos)
+                return entries_[pos].second;
+            const auto& added = entries_.emplace_back(Obj{key}, 0);
+            if (sorted_ && entries_.size() > 1 && !(entries_[entries_.size() - 2].first < added.first))
+                sorted_ = false;
+            if constexpr (hashable) {
+                if (entries_.size() * 2 > index_.size())
+                    rebuild_index();
+                else
+                    insert_into_index(entries_.size() - 1);
+            }
+            else
+                index_.emplace(entries_.back().first, entries_.size() - 1);
+            return entries_.back().second;
+        }
+
+        void insert_into_index(size_t pos)
+        {
+            const size_t mask = index_.size() - 1;
+            size_t slot = hash(entries_[pos].first) & mask;
+            while (index_[slot] != 0)
+                slot = (slot + 1) & mask;
+            index_[slot] = static_cast<uint32_t>(pos + 1);
+        }
+
+        void rebuild_index()
+        {
+            if constexpr (hashable) {
+                index_.assign(std::bit_ceil(std::max(entries_.size() * 4, size_t{16})), 0); // load factor 1/4 .. 1/2
+                for (size_t pos = 0; pos < entries_.size(); ++pos)
+                    insert_into_index(pos);
+            }
+            else {
+                for (size_t pos = 0; pos < entries_.size(); ++pos)
+                    index_[entries_[pos].first] = pos;
+            }
+        }
 
-        void format_entry(fmt::memory_buffer& out, std::string_view format, const value_type& entry) const
+        void format_entry(fmt::memory_buffer& out, std::string_view format, const value_type& entry, size_t tot) const
         {
             fmt::format_to_mb(out, fmt::runtime(format), fmt::arg("quoted", fmt::format("\"{}\"", entry.first)), fmt::arg("value", entry.first), fmt::arg("counter", entry.second), //
-                              fmt::arg("counter_percent", static_cast<double>(entry.second) / static_cast<double>(total()) * 100.0),                                                //
+                              fmt::arg("counter_percent", static_cast<double>(entry.second) / static_cast<double>(tot) * 100.0),                                                    //
                               fmt::arg("first", entry.first), fmt::arg("quoted_first", fmt::format("\"{}\"", entry.first)), fmt::arg("second", entry.second));
         }
 
     }; // class Counter<Obj>
 
+    template <typename Obj> template <typename Iter, typename F> Counter<Obj> Counter<Obj>::parallel(Iter first, Iter last, F func, size_t threads)
+    {
+        const auto size = static_cast<size_t>(last - first);
+        if (threads == 0)
+            threads = std::thread::hardware_concurrency();
+        threads = std::min(threads, size / 10000 + 1); // not worth starting a thread for few elements
+        if (threads < 2)
+            return Counter(first, last, func);
+
+        std::vector<Counter> counters(threads);
+        std::vector<std::exception_ptr> errors(threads);
+        std::vector<std::thread> workers;
+        const auto chunk = (size + threads - 1) / threads;
+        for (size_t thread_no = 0; thread_no < threads; ++thread_no) {
+            workers.emplace_back([&, thread_no]() {
+                try {
+                    const auto chunk_first = std::next(first, static_cast<ssize_t>(std::min(size, chunk * thread_no)));
+                    const auto chunk_last = std::next(first, static_cast<ssize_t>(std::min(size, chunk * (thread_no + 1))));
+                    for (auto it = chunk_first; it != chunk_last; ++it)
+                        counters[thread_no].count(func(*it));
+                }
+                catch (...) {
+                    errors[thread_no] = std::current_exception();
+                }
+            });
+        }
+        for (auto& worker : workers)
+            worker.join();
+        for (const auto& err : errors) {
+            if (err)
+                std::rethrow_exception(err);
+        }
+        for (auto counter = std::next(counters.begin()); counter != counters.end(); ++counter)
+            counters.front().merge(*counter);
+        return std::move(counters.front());
+    }
+
     template <typename Iter, typename F> Counter(Iter first, Iter last, F func) -> Counter<decltype(func(*first))>;
     template <typename Container, typename F> Counter(const Container& cont, F func) -> Counter<decltype(func(*std::begin(cont)))>;
 
+    // ----------------------------------------------------------------------
+
+    using byte_histogram_t = std::array<uint64_t, 256>;
+
+    namespace detail
+    {
+        // Counting into one table stalls on store forwarding when the same byte repeats (AAAA, ----),
+        // bytes are distributed over 4 interleaved tables instead, 8 bytes are loaded at once and split by shifts.
+        inline void byte_histogram(const unsigned char* data, size_t size, byte_histogram_t& histogram)
+        {
+            constexpr size_t block_size = size_t{1} << 30; // sub-table counters do not overflow within a block
+            std::array<std::array<uint32_t, 256>, 4> tables;
+            while (size > 0) {
+                const size_t block = std::min(size, block_size);
+                for (auto& table : tables)
+                    table.fill(0);
+                const unsigned char* first = data;
+                const unsigned char* const last = data + block;
+                for (; (last - first) >= 16; first += 16) {
+                    uint64_t word1, word2;
+                    std::memcpy(&word1, first, sizeof(word1));
+                    std::memcpy(&word2, first + 8, sizeof(word2));
+                    for (size_t shift = 0; shift < 64; shift += 16) {
+                        ++tables[0][(word1 >> shift) & 0xFF];
+                        ++tables[1][(word1 >> (shift + 8)) & 0xFF];
+                        ++tables[2][(word2 >> shift) & 0xFF];
+                        ++tables[3][(word2 >> (shift + 8)) & 0xFF];
+                    }
+                }
+                for (; first != last; ++first)
+                    ++tables[0][*first];
+                for (size_t byte = 0; byte < histogram.size(); ++byte)
+                    histogram[byte] += uint64_t{tables[0][byte]} + tables[1][byte] + tables[2][byte] + tables[3][byte];
+                data += block;
+                size -= block;
+            }
+        }
+
+    } // namespace detail
+
+    // Histogram of bytes in data, added to histogram.
+    // threads: 1 - single threaded, 0 - use all cpus, multiple threads are used for data larger than 4Mb only
+    inline void byte_histogram(std::string_view data, byte_histogram_t& histogram, size_t threads = 1)
+    {
+        constexpr size_t min_chunk = 1 << 22;
+        if (threads == 0)
+            threads = std::thread::hardware_concurrency();
+        threads = std::min(threads, data.size() / min_chunk + 1);
+        const auto* bytes = reinterpret_cast<const unsigned char*>(data.data());
+        if (threads < 2) {
+            detail::byte_histogram(bytes, data.size(), histogram);
+            return;
+        }
+
+        std::vector<byte_histogram_t> histograms(threads);
+        std::vector<std::thread> workers;
+        const auto chunk = (data.size() + threads - 1) / threads;
+        for (size_t thread_no = 0; thread_no < threads; ++thread_no) {
+            const auto offset = std::min(data.size(), chunk * thread_no);
+            histograms[thread_no].fill(0);
+            workers.emplace_back([&histograms, thread_no, chunk_data = bytes + offset, chunk_size = std::min(chunk, data.size() - offset)]() { detail::byte_histogram(chunk_data, chunk_size, histograms[thread_no]); });
+        }
+        for (auto& worker : workers)
+            worker.join();
+        for (const auto& chunk_histogram : histograms)
+            std::transform(std::begin(histogram), std::end(histogram), std::begin(chunk_histogram), std::begin(histogram), [](uint64_t e1, uint64_t e2) { return e1 + e2; });
+    }
+
+    // ----------------------------------------------------------------------
+
+    // Counting a contiguous range of chars (std::string, std::string_view, std::vector<char>) longer than direct_count_max uses byte_histogram(),
+    // chars outside of [first_char, last_char) are ignored then.
     template <size_t first_char = 0, size_t last_char = 256, typename counter_t_t = uint32_t> class CounterCharSome
     {
       public:
@@ -106,11 +350,7 @@ namespace acmacs
             for (; first != last; ++first)
                 ++counter_[func(*first) - first_char];
         }
-        template <typename Iter> CounterCharSome(Iter first, Iter last) : CounterCharSome()
-        {
-            for (; first != last; ++first)
-                ++counter_[static_cast<size_t>(*first) - first_char];
-        }
+        template <typename Iter> CounterCharSome(Iter first, Iter last) : CounterCharSome() { count(first, last); }
         template <typename Container, typename F> CounterCharSome(const Container& container, F func) : CounterCharSome(std::begin(container), std::end(container), func) {}
         template <typename Container> CounterCharSome(const Container& container) : CounterCharSome(std::begin(container), std::end(container)) {}
 
@@ -118,8 +358,30 @@ namespace acmacs
         void count(char aObj, counter_t num) { counter_[static_cast<unsigned char>(aObj) - first_char] += num; }
         template <typename Iter> void count(Iter first, Iter last)
         {
-            for (; first != last; ++first)
-                ++counter_[static_cast<size_t>(*first) - first_char];
+            if constexpr (std::contiguous_iterator<Iter> && sizeof(std::iter_value_t<Iter>) == 1) {
+                count(std::string_view{reinterpret_cast<const char*>(std::to_address(first)), static_cast<size_t>(last - first)});
+            }
+            else {
+                for (; first != last; ++first)
+                    ++counter_[static_cast<size_t>(*first) - first_char];
+            }
+        }
+
+        // threads: 1 - single threaded, 0 - use all cpus for large data
+        void count(std::string_view data, size_t threads = 1)
+        {
+            if (data.size() <= direct_count_max) {
+                for (const char ch : data) {
+                    if (const auto index = static_cast<size_t>(static_cast<unsigned char>(ch)) - first_char; index < counter_.size()) // wraps around below first_char
+                        ++counter_[index];
+                }
+                return;
+            }
+            byte_histogram_t histogram;
+            histogram.fill(0);
+            byte_histogram(data, histogram, threads);
+            for (size_t byte = first_char; byte < last_char; ++byte)
+                counter_[byte - first_char] += static_cast<counter_t>(histogram[byte]);
         }
 
         void update(const CounterCharSome<first_char, last_char, counter_t_t>& other)
@@ -196,6 +458,10 @@ namespace acmacs
         constexpr auto& counter() { return counter_; }
 
       private:
+        // Zero-filling and summing up byte_histogram() tables costs about as much as counting 1-4KiB directly,
+        // the tables win for longer data with runs of the same char (alignments with gaps), direct loop is not slower below.
+        static constexpr size_t direct_count_max = 4096;
+
         std::array<counter_t, last_char - first_char> counter_;
 
         void format_entry(fmt::memory_buffer& out, std::string_view format, const std::pair<char, counter_t>& entry) const
@@ -223,9 +489,21 @@ namespace acmacs
 
 template <typename Key> struct fmt::formatter<acmacs::Counter<Key>> : public fmt::formatter<acmacs::fmt_helper::default_formatter>
 {
-    template <typename FormatContext> auto format(const acmacs::Counter<Key>& counter, FormatContext& ctx)
+    template <typename FormatContext> auto format(const acmacs::Counter<Key>& counter, FormatContext& ctx) const
     {
-        return fmt::format_to(ctx.out(), "counter{{{}}}", counter.counter());
+        auto out = fmt::format_to(ctx.out(), "counter{{{{");
+        const auto entries = counter.sorted_by_key();
+        for (auto it = entries.begin(); it != entries.end(); ++it) {
+            if (it != entries.begin())
+                out = fmt::format_to(out, ", ");
+            if constexpr (std::is_convertible_v<const Key&, std::string_view>)
+                out = fmt::format_to(out, "{:?}: {}", std::string_view{it->first}, it->second); // quoted like std::map keys
+            else if constexpr (std::is_same_v<Key, char>)
+                out = fmt::format_to(out, "{:?}: {}", it->first, it->second);
+            else
+                out = fmt::format_to(out, "{}: {}", it->first, it->second);
+        }
+        return fmt::format_to(out, "}}}}");
     }
 };
 
@@ -230,6 +230,22 @@ namespace date
 
 // ----------------------------------------------------------------------
 
+namespace acmacs
+{
+    template <typename Obj> struct counter_hash; // acmacs-base/counter.hh
+}
+
+// declared next to the type: Counter<date::year_month_day> must be the same class in every translation unit
+template <> struct acmacs::counter_hash<date::year_month_day>
+{
+    size_t operator()(const date::year_month_day& dat) const noexcept
+    {
+        return (static_cast<size_t>(static_cast<int>(dat.year()) + 32768) << 9) | (static_cast<size_t>(static_cast<unsigned>(dat.month())) << 5) | static_cast<size_t>(static_cast<unsigned>(dat.day()));
+    }
+};
+
+// ----------------------------------------------------------------------
+
 template <typename T> struct fmt::formatter<T, std::enable_if_t<std::is_base_of<date::year_month_day, T>::value, char>> : fmt::formatter<std::string> {
     template <typename FormatCtx> auto format(const date::year_month_day& dt, FormatCtx& ctx) { return fmt::formatter<std::string>::format(date::display(dt, date::allow_incomplete::yes), ctx); }
 };
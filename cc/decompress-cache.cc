@@ -0,0 +1,257 @@
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <cerrno>
+#include <cstdlib>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <vector>
+#include <algorithm>
+
+#include "acmacs-base/filesystem.hh"
+#include "acmacs-base/hash.hh"
+#include "acmacs-base/string-from-chars.hh"
+#include "acmacs-base/decompress-cache.hh"
+
+// ----------------------------------------------------------------------
+
+namespace acmacs::file::decompress_cache
+{
+    constexpr size_t MinCompressedSize = 256 * 1024;
+    constexpr size_t RescanAfterPuts = 32;
+    constexpr auto TempFileGracePeriod = std::chrono::hours{1}; // temp file of put() older than that was left by a killed writer
+
+    struct state_t
+    {
+        state_t()
+        {
+            if (const char* dir = std::getenv("ACMACS_DECOMPRESS_CACHE"); dir && *dir) {
+                directory = dir;
+                if (const char* size = std::getenv("ACMACS_DECOMPRESS_CACHE_SIZE"); size && *size) {
+                    if (const auto mib = acmacs::string::from_chars<size_t>(std::string_view{size}); mib != std::numeric_limits<size_t>::max())
+                        max_size = mib * 1024 * 1024;
+                }
+            }
+        }
+
+        std::mutex access; // directory, max_size and size estimate
+        fs::path directory;
+        size_t max_size{4ul * 1024 * 1024 * 1024};
+        bool scanned{false};        // estimated_size is based on a directory walk
+        size_t estimated_size{0};   // at the last walk plus entries stored since then
+        size_t puts_since_scan{0};
+        std::atomic<size_t> hits{0}, misses{0}, stored{0}, evicted{0}, scans{0};
+
+        void reset_estimate()
+        {
+            scanned = false;
+            estimated_size = 0;
+            puts_since_scan = 0;
+        }
+    };
+
+    static state_t& state()
+    {
+        static state_t state_;
+        return state_;
+    }
+
+    static inline fs::path entry_path(const fs::path& directory, std::string_view compressed)
+    {
+        const auto name = acmacs::hash128(compressed).hex();
+        return directory / name.substr(0, 2) / name;
+    }
+
+    static inline bool cacheable(std::string_view compressed, fs::path& directory)
+    {
+        if (compressed.size() < MinCompressedSize)
+            return false;
+        std::lock_guard<std::mutex> lock{state().access};
+        directory = state().directory;
+        return !directory.empty();
+    }
+
+    // removes least recently used (by mtime, updated on hit) entries until total size is below 90% of max_size, returns size of the remaining entries,
+    // temp files left by killed writers are removed
+    static size_t evict(const fs::path& directory, size_t max_size)
+    {
+        ++state().scans;
+        struct entry_t
+        {
+            fs::path path;
+            fs::file_time_type used;
+            size_t size;
+        };
+        std::vector<entry_t> entries;
+        std::vector<fs::path> stale;
+        size_t total = 0;
+        std::error_code ec;
+        const auto stale_before = fs::file_time_type::clock::now() - TempFileGracePeriod;
+        for (auto it = fs::recursive_directory_iterator(directory, ec); !ec && it != fs::recursive_directory_iterator{}; it.increment(ec)) {
+            if (it->is_regular_file(ec)) {
+                if (it->path().filename().native().front() != '.') {
+                    const auto size = static_cast<size_t>(it->file_size(ec));
+                    entries.push_back({it->path(), it->last_write_time(ec), size});
+                    total += size;
+                }
+                else if (const auto modified = it->last_write_time(ec); !ec && modified < stale_before)
+                    stale.push_back(it->path());
+            }
+        }
+        for (const auto& path : stale)
+            fs::remove(path, ec);
+        if (total <= max_size)
+            return total;
+        std::sort(std::begin(entries), std::end(entries), [](const auto& e1, const auto& e2) { return e1.used < e2.used; });
+        for (const auto& entry : entries) {
+            if (total <= (max_size / 10 * 9))
+                break;
+            if (fs::remove(entry.path, ec)) {
+                total -= entry.size;
+                ++state().evicted;
+            }
+        }
+        return total;
+    }
+
+    // size estimate is updated with the stored entry, directory is walked if the estimate is unknown, exceeds the limit or is too old
+    static void update_size_estimate(const fs::path& directory, size_t max_size, size_t entry_size)
+    {
+        {
+            std::lock_guard<std::mutex> lock{state().access};
+            auto& st = state();
+            st.estimated_size += entry_size;
+            ++st.puts_since_scan;
+            if (st.scanned && st.estimated_size <= max_size && st.puts_since_scan < RescanAfterPuts)
+                return;
+            st.scanned = true;
+            st.puts_since_scan = 0;
+        }
+        const auto total = evict(directory, max_size);
+        std::lock_guard<std::mutex> lock{state().access};
+        if (state().directory == directory)
+            state().estimated_size = total;
+    }
+
+} // namespace acmacs::file::decompress_cache
+
+// ----------------------------------------------------------------------
+
+void acmacs::file::decompress_cache::enable(std::string_view directory, size_t max_size)
+{
+    std::lock_guard<std::mutex> lock{state().access};
+    state().directory = directory;
+    state().max_size = max_size;
+    state().reset_estimate();
+
+} // acmacs::file::decompress_cache::enable
+
+// ----------------------------------------------------------------------
+
+void acmacs::file::decompress_cache::disable()
+{
+    std::lock_guard<std::mutex> lock{state().access};
+    state().directory.clear();
+    state().reset_estimate();
+
+} // acmacs::file::decompress_cache::disable
+
+// ----------------------------------------------------------------------
+
+bool acmacs::file::decompress_cache::enabled()
+{
+    std::lock_guard<std::mutex> lock{state().access};
+    return !state().directory.empty();
+
+} // acmacs::file::decompress_cache::enabled
+
+// ----------------------------------------------------------------------
+
+acmacs::file::decompress_cache::statistics_t acmacs::file::decompress_cache::statistics()
+{
+    return {state().hits, state().misses, state().stored, state().evicted, state().scans};
+
+} // acmacs::file::decompress_cache::statistics
+
+// ----------------------------------------------------------------------
+
+bool acmacs::file::decompress_cache::get(std::string_view compressed, std::string& output)
+{
+    fs::path directory;
+    if (!cacheable(compressed, directory))
+        return false;
+
+    const auto path = entry_path(directory, compressed);
+    bool found = false;
+    if (const int fd = ::open(path.c_str(), O_RDONLY); fd >= 0) {
+        struct stat st;
+        if (fstat(fd, &st) == 0) {
+            output.resize(static_cast<size_t>(st.st_size));
+            size_t offset = 0;
+            while (offset < output.size()) {
+                if (const auto bytes_read = ::read(fd, output.data() + offset, output.size() - offset); bytes_read > 0)
+                    offset += static_cast<size_t>(bytes_read);
+                else if (bytes_read == 0 || errno != EINTR)
+                    break;
+            }
+            found = offset == output.size();
+            if (found)
+                futimens(fd, nullptr); // mark as recently used
+        }
+        ::close(fd);
+    }
+    if (found)
+        ++state().hits;
+    else
+        ++state().misses;
+    return found;
+
+} // acmacs::file::decompress_cache::get
+
+// ----------------------------------------------------------------------
+
+void acmacs::file::decompress_cache::put(std::string_view compressed, std::string_view decompressed)
+{
+    fs::path directory;
+    if (!cacheable(compressed, directory))
+        return;
+
+    size_t max_size;
+    {
+        std::lock_guard<std::mutex> lock{state().access};
+        max_size = state().max_size;
+    }
+    if (decompressed.size() > max_size)
+        return;
+
+    const auto path = entry_path(directory, compressed);
+    std::error_code ec;
+    fs::create_directories(path.parent_path(), ec);
+    // write into temp file and rename to make entry appear atomically for other processes
+    std::string temp_name = (path.parent_path() / fmt::format(".{}.XXXXXX", path.filename().native())).native();
+    const int fd = mkstemp(temp_name.data());
+    if (fd < 0)
+        return;
+    bool written = true;
+    for (auto data = decompressed; written && !data.empty();) {
+        if (const auto bytes_written = ::write(fd, data.data(), data.size()); bytes_written > 0)
+            data.remove_prefix(static_cast<size_t>(bytes_written));
+        else if (bytes_written == 0 || errno != EINTR)
+            written = false;
+    }
+    fchmod(fd, 0644);
+    ::close(fd);
+    if (written && ::rename(temp_name.c_str(), path.c_str()) == 0) {
+        ++state().stored;
+        update_size_estimate(directory, max_size, decompressed.size());
+    }
+    else
+        ::unlink(temp_name.c_str());
+
+} // acmacs::file::decompress_cache::put
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
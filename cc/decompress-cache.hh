@@ -0,0 +1,39 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+// ----------------------------------------------------------------------
+// Opt-in on-disk cache of decompressed data keyed by XXH3-128 of the compressed bytes.
+// Used by acmacs::file::decompress_if_necessary (and therefore by read_access, rjson parse_file, etc.) for compressed input of at least 256KiB.
+// Enabled by ACMACS_DECOMPRESS_CACHE=<directory> environment variable (size limit in MiB in ACMACS_DECOMPRESS_CACHE_SIZE, default 4096) or by enable().
+// Directory is shared between processes, entries are written atomically, least recently used entries are removed when the size limit is exceeded.
+// Directory size is obtained by walking it on the first put and then estimated by adding sizes of the stored entries, the walk (and eviction)
+// is repeated when the estimate exceeds the limit or after every 32 stored entries to account for other processes using the same directory.
+
+namespace acmacs::file::decompress_cache
+{
+    struct statistics_t
+    {
+        size_t hits{0};
+        size_t misses{0};
+        size_t stored{0};
+        size_t evicted{0};
+        size_t scans{0}; // directory walks
+    };
+
+    void enable(std::string_view directory, size_t max_size = 4ul * 1024 * 1024 * 1024);
+    void disable();
+    bool enabled();
+    statistics_t statistics();
+
+    // returns true and fills output if decompressed data for compressed is in the cache
+    bool get(std::string_view compressed, std::string& output);
+    void put(std::string_view compressed, std::string_view decompressed);
+
+} // namespace acmacs::file::decompress_cache
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
@@ -0,0 +1,447 @@
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <limits>
+#include <algorithm>
+#include <thread>
+#include <utility>
+#include <zlib.h>
+#include <bzlib.h>
+#include <zstd.h>
+
+#pragma GCC diagnostic push
+#ifdef __clang__
+#pragma GCC diagnostic ignored "-Wdocumentation"
+#pragma GCC diagnostic ignored "-Wdocumentation-unknown-command"
+#pragma GCC diagnostic ignored "-Wdocumentation-pedantic"
+#pragma GCC diagnostic ignored "-Wreserved-id-macro"
+#pragma GCC diagnostic ignored "-Wzero-as-null-pointer-constant"
+#endif
+#define lzma_nothrow
+#include <lzma.h>
+#pragma GCC diagnostic pop
+
+#ifdef __clang__
+#pragma GCC diagnostic ignored "-Wzero-as-null-pointer-constant"
+#endif
+
+#include "acmacs-base/fmt.hh"
+#include "acmacs-base/string-compare.hh"
+#include "acmacs-base/gzip.hh"
+#include "acmacs-base/xz.hh"
+#include "acmacs-base/bzip2.hh"
+#include "acmacs-base/brotli.hh"
+#include "acmacs-base/zstd.hh"
+#include "acmacs-base/file-writer.hh"
+
+// ----------------------------------------------------------------------
+
+class acmacs::file::writer::encoder
+{
+  public:
+    static constexpr size_t ChunkSize = 1024 * 1024;
+
+    encoder(writer& target) : out_(ChunkSize, ' '), target_{target} {}
+    virtual ~encoder() = default;
+
+    // consumes the whole input, output is written to the file whenever chunk is full
+    virtual void process(std::string_view input, bool finish) = 0;
+
+    void finish()
+    {
+        process({}, true);
+        flush();
+    }
+
+  protected:
+    std::string out_;
+    size_t used_{0};
+
+    void flush()
+    {
+        target_.write_chunk({out_.data(), used_});
+        used_ = 0;
+    }
+
+    void flush_if_full()
+    {
+        if (used_ == out_.size())
+            flush();
+    }
+
+    // bypasses chunk buffer
+    void write_through(std::string_view data)
+    {
+        flush();
+        target_.write_chunk(data);
+    }
+
+  private:
+    writer& target_;
+};
+
+// ----------------------------------------------------------------------
+
+namespace acmacs::file
+{
+    namespace
+    {
+        class plain_encoder : public writer::encoder
+        {
+          public:
+            using writer::encoder::encoder;
+
+            void process(std::string_view input, bool /*finish*/) override
+            {
+                if (input.size() >= out_.size()) {
+                    write_through(input);
+                    return;
+                }
+                if ((used_ + input.size()) > out_.size())
+                    flush();
+                std::memcpy(out_.data() + used_, input.data(), input.size());
+                used_ += input.size();
+            }
+        };
+
+        // ----------------------------------------------------------------------
+
+        class gzip_encoder : public writer::encoder
+        {
+          public:
+            gzip_encoder(writer& target, const compression_policy& policy) : writer::encoder(target)
+            {
+                strm_.zalloc = Z_NULL;
+                strm_.zfree = Z_NULL;
+                strm_.opaque = Z_NULL;
+                if (deflateInit2(&strm_, policy.level_for(gzip_levels), Z_DEFLATED, 15 | 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+                    throw std::runtime_error("gzip compression failed during initialization");
+            }
+
+            ~gzip_encoder() override { deflateEnd(&strm_); }
+
+            void process(std::string_view input, bool finish) override
+            {
+                constexpr size_t MaxChunk = std::numeric_limits<uInt>::max(); // avail_in and avail_out are 32 bit
+                size_t offset = 0;
+                do {
+                    const auto chunk = std::min(input.size() - offset, MaxChunk);
+                    strm_.next_in = reinterpret_cast<decltype(strm_.next_in)>(const_cast<char*>(input.data() + offset));
+                    strm_.avail_in = static_cast<decltype(strm_.avail_in)>(chunk);
+                    offset += chunk;
+                    const bool last = finish && offset == input.size();
+                    for (;;) {
+                        strm_.next_out = reinterpret_cast<decltype(strm_.next_out)>(out_.data() + used_);
+                        strm_.avail_out = static_cast<decltype(strm_.avail_out)>(out_.size() - used_);
+                        const auto res = deflate(&strm_, last ? Z_FINISH : Z_NO_FLUSH);
+                        used_ = out_.size() - strm_.avail_out;
+                        if (res != Z_OK && res != Z_STREAM_END && res != Z_BUF_ERROR)
+                            throw std::runtime_error("gzip compression failed, code: " + std::to_string(res));
+                        flush_if_full();
+                        if (last ? res == Z_STREAM_END : (strm_.avail_in == 0 && used_ < out_.size()))
+                            break;
+                    }
+                } while (offset < input.size());
+            }
+
+          private:
+            z_stream strm_;
+        };
+
+        // ----------------------------------------------------------------------
+
+        class xz_encoder : public writer::encoder
+        {
+          public:
+            xz_encoder(writer& target, const compression_policy& policy) : writer::encoder(target)
+            {
+                lzma_mt mt{};
+                mt.preset = xz_preset(policy);
+                mt.check = LZMA_CHECK_CRC64;
+                mt.threads = policy.threads == 0 ? lzma_cputhreads() : policy.threads;
+                mt.block_size = policy.block_size > 0 ? policy.block_size : 16 * 1024 * 1024; // total size is unknown, blocks of xz_compress minimal size
+                if (const auto physmem = lzma_physmem(); physmem > 0) {
+                    while (mt.threads > 1 && lzma_stream_encoder_mt_memusage(&mt) > physmem / 2)
+                        --mt.threads;
+                }
+                if (mt.threads > 1 || policy.block_size > 0) { // single threaded mt encoder still splits into blocks (seekable output)
+                    if (lzma_stream_encoder_mt(&strm_, &mt) != LZMA_OK)
+                        throw std::runtime_error("lzma compression failed 1");
+                }
+                else if (lzma_easy_encoder(&strm_, mt.preset, LZMA_CHECK_CRC64) != LZMA_OK)
+                    throw std::runtime_error("lzma compression failed 1");
+            }
+
+            ~xz_encoder() override { lzma_end(&strm_); }
+
+            void process(std::string_view input, bool finish) override
+            {
+                strm_.next_in = reinterpret_cast<const uint8_t*>(input.data());
+                strm_.avail_in = input.size();
+                for (;;) {
+                    strm_.next_out = reinterpret_cast<uint8_t*>(out_.data() + used_);
+                    strm_.avail_out = out_.size() - used_;
+                    const auto res = lzma_code(&strm_, finish ? LZMA_FINISH : LZMA_RUN);
+                    used_ = out_.size() - strm_.avail_out;
+                    if (res != LZMA_OK && res != LZMA_STREAM_END)
+                        throw std::runtime_error("lzma compression failed 2");
+                    flush_if_full();
+                    if (finish ? res == LZMA_STREAM_END : (strm_.avail_in == 0 && used_ < out_.size()))
+                        break;
+                }
+            }
+
+          private:
+            lzma_stream strm_ = LZMA_STREAM_INIT;
+        };
+
+        // ----------------------------------------------------------------------
+
+        class bz2_encoder : public writer::encoder
+        {
+          public:
+            bz2_encoder(writer& target, const compression_policy& policy) : writer::encoder(target)
+            {
+                strm_.bzalloc = nullptr;
+                strm_.bzfree = nullptr;
+                strm_.opaque = nullptr;
+                if (BZ2_bzCompressInit(&strm_, policy.level_for(bz2_levels), 0 /* verbosity */, 0 /* default work factor */) != BZ_OK)
+                    throw std::runtime_error("bz2 compression failed during initialization");
+            }
+
+            ~bz2_encoder() override { BZ2_bzCompressEnd(&strm_); }
+
+            void process(std::string_view input, bool finish) override
+            {
+                constexpr size_t MaxChunk = std::numeric_limits<unsigned int>::max(); // avail_in and avail_out are 32 bit
+                size_t offset = 0;
+                do {
+                    const auto chunk = std::min(input.size() - offset, MaxChunk);
+                    strm_.next_in = const_cast<char*>(input.data() + offset);
+                    strm_.avail_in = static_cast<decltype(strm_.avail_in)>(chunk);
+                    offset += chunk;
+                    const bool last = finish && offset == input.size();
+                    for (;;) {
+                        strm_.next_out = out_.data() + used_;
+                        strm_.avail_out = static_cast<decltype(strm_.avail_out)>(out_.size() - used_);
+                        const auto res = BZ2_bzCompress(&strm_, last ? BZ_FINISH : BZ_RUN);
+                        used_ = out_.size() - strm_.avail_out;
+                        if (res != BZ_RUN_OK && res != BZ_FINISH_OK && res != BZ_STREAM_END)
+                            throw std::runtime_error("bz2 compression failed, code: " + std::to_string(res));
+                        flush_if_full();
+                        if (last ? res == BZ_STREAM_END : strm_.avail_in == 0)
+                            break;
+                    }
+                } while (offset < input.size());
+            }
+
+          private:
+            bz_stream strm_;
+        };
+
+        // ----------------------------------------------------------------------
+
+        class brotli_stream_encoder : public writer::encoder
+        {
+          public:
+            brotli_stream_encoder(writer& target, const compression_policy& policy) : writer::encoder(target), brotli_{policy} {}
+
+            // quality 0 and 1 encoders compress each input piece separately, small appends are therefore accumulated before compression
+            void process(std::string_view input, bool finish) override
+            {
+                if (!finish && (pending_.size() + input.size()) < ChunkSize) {
+                    pending_.append(input);
+                    return;
+                }
+                if (!pending_.empty()) {
+                    brotli_.push(pending_, compressed_);
+                    pending_.clear();
+                }
+                brotli_.push(input, compressed_);
+                if (finish)
+                    brotli_.finish(compressed_);
+                if (finish || compressed_.size() >= ChunkSize) {
+                    write_through(compressed_);
+                    compressed_.clear();
+                }
+            }
+
+          private:
+            brotli_encoder brotli_;
+            std::string pending_;
+            std::string compressed_;
+        };
+
+        // ----------------------------------------------------------------------
+
+        class zstd_encoder : public writer::encoder
+        {
+          public:
+            zstd_encoder(writer& target, const compression_policy& policy) : writer::encoder(target), ctx_{ZSTD_createCCtx()}
+            {
+                if (!ctx_)
+                    throw std::runtime_error("zstd compression failed during initialization");
+                if (const auto res = ZSTD_CCtx_setParameter(ctx_, ZSTD_c_compressionLevel, policy.level_for(zstd_levels)); ZSTD_isError(res)) {
+                    ZSTD_freeCCtx(ctx_);
+                    throw std::runtime_error(std::string{"zstd compression failed: "} + ZSTD_getErrorName(res));
+                }
+                ZSTD_CCtx_setParameter(ctx_, ZSTD_c_checksumFlag, 1);
+                if (const auto threads = policy.threads == 0 ? std::thread::hardware_concurrency() : policy.threads; threads > 1)
+                    ZSTD_CCtx_setParameter(ctx_, ZSTD_c_nbWorkers, static_cast<int>(threads)); // fails if libzstd is built without multi-threading
+            }
+
+            ~zstd_encoder() override { ZSTD_freeCCtx(ctx_); }
+
+            void process(std::string_view input, bool finish) override
+            {
+                ZSTD_inBuffer in{input.data(), input.size(), 0};
+                for (;;) {
+                    ZSTD_outBuffer out{out_.data(), out_.size(), used_};
+                    const auto remaining = ZSTD_compressStream2(ctx_, &out, &in, finish ? ZSTD_e_end : ZSTD_e_continue);
+                    if (ZSTD_isError(remaining))
+                        throw std::runtime_error(std::string{"zstd compression failed: "} + ZSTD_getErrorName(remaining));
+                    used_ = out.pos;
+                    flush_if_full();
+                    if (finish ? remaining == 0 : (in.pos == in.size && used_ < out_.size()))
+                        break;
+                }
+            }
+
+          private:
+            ZSTD_CCtx* ctx_;
+        };
+
+    } // namespace
+} // namespace acmacs::file
+
+// ----------------------------------------------------------------------
+
+acmacs::file::writer::writer(std::string_view filename, force_compression aForceCompression, backup_file aBackupFile, const compression_policy& policy)
+    : filename_{filename}
+{
+    using namespace std::string_view_literals;
+    if (filename == "-") {
+        fd_ = 1;
+    }
+    else if (filename == "=") {
+        fd_ = 2;
+    }
+    else if (filename == "/") {
+        fd_ = open("/dev/null", O_WRONLY | O_TRUNC | O_CREAT, 0644);
+        if (fd_ < 0)
+            throw std::runtime_error(fmt::format("Cannot open /dev/null: {}", strerror(errno)));
+    }
+    else {
+        if (aBackupFile == backup_file::yes && filename.substr(0, 4) != "/dev") { // allow writing to /dev/ without making backup attempt
+            fd_ = detail::open_replacement(filename_, temp_name_);
+            if (temp_name_.empty())
+                backup(filename);
+        }
+        if (fd_ < 0) {
+            fd_ = open(filename_.c_str(), O_WRONLY | O_TRUNC | O_CREAT, 0644);
+            if (fd_ < 0)
+                throw std::runtime_error(fmt::format("Cannot open {}: {}", filename, strerror(errno)));
+        }
+    }
+
+    try {
+        if (acmacs::string::endswith(filename, ".gz"sv))
+            encoder_ = std::make_unique<gzip_encoder>(*this, policy);
+        else if (acmacs::string::endswith(filename, ".bz2"sv))
+            encoder_ = std::make_unique<bz2_encoder>(*this, policy);
+        else if (acmacs::string::endswith(filename, ".br"sv))
+            encoder_ = std::make_unique<brotli_stream_encoder>(*this, policy);
+        else if (acmacs::string::endswith(filename, ".zst"sv))
+            encoder_ = std::make_unique<zstd_encoder>(*this, policy);
+        else if (aForceCompression == force_compression::yes || acmacs::string::endswith(filename, ".xz"sv))
+            encoder_ = std::make_unique<xz_encoder>(*this, policy);
+        else
+            encoder_ = std::make_unique<plain_encoder>(*this);
+    }
+    catch (std::exception&) {
+        abandon();
+        throw;
+    }
+
+} // acmacs::file::writer::writer
+
+// ----------------------------------------------------------------------
+
+acmacs::file::writer::~writer()
+{
+    if (!temp_name_.empty() && std::uncaught_exceptions() > uncaught_exceptions_) { // incomplete output must not replace the file
+        abandon();
+        return;
+    }
+    try {
+        close();
+    }
+    catch (std::exception& err) {
+        fmt::print(stderr, "> ERROR writing {}: {}\n", filename_, err);
+    }
+
+} // acmacs::file::writer::~writer
+
+// ----------------------------------------------------------------------
+
+acmacs::file::writer& acmacs::file::writer::append(std::string_view data)
+{
+    if (!encoder_)
+        throw std::runtime_error(fmt::format("Cannot write {}: already closed", filename_));
+    encoder_->process(data, false);
+    return *this;
+
+} // acmacs::file::writer::append
+
+// ----------------------------------------------------------------------
+
+void acmacs::file::writer::close()
+{
+    if (encoder_) {
+        try {
+            encoder_->finish();
+            encoder_.reset();
+            if (!temp_name_.empty()) {
+                detail::commit_replacement(std::exchange(fd_, -1), filename_, temp_name_);
+                temp_name_.clear();
+            }
+        }
+        catch (std::exception&) {
+            abandon();
+            throw;
+        }
+        if (fd_ > 2)
+            ::close(fd_);
+        fd_ = -1;
+    }
+
+} // acmacs::file::writer::close
+
+// ----------------------------------------------------------------------
+
+void acmacs::file::writer::abandon() noexcept
+{
+    encoder_.reset();
+    if (fd_ > 2)
+        ::close(fd_);
+    fd_ = -1;
+    if (!temp_name_.empty()) {
+        ::unlink(temp_name_.c_str());
+        temp_name_.clear();
+    }
+
+} // acmacs::file::writer::abandon
+
+// ----------------------------------------------------------------------
+
+void acmacs::file::writer::write_chunk(std::string_view chunk)
+{
+    write_to_file_descriptor(fd_, chunk, filename_);
+
+} // acmacs::file::writer::write_chunk
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <memory>
+#include <exception>
+
+#include "acmacs-base/read-file.hh"
+
+// ----------------------------------------------------------------------
+
+namespace acmacs::file
+{
+    // Incremental output, data is compressed on the fly according to the filename suffix (.gz, .xz, .bz2, .br, .zst) or with xz if compression is forced.
+    // Compressed data is written to the file in chunks of bounded size, memory use does not depend on the total output size.
+    // "-" - stdout, "=" - stderr, "/" - /dev/null (as acmacs::file::write)
+    // Existing file is replaced as by acmacs::file::write() with backup: output goes to a temp file that close() renames over the file, the old
+    // file is hard linked into the backup dir. If writer is destroyed by an exception before close(), the temp file is removed and the file is kept.
+    class writer
+    {
+      public:
+        writer(std::string_view filename, force_compression aForceCompression = force_compression::no, backup_file aBackupFile = backup_file::yes,
+               const compression_policy& policy = default_compression_policy());
+        ~writer(); // calls close() unless destroyed by an exception while replacing file, errors are reported to stderr
+        writer(const writer&) = delete;
+        writer& operator=(const writer&) = delete;
+
+        writer& append(std::string_view data);
+        writer& operator<<(std::string_view data) { return append(data); }
+        void close(); // flushes encoder, closes file and replaces the old one with it, subsequent calls do nothing
+
+        class encoder;
+
+      private:
+        std::string filename_;
+        int fd_{-1};
+        std::string temp_name_; // not empty if output replaces existing file on close()
+        std::unique_ptr<encoder> encoder_;
+        const int uncaught_exceptions_{std::uncaught_exceptions()};
+
+        void write_chunk(std::string_view chunk);
+        void abandon() noexcept; // closes and removes temp file
+
+    }; // class writer
+
+} // namespace acmacs::file
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
@@ -1,6 +1,20 @@
 #pragma once
 
 #include <vector>
+#include <array>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <new>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <mutex>
+#include <atomic>
+#include <bit>
+#include <limits>
+#include <cstdint>
+#include <type_traits>
 
 #include "acmacs-base/fmt.hh"
 #include "acmacs-base/range-v3.hh"
@@ -123,7 +137,377 @@ namespace acmacs
 
     // ----------------------------------------------------------------------
 
-    template <typename Key, typename Value> class small_map_with_unique_keys_t
+    class frozen_map_error : public std::runtime_error
+    {
+      public:
+        using std::runtime_error::runtime_error;
+    };
+
+    namespace detail
+    {
+        // Keys of frozen maps are searched as uint64_t mapped with the same order: integers and floating point numbers exactly,
+        // strings by 8 bytes (big endian, zero padded) after the prefix common to all keys of the map, keys with the same search key
+        // are then ordered by full comparison.
+        template <typename Key> class search_key_t
+        {
+          public:
+            static constexpr bool string_key = std::is_convertible_v<const Key&, std::string_view> && !std::is_pointer_v<Key>; // const char* keys are ordered by pointer
+            static constexpr bool exact = std::is_arithmetic_v<Key> && sizeof(Key) <= sizeof(uint64_t);
+            static constexpr bool supported = exact || string_key;
+
+            template <typename Entries> void build(const Entries& sorted) // sorted by .first
+            {
+                if constexpr (string_key) {
+                    if (!sorted.empty()) {
+                        const std::string_view first{sorted.front().first}, last{sorted.back().first};
+                        common_prefix_.assign(first.begin(), std::mismatch(first.begin(), first.end(), last.begin(), last.end()).first);
+                    }
+                }
+            }
+
+            uint64_t operator()(const Key& key) const noexcept
+            {
+                if constexpr (string_key)
+                    return prefix(std::string_view{key}.substr(common_prefix_.size()));
+                else
+                    return number(key);
+            }
+
+            // nullopt if key is not comparable with Key via its search key (e.g. negative int looked up in a map with unsigned keys)
+            template <typename FindKey> std::optional<uint64_t> make(const FindKey& key) const noexcept
+            {
+                if constexpr (string_key && std::is_convertible_v<const FindKey&, std::string_view>) {
+                    const std::string_view view{key};
+                    if (const auto cmp = view.substr(0, common_prefix_.size()).compare(common_prefix_); cmp != 0) // before or after all keys
+                        return cmp < 0 ? uint64_t{0} : std::numeric_limits<uint64_t>::max();
+                    return prefix(view.substr(common_prefix_.size()));
+                }
+                else if constexpr (exact && std::is_same_v<FindKey, Key>)
+                    return number(key);
+                else if constexpr (exact && integer<Key> && integer<FindKey>) {
+                    if (std::in_range<Key>(key))
+                        return number(static_cast<Key>(key));
+                    else
+                        return std::nullopt;
+                }
+                else
+                    return std::nullopt;
+            }
+
+          private:
+            std::string common_prefix_;
+
+            template <typename T> static constexpr bool integer = std::is_integral_v<T> && !std::is_same_v<T, bool> && !std::is_same_v<T, char> && !std::is_same_v<T, wchar_t> && !std::is_same_v<T, char8_t> &&
+                                                                  !std::is_same_v<T, char16_t> && !std::is_same_v<T, char32_t>; // std::in_range does not accept bool and character types
+
+            static uint64_t prefix(std::string_view key) noexcept
+            {
+                uint64_t result{0};
+                std::memcpy(&result, key.data(), std::min(key.size(), sizeof(result)));
+                if constexpr (std::endian::native == std::endian::little)
+                    result = __builtin_bswap64(result);
+                return result;
+            }
+
+            static uint64_t number(Key key) noexcept
+            {
+                constexpr uint64_t sign_bit{uint64_t{1} << 63};
+                if constexpr (std::is_floating_point_v<Key>) {
+                    const auto bits = std::bit_cast<uint64_t>(key == Key{0} ? 0.0 : static_cast<double>(key)); // -0.0 == 0.0
+                    return (bits & sign_bit) ? ~bits : (bits | sign_bit);
+                }
+                else if constexpr (std::is_signed_v<Key>)
+                    return static_cast<uint64_t>(static_cast<int64_t>(key)) ^ sign_bit;
+                else
+                    return static_cast<uint64_t>(key);
+            }
+        };
+
+        // Static B+ tree over search keys: leaves are search keys of the sorted entries, i.e. position in leaves is position of the entry and
+        // no separate array of positions has to be read. Nodes are 16 keys (two cache lines, aligned), child c of node k is node k * 17 + c in
+        // the layer below, keys of a node are minimal keys of its children 1..16. Node is searched by counting keys less than the key looked up,
+        // it does not branch, the top layers stay in cache. Entries of the leaf are prefetched while the leaf is searched, reading the entry
+        // found does not add another cache miss. Keys and nodes take 8.5 bytes per entry.
+        // 5M random lookups of present keys, one cpu, std::lower_bound over sorted entries vs. index
+        // (test-flat-map --benchmark -t 1 -l 5000000 -n <entries>):
+        //                uint64 keys     8 hex digit string_view     string_view with the same 8 byte prefix
+        //    1M entries: 2.04s  0.91s    6.42s  1.59s                5.31s  1.86s
+        //   10M entries: 3.44s  2.34s   13.25s  3.26s               11.19s  3.24s
+        class blocked_index_t
+        {
+          public:
+            static constexpr size_t node_size = 16;
+
+            template <typename Entries, typename SearchKey> void build(const Entries& sorted, SearchKey&& search_key) // sorted by .first
+            {
+                size_ = sorted.size();
+                std::array<size_t, max_layers> layer_nodes{std::max((size_ + node_size - 1) / node_size, size_t{1})};
+                for (layers_ = 1; layer_nodes[layers_ - 1] > 1; ++layers_) {
+                    if (layers_ == max_layers)
+                        throw frozen_map_error{"too many entries for frozen map"};
+                    layer_nodes[layers_] = (layer_nodes[layers_ - 1] + node_size) / (node_size + 1);
+                }
+                for (size_t layer = 0; layer < layers_; ++layer)
+                    layer_first_[layer + 1] = layer_first_[layer] + layer_nodes[layer];
+                keys_.reset(static_cast<uint64_t*>(::operator new[](layer_first_[layers_] * node_size * sizeof(uint64_t), std::align_val_t{alignment})));
+
+                for (size_t pos = 0; pos < layer_nodes[0] * node_size; ++pos)
+                    keys_[pos] = pos < size_ ? search_key(sorted[pos].first) : padding;
+                for (size_t layer = 1, child_entries = node_size; layer < layers_; ++layer, child_entries *= node_size + 1) {
+                    for (size_t node = 0; node < layer_nodes[layer]; ++node) {
+                        for (size_t key_no = 0; key_no < node_size; ++key_no) {
+                            const size_t child_first_entry = (node * (node_size + 1) + key_no + 1) * child_entries;
+                            keys_[(layer_first_[layer] + node) * node_size + key_no] = child_first_entry < size_ ? keys_[child_first_entry] : padding;
+                        }
+                    }
+                }
+            }
+
+            // position of the first search key not less than key, number of entries if there is no such key
+            // entries (sorted, the same as passed to build()) of the leaf reached are prefetched while the leaf is searched
+            template <typename Entry> size_t lower_bound(uint64_t key, const Entry* entries) const noexcept
+            {
+                size_t node = 0;
+                for (size_t layer = layers_ - 1; layer > 0; --layer)
+                    node = node * (node_size + 1) + count_less(keys_.get() + (layer_first_[layer] + node) * node_size, key);
+#if defined(__GNUC__) || defined(__clang__)
+                if constexpr (sizeof(Entry) * node_size <= prefetch_max_bytes) {
+                    if (const size_t first = node * node_size; first < size_) {
+                        const auto* first_byte = reinterpret_cast<const char*>(entries + first);
+                        const auto* last_byte = reinterpret_cast<const char*>(entries + std::min(first + node_size, size_));
+                        for (const auto* byte = first_byte; byte < last_byte; byte += cache_line)
+                            __builtin_prefetch(byte);
+                    }
+                }
+#endif
+                return std::min(node * node_size + count_less(keys_.get() + node * node_size, key), size_);
+            }
+
+            uint64_t operator[](size_t pos) const noexcept { return keys_[pos]; } // search key of the entry at pos < number of entries
+
+          private:
+            static constexpr size_t alignment = 128;                                // a node never spans more than two cache lines
+            static constexpr size_t cache_line = 64;
+            static constexpr size_t prefetch_max_bytes = 512;                       // entries of a leaf are not prefetched if they are large
+            static constexpr size_t max_layers = 16;                                // 17^15 entries
+            static constexpr uint64_t padding = std::numeric_limits<uint64_t>::max(); // never less than a key looked up
+
+            struct aligned_delete
+            {
+                void operator()(uint64_t* ptr) const noexcept { ::operator delete[](ptr, std::align_val_t{alignment}); }
+            };
+
+            std::unique_ptr<uint64_t[], aligned_delete> keys_;
+            std::array<size_t, max_layers + 1> layer_first_{}; // first node of each layer, leaves are layer 0, the last one is the root
+            size_t layers_{0};
+            size_t size_{0};
+
+            static size_t count_less(const uint64_t* node, uint64_t key) noexcept
+            {
+                size_t count{0};
+                for (size_t key_no = 0; key_no < node_size; ++key_no)
+                    count += static_cast<size_t>(node[key_no] < key);
+                return count;
+            }
+        };
+
+        // Filled once (not thread safe), then frozen: sorted and indexed exactly once (std::call_once) on the first lookup or explicit freeze(),
+        // after that any number of threads may read it concurrently.
+        // Duplicating keys in the map with unique keys are detected when freezing, the map is frozen anyway and freeze() and every lookup
+        // throw map_with_unique_keys_error without sorting again.
+        // Lookups go through blocked_index_t for arithmetic and string keys, lookups by key types without search key use binary search over the sorted entries.
+        template <typename Key, typename Value, bool unique_keys> class frozen_map_base_t
+        {
+          public:
+            using entry_type = std::pair<Key, Value>;
+            using const_iterator = typename std::vector<entry_type>::const_iterator;
+            using search_key_t = detail::search_key_t<Key>;
+            static constexpr bool use_index = search_key_t::supported;
+
+            frozen_map_base_t() = default;
+            frozen_map_base_t(const frozen_map_base_t& rhs) : data_{rhs.data_} {} // copy is frozen again on first use
+            frozen_map_base_t(frozen_map_base_t&& rhs) : data_{std::move(rhs.data_)} {}
+            frozen_map_base_t& operator=(const frozen_map_base_t&) = delete; // once_flag cannot be reset
+            frozen_map_base_t& operator=(frozen_map_base_t&&) = delete;
+
+            bool empty() const noexcept { return data_.empty(); }
+            size_t size() const noexcept { return data_.size(); }
+            const auto& data() const { freeze(); return data_; }
+            auto begin() const { freeze(); return data_.begin(); }
+            auto end() const { freeze(); return data_.end(); }
+
+            template <typename Range> void collect(Range&& rng)
+            {
+                check_not_frozen();
+                data_ = rng | ranges::to<std::vector>;
+            }
+
+            template <typename EKey, typename ... V> auto& emplace(EKey&& key, V&& ... value)
+            {
+                check_not_frozen();
+                return data_.emplace_back(std::forward<EKey>(key), Value{std::forward<V>(value) ...});
+            }
+
+            // throws map_with_unique_keys_error if keys are duplicated (unique_keys)
+            void freeze() const
+            {
+                if (!frozen_.load(std::memory_order_acquire)) {
+                    std::call_once(frozen_flag_, [this]() {
+                        std::stable_sort(std::begin(data_), std::end(data_), [](const auto& e1, const auto& e2) { return e1.first < e2.first; });
+                        if constexpr (unique_keys)
+                            duplicating_keys_ = std::adjacent_find(std::begin(data_), std::end(data_), [](const auto& e1, const auto& e2) { return e1.first == e2.first; }) != std::end(data_);
+                        if constexpr (use_index) {
+                            search_key_.build(data_);
+                            index_.build(data_, search_key_);
+                        }
+                        frozen_.store(true, std::memory_order_release);
+                    });
+                }
+                if constexpr (unique_keys) {
+                    if (duplicating_keys_)
+                        throw map_with_unique_keys_error{"duplicating keys within frozen_map_with_unique_keys_t"};
+                }
+            }
+
+          protected:
+            template <typename FindKey> const_iterator find_first(const FindKey& key) const
+            {
+                freeze();
+                const auto less = [](const auto& entry, const auto& k2) { return entry.first < k2; };
+                if constexpr (use_index) {
+                    if (const auto search_key = search_key_.make(key); search_key.has_value()) {
+                        const auto first = std::next(std::begin(data_), static_cast<typename const_iterator::difference_type>(index_.lower_bound(*search_key, data_.data())));
+                        if constexpr (!search_key_t::exact) {
+                            // first is the first entry with the same prefix (if any), entries with the same prefix are ordered by full key
+                            if (first != std::end(data_) && index_[static_cast<size_t>(first - std::begin(data_))] == *search_key && first->first < key) {
+                                const auto last = *search_key == std::numeric_limits<uint64_t>::max()
+                                                      ? std::end(data_)
+                                                      : std::next(std::begin(data_), static_cast<typename const_iterator::difference_type>(index_.lower_bound(*search_key + 1, data_.data())));
+                                return std::lower_bound(std::next(first), last, key, less);
+                            }
+                        }
+                        return first;
+                    }
+                }
+                return std::lower_bound(std::begin(data_), std::end(data_), key, less);
+            }
+
+            const_iterator end_unchecked() const noexcept { return data_.end(); } // freeze() was called by find_first()
+
+          private:
+            mutable std::vector<entry_type> data_;
+            mutable search_key_t search_key_;
+            mutable blocked_index_t index_;
+            mutable std::once_flag frozen_flag_;
+            mutable std::atomic<bool> frozen_{false};
+            mutable bool duplicating_keys_{false}; // set before frozen_
+
+            void check_not_frozen() const
+            {
+                if (frozen_.load(std::memory_order_acquire))
+                    throw frozen_map_error{"cannot modify frozen map"};
+            }
+
+        }; // class frozen_map_base_t
+
+    } // namespace detail
+
+    // thread safe replacement for map_with_duplicating_keys_t, no need to call sort() before multi-threaded use
+    template <typename Key, typename Value> class frozen_map_with_duplicating_keys_t : public detail::frozen_map_base_t<Key, Value, false>
+    {
+      public:
+        using const_iterator = typename detail::frozen_map_base_t<Key, Value, false>::const_iterator;
+
+        template <typename FindKey> std::pair<const_iterator, const_iterator> find(const FindKey& key) const
+        {
+            const auto first = this->find_first(key);
+            return {first, std::find_if(first, this->end_unchecked(), [&key](const auto& en) { return en.first != key; })};
+        }
+    };
+
+    // thread safe replacement for map_with_unique_keys_t
+    template <typename Key, typename Value> class frozen_map_with_unique_keys_t : public detail::frozen_map_base_t<Key, Value, true>
+    {
+      public:
+        template <typename FindKey> const Value* find(const FindKey& key) const
+        {
+            if (const auto first = this->find_first(key); first != this->end_unchecked() && first->first == key)
+                return &first->second;
+            else
+                return nullptr;
+        }
+    };
+
+    // ----------------------------------------------------------------------
+
+    namespace detail
+    {
+        // Open addressing (linear probing) hash index of positions in a vector of entries, slot contains position + 1, 0 - empty slot.
+        // Load factor is kept at most 1/2.
+        class position_index_t
+        {
+          public:
+            static constexpr size_t npos = static_cast<size_t>(-1);
+
+            template <typename Entries, typename Hash> position_index_t(const Entries& entries, Hash&& hash)
+            {
+                resize(entries.size() * 2);
+                for (size_t pos = 0; pos < entries.size(); ++pos)
+                    insert_slot(hash(entries[pos].first), pos);
+                used_ = entries.size();
+            }
+
+            // Hash is used to rehash existing entries when the index grows
+            template <typename Entries, typename Hash> void insert(const Entries& entries, size_t pos, Hash&& hash)
+            {
+                if ((used_ + 1) * 2 > slots_.size()) {
+                    resize(slots_.size() * 2);
+                    for (size_t old_pos = 0; old_pos < pos; ++old_pos)
+                        insert_slot(hash(entries[old_pos].first), old_pos);
+                }
+                insert_slot(hash(entries[pos].first), pos);
+                ++used_;
+            }
+
+            // position of the entry for which match(position) returns true, npos if not found
+            template <typename Match> size_t find(size_t hash, Match&& match) const
+            {
+                for (size_t slot_no = hash & mask_; slots_[slot_no] != 0; slot_no = (slot_no + 1) & mask_) {
+                    if (const size_t pos = slots_[slot_no] - 1; match(pos))
+                        return pos;
+                }
+                return npos;
+            }
+
+          private:
+            std::vector<uint32_t> slots_;
+            size_t mask_{0};
+            size_t used_{0};
+
+            void resize(size_t min_size)
+            {
+                slots_.assign(std::bit_ceil(std::max(min_size, size_t{16})), 0);
+                mask_ = slots_.size() - 1;
+            }
+
+            void insert_slot(size_t hash, size_t pos)
+            {
+                size_t slot_no = hash & mask_;
+                while (slots_[slot_no] != 0)
+                    slot_no = (slot_no + 1) & mask_;
+                slots_[slot_no] = static_cast<uint32_t>(pos + 1);
+            }
+        };
+
+    } // namespace detail
+
+    // Entries are kept in insertion order. Lookup is linear while the map is small, when the map grows up to index_threshold entries,
+    // hash index of positions is built and then updated on insertion, small maps have just a null pointer for it (8 bytes, rjson::v3::object
+    // content does not make rjson::v3::value larger with it, see static_assert in rjson-v3.hh).
+    // Index is never built or changed by const methods, concurrent lookups are safe.
+    // Keys must not be changed via iterators.
+
+    template <typename Key, typename Value, size_t index_threshold = 32> class small_map_with_unique_keys_t
     {
       public:
         using entry_type = std::pair<Key, Value>;
@@ -132,7 +516,18 @@ namespace acmacs
 
         small_map_with_unique_keys_t() = default;
         // template <typename Iter> small_map_with_unique_keys_t(Iter first, Iter last) : data_(first, last) {}
-        small_map_with_unique_keys_t(std::initializer_list<entry_type> init) : data_{init} {}
+        small_map_with_unique_keys_t(std::initializer_list<entry_type> init) : data_{init} { build_index(); }
+        small_map_with_unique_keys_t(const small_map_with_unique_keys_t& rhs) : data_{rhs.data_} { build_index(); }
+        small_map_with_unique_keys_t(small_map_with_unique_keys_t&&) = default;
+        small_map_with_unique_keys_t& operator=(const small_map_with_unique_keys_t& rhs)
+        {
+            if (this != &rhs) {
+                data_ = rhs.data_;
+                build_index();
+            }
+            return *this;
+        }
+        small_map_with_unique_keys_t& operator=(small_map_with_unique_keys_t&&) = default;
 
         constexpr const auto& data() const noexcept { return data_; }
         auto begin() const noexcept { return data_.begin(); }
@@ -144,12 +539,12 @@ namespace acmacs
 
         template <typename K> const_iterator find(const K& key) const noexcept
         {
-            return std::find_if(std::begin(data_), std::end(data_), [&key](const auto& en) { return en.first == key; });
+            return std::next(std::begin(data_), static_cast<typename const_iterator::difference_type>(find_position(key)));
         }
 
         template <typename K> iterator find(const K& key) noexcept
         {
-            return std::find_if(std::begin(data_), std::end(data_), [&key](const auto& en) { return en.first == key; });
+            return std::next(std::begin(data_), static_cast<typename iterator::difference_type>(find_position(key)));
         }
 
         template <typename K, typename Callback> void find_then(const K& key, Callback callback) const noexcept
@@ -195,7 +590,7 @@ namespace acmacs
                 return *found;
             }
             else
-                return data_.emplace_back(Key{key}, Value{std::forward<V>(value) ...});
+                return append(Key{key}, Value{std::forward<V>(value) ...});
         }
 
         template <typename K, typename ... V> auto& emplace_not_replace(const K& key, V&& ... value)
@@ -203,18 +598,69 @@ namespace acmacs
             if (auto found = find(key); found != end())
                 return *found;
             else
-                return data_.emplace_back(Key{key}, Value{std::forward<V>(value) ...});
+                return append(Key{key}, Value{std::forward<V>(value) ...});
         }
 
         template <typename Order> void sort(Order&& order)
         {
             std::sort(std::begin(data_), std::end(data_), std::forward<Order>(order));
+            build_index();
         }
 
       private:
         std::vector<entry_type> data_;
+        std::unique_ptr<detail::position_index_t> index_;
+
+        static constexpr bool string_key = std::is_convertible_v<const Key&, std::string_view>;
+        static constexpr bool indexable = string_key || requires(const Key& key) { std::hash<Key>{}(key); };
+
+        // lookup by K may use index if K is hashed the same way as Key
+        template <typename K> static constexpr bool hashable_as_key = string_key ? std::is_convertible_v<const K&, std::string_view> : std::is_same_v<K, Key>;
+
+        template <typename K> static size_t hash(const K& key) noexcept
+        {
+            if constexpr (string_key)
+                return std::hash<std::string_view>{}(std::string_view{key});
+            else if constexpr (indexable)
+                return std::hash<Key>{}(key);
+            else
+                return 0;
+        }
+
+        static size_t entry_hash(const Key& key) noexcept { return hash(key); }
+
+        template <typename K> size_t find_position(const K& key) const noexcept
+        {
+            if constexpr (indexable && hashable_as_key<K>) {
+                if (index_) {
+                    const auto pos = index_->find(hash(key), [this, &key](size_t candidate) { return data_[candidate].first == key; });
+                    return pos == detail::position_index_t::npos ? data_.size() : pos;
+                }
+            }
+            return static_cast<size_t>(std::find_if(std::begin(data_), std::end(data_), [&key](const auto& en) { return en.first == key; }) - std::begin(data_));
+        }
+
+        entry_type& append(Key&& key, Value&& value)
+        {
+            auto& entry = data_.emplace_back(std::move(key), std::move(value));
+            if constexpr (indexable) {
+                if (index_)
+                    index_->insert(data_, data_.size() - 1, entry_hash);
+                else if (data_.size() >= index_threshold)
+                    build_index();
+            }
+            return entry;
+        }
+
+        void build_index()
+        {
+            if (indexable && data_.size() >= index_threshold)
+                index_ = std::make_unique<detail::position_index_t>(data_, entry_hash);
+            else
+                index_.reset();
+        }
 
-    }; // small_map_with_unique_keys_t<Key, Value>
+    }; // small_map_with_unique_keys_t<Key, Value, index_threshold>
 
 } // namespace acmacs
 
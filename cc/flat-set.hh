@@ -2,6 +2,7 @@
 
 #include <vector>
 #include <algorithm>
+#include <iterator>
 #include "acmacs-base/fmt.hh"
 
 // ----------------------------------------------------------------------
@@ -10,6 +11,9 @@ namespace acmacs
 {
     enum class flat_set_sort_afterwards { no, yes };
 
+    // Elements are kept in insertion order until sort() or add_range() is called, after that the set stays sorted:
+    // find() and exists() use binary search, add() inserts in place, merge_from(), intersect_with() and remove() are
+    // merges of sorted ranges (galloping search in the larger set if sizes differ much).
     template <typename T> class flat_set_t
     {
       public:
@@ -23,10 +27,19 @@ namespace acmacs
         auto clear() { data_.clear(); }
 
         const auto& front() const { return data_.front(); }
-        void sort() { std::sort(std::begin(data_), std::end(data_)); }
+        bool sorted() const { return sorted_; }
 
-        template <typename Arg> auto find(Arg&& key) const { return std::find(std::begin(data_), std::end(data_), std::forward<Arg>(key)); }
-        template <typename Arg> auto find(Arg&& key) { return std::find(std::begin(data_), std::end(data_), std::forward<Arg>(key)); }
+        void sort()
+        {
+            if (!sorted_) {
+                std::sort(std::begin(data_), std::end(data_));
+                data_.erase(std::unique(std::begin(data_), std::end(data_)), std::end(data_));
+                sorted_ = true;
+            }
+        }
+
+        template <typename Arg> auto find(Arg&& key) const { return find_in(data_, key); }
+        template <typename Arg> auto find(Arg&& key) { return find_in(data_, key); }
 
         template <typename Arg> bool exists(Arg&& key) const { return find(std::forward<Arg>(key)) != std::end(data_); }
 
@@ -37,28 +50,133 @@ namespace acmacs
 
         template <typename Arg> void add(Arg&& elt, flat_set_sort_afterwards a_sort = flat_set_sort_afterwards::no)
         {
-            if (!exists(elt)) {
-                if constexpr (std::is_same_v<std::decay_t<Arg>, T>)
+            if constexpr (std::is_same_v<std::decay_t<Arg>, T>) {
+                if (sorted_) {
+                    if (const auto pos = std::lower_bound(std::begin(data_), std::end(data_), elt); pos == std::end(data_) || elt < *pos)
+                        data_.insert(pos, std::forward<Arg>(elt));
+                }
+                else if (!exists(elt)) {
                     data_.push_back(std::forward<Arg>(elt));
-                else if constexpr (std::is_constructible_v<T, Arg>)
-                    data_.push_back(T{std::forward<Arg>(elt)});
-                else
-                    static_assert(std::is_same_v<T, void>, "flat_set_t::add cannot be called with this type of argument");
-                if (a_sort == flat_set_sort_afterwards::yes)
-                    sort();
+                    if (a_sort == flat_set_sort_afterwards::yes)
+                        sort();
+                }
             }
+            else if constexpr (std::is_constructible_v<T, Arg>)
+                add(T{std::forward<Arg>(elt)}, a_sort);
+            else
+                static_assert(std::is_same_v<T, void>, "flat_set_t::add cannot be called with this type of argument");
         }
 
-        void merge_from(const flat_set_t& source, flat_set_sort_afterwards a_sort = flat_set_sort_afterwards::no)
+        // adds all elements of the range, the set is sorted afterwards, elements are sorted and deduplicated once
+        template <typename Range> void add_range(const Range& source)
         {
+            const auto old_size = static_cast<difference_type>(data_.size());
             for (const auto& src : source)
-                add(src, flat_set_sort_afterwards::no);
-            if (a_sort == flat_set_sort_afterwards::yes)
+                data_.emplace_back(src);
+            if (sorted_) {
+                std::sort(std::next(std::begin(data_), old_size), std::end(data_));
+                std::inplace_merge(std::begin(data_), std::next(std::begin(data_), old_size), std::end(data_));
+                data_.erase(std::unique(std::begin(data_), std::end(data_)), std::end(data_));
+            }
+            else
                 sort();
         }
 
+        void merge_from(const flat_set_t& source, flat_set_sort_afterwards a_sort = flat_set_sort_afterwards::no)
+        {
+            if (sorted_ && source.sorted_) {
+                std::vector<T> merged;
+                merged.reserve(data_.size() + source.data_.size());
+                std::set_union(std::begin(data_), std::end(data_), std::begin(source.data_), std::end(source.data_), std::back_inserter(merged));
+                data_ = std::move(merged);
+            }
+            else if (sorted_ || a_sort == flat_set_sort_afterwards::yes)
+                add_range(source);
+            else {
+                for (const auto& src : source)
+                    add(src, flat_set_sort_afterwards::no);
+            }
+        }
+
+        // keeps elements present in source
+        void intersect_with(const flat_set_t& source)
+        {
+            if (sorted_ && source.sorted_) {
+                if (data_.size() > source.data_.size() * gallop_ratio) { // few elements to keep, look for each of them in this set
+                    std::vector<T> common;
+                    auto first = std::begin(data_);
+                    for (const auto& src : source.data_) {
+                        first = gallop(first, std::end(data_), src);
+                        if (first == std::end(data_))
+                            break;
+                        if (!(src < *first))
+                            common.push_back(std::move(*first++));
+                    }
+                    data_ = std::move(common);
+                }
+                else
+                    filter_sorted(source, true);
+            }
+            else
+                erase_if([&source](const auto& elt) { return !source.exists(elt); });
+        }
+
+        // removes elements present in source
+        void remove(const flat_set_t& source)
+        {
+            if (sorted_ && source.sorted_)
+                filter_sorted(source, false);
+            else
+                erase_if([&source](const auto& elt) { return source.exists(elt); });
+        }
+
       private:
+        using difference_type = typename std::vector<T>::difference_type;
+        static constexpr size_t gallop_ratio = 8;
+
         std::vector<T> data_;
+        bool sorted_{false};
+
+        template <typename Vec, typename Arg> auto find_in(Vec& data, const Arg& key) const
+        {
+            if (sorted_) {
+                if (const auto found = std::lower_bound(std::begin(data), std::end(data), key); found != std::end(data) && !(key < *found))
+                    return found;
+                else
+                    return std::end(data);
+            }
+            else
+                return std::find(std::begin(data), std::end(data), key);
+        }
+
+        // first element not less than value in the sorted [first, last), exponential search from first
+        template <typename Iter> static Iter gallop(Iter first, Iter last, const T& value)
+        {
+            difference_type step = 1;
+            auto bound = first;
+            while (std::distance(bound, last) > step && *std::next(bound, step) < value) {
+                bound = std::next(bound, step);
+                step *= 2;
+            }
+            return std::lower_bound(bound, std::distance(bound, last) > step ? std::next(bound, step + 1) : last, value);
+        }
+
+        // keeps elements of this set that are (keep_present) or are not (!keep_present) in source, both sets are sorted
+        void filter_sorted(const flat_set_t& source, bool keep_present)
+        {
+            const bool use_gallop = source.data_.size() > data_.size() * gallop_ratio;
+            auto src = std::begin(source.data_);
+            auto kept = std::begin(data_);
+            for (auto& elt : data_) {
+                src = use_gallop ? gallop(src, std::end(source.data_), elt) : std::find_if_not(src, std::end(source.data_), [&elt](const auto& se) { return se < elt; });
+                if ((src != std::end(source.data_) && !(elt < *src)) == keep_present) {
+                    if (&*kept != &elt) // self-move-assignment may leave the element empty
+                        *kept = std::move(elt);
+                    ++kept;
+                }
+            }
+            data_.erase(kept, std::end(data_));
+        }
     };
 
 } // namespace acmacs
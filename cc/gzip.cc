@@ -1,50 +1,75 @@
 #include <stdexcept>
+#include <limits>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
 #include <zlib.h>
 
 #include "acmacs-base/gzip.hh"
 
 // ----------------------------------------------------------------------
 
-std::string acmacs::file::gzip_compress(std::string_view input)
+namespace acmacs::file::gzip_internal
 {
-    constexpr ssize_t BufSize = 409600;
+    constexpr size_t MaxChunk = std::numeric_limits<uInt>::max(); // avail_in and avail_out are 32 bit
+    constexpr size_t ParallelThreshold = 4 * 1024 * 1024;
+    constexpr size_t ParallelBlockSize = 128 * 1024;
+    constexpr size_t DictionarySize = 32 * 1024;
+
+    static std::string compress_serial(std::string_view input, int level);
+    static std::string compress_parallel(std::string_view input, int level, uint32_t threads);
+
+} // namespace acmacs::file::gzip_internal
+
+// ----------------------------------------------------------------------
+
+std::string acmacs::file::gzip_compress(std::string_view input, const compression_policy& policy)
+{
+    const auto level = policy.level_for(gzip_levels);
+    const auto threads = policy.threads == 0 ? std::thread::hardware_concurrency() : policy.threads;
+    if (threads > 1 && input.size() > gzip_internal::ParallelThreshold)
+        return gzip_internal::compress_parallel(input, level, threads);
+    else
+        return gzip_internal::compress_serial(input, level);
+
+} // acmacs::file::gzip_compress
+
+// ----------------------------------------------------------------------
+
+std::string acmacs::file::gzip_internal::compress_serial(std::string_view input, int level)
+{
+    constexpr size_t BufSize = 409600;
     z_stream strm;
-    std::string output(BufSize, ' ');
-    ssize_t offset = 0;
-
-    auto advance = [&strm, &output, &offset]() {
-        offset += BufSize;
-        output.resize(static_cast<size_t>(offset + BufSize));
-        strm.next_out = reinterpret_cast<decltype(strm.next_out)>(output.data() + offset);
-        strm.avail_out = BufSize;
-    };
+    std::string output(std::max(input.size() / 4, BufSize), ' ');
+    size_t offset = 0, input_offset = 0;
 
     strm.zalloc = Z_NULL;
     strm.zfree = Z_NULL;
-    strm.next_in = reinterpret_cast<decltype(strm.next_in)>(const_cast<char*>(input.data()));
-    strm.total_in = strm.avail_in = static_cast<decltype(strm.avail_in)>(input.size());
-    if (deflateInit2(&strm, Z_BEST_COMPRESSION, Z_DEFLATED, 15 | 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+    strm.opaque = Z_NULL;
+    strm.avail_in = 0;
+    if (deflateInit2(&strm, level, Z_DEFLATED, 15 | 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
         throw std::runtime_error("gzip compression failed during initialization");
 
     try {
-        strm.next_out = reinterpret_cast<decltype(strm.next_out)>(output.data() + offset);
-        strm.avail_out = BufSize;
-        while (strm.avail_in != 0) {
-            if (int res = deflate(&strm, Z_NO_FLUSH); res != Z_OK)
-                throw std::runtime_error("gzip compression failed, code: " + std::to_string(res));
-            if (strm.avail_out == 0)
-                advance();
-        }
-
         int deflate_res = Z_OK;
         while (deflate_res == Z_OK) {
-            if (strm.avail_out == 0)
-                advance();
-            deflate_res = deflate(&strm, Z_FINISH);
+            if (strm.avail_in == 0 && input_offset < input.size()) {
+                strm.next_in = reinterpret_cast<decltype(strm.next_in)>(const_cast<char*>(input.data() + input_offset));
+                strm.avail_in = static_cast<decltype(strm.avail_in)>(std::min(input.size() - input_offset, MaxChunk));
+                input_offset += strm.avail_in;
+            }
+            if (offset == output.size())
+                output.resize(output.size() * 2);
+            const auto out_chunk = std::min(output.size() - offset, MaxChunk);
+            strm.next_out = reinterpret_cast<decltype(strm.next_out)>(output.data() + offset);
+            strm.avail_out = static_cast<decltype(strm.avail_out)>(out_chunk);
+            deflate_res = deflate(&strm, input_offset == input.size() ? Z_FINISH : Z_NO_FLUSH);
+            offset += out_chunk - strm.avail_out;
         }
         if (deflate_res != Z_STREAM_END)
             throw std::runtime_error("gzip compression failed, code: " + std::to_string(deflate_res));
-        output.resize(static_cast<size_t>(offset + BufSize) - strm.avail_out);
+        output.resize(offset);
 
         deflateEnd(&strm);
         return output;
@@ -54,46 +79,167 @@ std::string acmacs::file::gzip_compress(std::string_view input)
         throw;
     }
 
-} // acmacs::file::gzip_compress
+} // acmacs::file::gzip_internal::compress_serial
+
+// ----------------------------------------------------------------------
+
+// pigz style: input is split into blocks deflated independently (raw deflate primed with the last 32KiB of the preceding block as
+// dictionary), all blocks but the last end with sync flush (byte aligned, not final), concatenation is a single standard gzip member
+std::string acmacs::file::gzip_internal::compress_parallel(std::string_view input, int level, uint32_t threads)
+{
+    const size_t number_of_blocks = (input.size() + ParallelBlockSize - 1) / ParallelBlockSize;
+    std::vector<std::string> blocks(number_of_blocks);
+    std::vector<uLong> crcs(number_of_blocks);
+    std::atomic<size_t> next_block{0};
+    std::exception_ptr error;
+    std::mutex error_access;
+
+    const auto worker = [&]() {
+        try {
+            for (auto block_no = next_block++; block_no < number_of_blocks; block_no = next_block++) {
+                const auto start = block_no * ParallelBlockSize;
+                const auto chunk = input.substr(start, ParallelBlockSize);
+                const bool last = (block_no + 1) == number_of_blocks;
+                crcs[block_no] = crc32(0L, reinterpret_cast<const Bytef*>(chunk.data()), static_cast<uInt>(chunk.size()));
+
+                z_stream strm;
+                strm.zalloc = Z_NULL;
+                strm.zfree = Z_NULL;
+                strm.opaque = Z_NULL;
+                if (deflateInit2(&strm, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+                    throw std::runtime_error("gzip compression failed during initialization");
+                if (start > 0) {
+                    const auto dictionary = input.substr(start - std::min(start, DictionarySize), std::min(start, DictionarySize));
+                    deflateSetDictionary(&strm, reinterpret_cast<const Bytef*>(dictionary.data()), static_cast<uInt>(dictionary.size()));
+                }
+                auto& output = blocks[block_no];
+                output.resize(deflateBound(&strm, static_cast<uLong>(chunk.size())) + 16); // sync flush adds up to 5 bytes beyond the bound
+                strm.next_in = reinterpret_cast<decltype(strm.next_in)>(const_cast<char*>(chunk.data()));
+                strm.avail_in = static_cast<decltype(strm.avail_in)>(chunk.size());
+                strm.next_out = reinterpret_cast<decltype(strm.next_out)>(output.data());
+                strm.avail_out = static_cast<decltype(strm.avail_out)>(output.size());
+                const auto res = deflate(&strm, last ? Z_FINISH : Z_SYNC_FLUSH);
+                const auto avail_out = strm.avail_out, avail_in = strm.avail_in;
+                deflateEnd(&strm);
+                if ((last && res != Z_STREAM_END) || (!last && res != Z_OK) || avail_in != 0 || avail_out == 0)
+                    throw std::runtime_error("gzip compression failed, code: " + std::to_string(res));
+                output.resize(output.size() - avail_out);
+            }
+        }
+        catch (std::exception&) {
+            std::lock_guard<std::mutex> lock{error_access};
+            error = std::current_exception();
+            next_block = number_of_blocks;
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (uint32_t thread_no = 1; thread_no < std::min(static_cast<size_t>(threads), number_of_blocks); ++thread_no)
+        workers.emplace_back(worker);
+    worker();
+    for (auto& thread : workers)
+        thread.join();
+    if (error)
+        std::rethrow_exception(error);
+
+    uLong crc = crcs[0];
+    size_t compressed_size = 0;
+    for (size_t block_no = 0; block_no < number_of_blocks; ++block_no) {
+        if (block_no > 0)
+            crc = crc32_combine(crc, crcs[block_no], static_cast<z_off_t>(std::min(ParallelBlockSize, input.size() - block_no * ParallelBlockSize)));
+        compressed_size += blocks[block_no].size();
+    }
+
+    const auto trailer_value = [](std::string& target, uLong value) {
+        for (int byte = 0; byte < 4; ++byte)
+            target.push_back(static_cast<char>((value >> (byte * 8)) & 0xFF));
+    };
+
+    std::string output{"\x1F\x8B\x08\x00\x00\x00\x00\x00\x00\x03", 10}; // magic, deflate, no flags, no mtime, extra flags (set below), unix
+    if (level == Z_BEST_COMPRESSION)
+        output[8] = 2;
+    else if (level == Z_BEST_SPEED)
+        output[8] = 4;
+    output.reserve(output.size() + compressed_size + 8);
+    for (const auto& block : blocks)
+        output.append(block);
+    trailer_value(output, crc);
+    trailer_value(output, static_cast<uLong>(input.size() & 0xFFFFFFFF));
+    return output;
+
+} // acmacs::file::gzip_internal::compress_parallel
+
+// ----------------------------------------------------------------------
+
+size_t acmacs::file::gzip_uncompressed_size_hint(std::string_view input)
+{
+    constexpr size_t header_trailer_size = 18, max_deflate_ratio = 1032;
+    if (input.size() < header_trailer_size)
+        return 0;
+    const auto* trailer = reinterpret_cast<const unsigned char*>(input.data() + input.size() - 4);
+    const size_t isize = static_cast<size_t>(trailer[0]) | (static_cast<size_t>(trailer[1]) << 8) | (static_cast<size_t>(trailer[2]) << 16) | (static_cast<size_t>(trailer[3]) << 24);
+    if (isize > input.size() * max_deflate_ratio)
+        return 0;
+    return isize;
+
+} // acmacs::file::gzip_uncompressed_size_hint
 
 // ----------------------------------------------------------------------
 
 std::string acmacs::file::gzip_decompress(std::string_view input)
 {
-    constexpr ssize_t BufSize = 409600;
+    std::string output;
+    gzip_decompress(input, output);
+    return output;
+
+} // acmacs::file::gzip_decompress
+
+// ----------------------------------------------------------------------
+
+void acmacs::file::gzip_decompress(std::string_view input, std::string& output)
+{
+    constexpr size_t BufSize = 409600;
+    constexpr size_t MaxChunk = std::numeric_limits<uInt>::max(); // avail_in and avail_out are 32 bit
     z_stream strm;
     strm.zalloc = Z_NULL;
     strm.zfree = Z_NULL;
     strm.opaque = Z_NULL;
     strm.next_in = reinterpret_cast<decltype(strm.next_in)>(const_cast<char*>(input.data()));
-    strm.total_in = strm.avail_in = static_cast<decltype(strm.avail_in)>(input.size());
+    strm.avail_in = static_cast<decltype(strm.avail_in)>(std::min(input.size(), MaxChunk));
+    size_t input_offset = strm.avail_in;
 
     if (inflateInit2(&strm, 15 + 32) != Z_OK) // 15 window bits, and the +32 tells zlib to to detect if using gzip or zlib
         throw std::runtime_error("gzip decompression failed during initialization");
 
     try {
-        std::string output(BufSize, ' ');
-        ssize_t offset = 0;
+        // one extra byte lets inflate reach Z_STREAM_END without growing output if the hint is exact
+        if (const auto hint = gzip_uncompressed_size_hint(input); hint > 0)
+            output.resize(hint + 1);
+        else
+            output.resize(std::max(input.size() * 4, BufSize));
+        size_t offset = 0;
         for (;;) {
-            strm.next_out = reinterpret_cast<decltype(strm.next_out)>(output.data() + offset);
-            strm.avail_out = BufSize;
-            auto const r = inflate(&strm, Z_NO_FLUSH);
-            if (r == Z_OK) {
-                if (strm.avail_out > 0)
-                    throw std::runtime_error("gzip decompression failed: unexpected end of input");
-                offset += BufSize;
-                output.resize(static_cast<size_t>(offset + BufSize));
+            if (strm.avail_in == 0 && input_offset < input.size()) {
+                strm.next_in = reinterpret_cast<decltype(strm.next_in)>(const_cast<char*>(input.data() + input_offset));
+                strm.avail_in = static_cast<decltype(strm.avail_in)>(std::min(input.size() - input_offset, MaxChunk));
+                input_offset += strm.avail_in;
             }
-            else if (r == Z_STREAM_END) {
-                output.resize(static_cast<size_t>(offset + BufSize) - strm.avail_out);
+            if (offset == output.size())
+                output.resize(output.size() * 2);
+            const auto out_chunk = std::min(output.size() - offset, MaxChunk);
+            strm.next_out = reinterpret_cast<decltype(strm.next_out)>(output.data() + offset);
+            strm.avail_out = static_cast<decltype(strm.avail_out)>(out_chunk);
+            const auto r = inflate(&strm, Z_NO_FLUSH);
+            offset += out_chunk - strm.avail_out;
+            if (r == Z_STREAM_END)
                 break;
-            }
-            else {
+            else if (r == Z_BUF_ERROR)
+                throw std::runtime_error("gzip decompression failed: unexpected end of input");
+            else if (r != Z_OK)
                 throw std::runtime_error("gzip decompression failed, code: " + std::to_string(r));
-            }
         }
+        output.resize(offset);
         inflateEnd(&strm);
-        return output;
     }
     catch (std::exception&) {
         inflateEnd(&strm);
@@ -2,8 +2,11 @@
 
 #include <string>
 #include <string_view>
+#include <cstdint>
 #include <cstring>
 
+#include "acmacs-base/compression.hh"
+
 // ----------------------------------------------------------------------
 
 namespace acmacs::file
@@ -17,8 +20,15 @@ namespace acmacs::file
       // ----------------------------------------------------------------------
 
     inline bool gzip_compressed(const char* input) { return std::memcmp(input, gzip_internal::sGzipSig, sizeof(gzip_internal::sGzipSig)) == 0; }
-    std::string gzip_compress(std::string_view input);
+      // levels: fastest - 1, balanced - 6, best - 9, explicit level is clamped to 0-9
+    constexpr compression_levels gzip_levels{.fastest = 1, .balanced = 6, .best = 9, .min = 0, .max = 9};
+      // with more than one thread input larger than 4MiB is compressed by blocks in parallel, output is a single gzip member in both cases
+    std::string gzip_compress(std::string_view input, const compression_policy& policy = default_compression_policy());
     std::string gzip_decompress(std::string_view input);
+      // decompresses into output replacing its content, capacity of output is reused
+    void gzip_decompress(std::string_view input, std::string& output);
+      // uncompressed size from the ISIZE trailer (modulo 2^32, last member only), 0 if it does not look plausible
+    size_t gzip_uncompressed_size_hint(std::string_view input);
 
 } // namespace acmacs::file
 
@@ -0,0 +1,28 @@
+#include "acmacs-base/read-file.hh"
+#include "acmacs-base/hash-file.hh"
+
+// ----------------------------------------------------------------------
+
+// file is read once from start to end
+static constexpr acmacs::file::read_hints hash_read_hints{.pattern = acmacs::file::access_pattern::sequential};
+
+// ----------------------------------------------------------------------
+
+uint64_t acmacs::hash64_file(std::string_view filename)
+{
+    return hash64(file::read_access{filename, hash_read_hints}.raw());
+
+} // acmacs::hash64_file
+
+// ----------------------------------------------------------------------
+
+acmacs::hash128_t acmacs::hash128_file(std::string_view filename)
+{
+    return hash128(file::read_access{filename, hash_read_hints}.raw());
+
+} // acmacs::hash128_file
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
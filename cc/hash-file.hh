@@ -0,0 +1,18 @@
+#pragma once
+
+#include "acmacs-base/hash.hh"
+
+// ----------------------------------------------------------------------
+
+namespace acmacs
+{
+    // content of the file as stored (compressed files are not decompressed), "-" is stdin
+    uint64_t hash64_file(std::string_view filename);
+    hash128_t hash128_file(std::string_view filename);
+
+} // namespace acmacs
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
@@ -20,17 +20,109 @@
 #define XXH_INLINE_ALL
 #include "acmacs-base/xxhash.h"
 
+#include <cstdint>
+#include <compare>
+#include <unordered_map>
+#include <unordered_set>
+
 #include "acmacs-base/fmt.hh"
 
 // ----------------------------------------------------------------------
 
 namespace acmacs
 {
+    // XXH32 as 8 hex digits, short but collision-prone, use hash64/hash128 for content addressing and hash tables
     inline std::string hash(std::string_view source)
     {
         return fmt::format("{:08X}", XXH32(source.data(), source.size(), 0));
     }
-}
+
+    // ----------------------------------------------------------------------
+    // XXH3
+
+    struct hash128_t
+    {
+        uint64_t high{0};
+        uint64_t low{0};
+
+        constexpr bool operator==(const hash128_t&) const = default;
+        constexpr auto operator<=>(const hash128_t&) const = default;
+
+        std::string hex() const { return fmt::format("{:016x}{:016x}", high, low); }
+    };
+
+    inline uint64_t hash64(std::string_view source, uint64_t seed = 0) { return XXH3_64bits_withSeed(source.data(), source.size(), seed); }
+
+    inline hash128_t hash128(std::string_view source, uint64_t seed = 0)
+    {
+        const auto result = XXH3_128bits_withSeed(source.data(), source.size(), seed);
+        return {result.high64, result.low64};
+    }
+
+    // incremental hashing, digest of chunks passed to update() is equal to hash64/hash128 of their concatenation
+    class hasher64
+    {
+      public:
+        explicit hasher64(uint64_t seed = 0)
+        {
+            XXH3_INITSTATE(&state_); // reset with seed reuses secret if state_.seed is equal to seed, it must not be garbage
+            reset(seed);
+        }
+        void reset(uint64_t seed = 0) { XXH3_64bits_reset_withSeed(&state_, seed); }
+        hasher64& update(std::string_view chunk) { XXH3_64bits_update(&state_, chunk.data(), chunk.size()); return *this; }
+        uint64_t digest() const { return XXH3_64bits_digest(&state_); }
+
+      private:
+        XXH3_state_t state_;
+    };
+
+    class hasher128
+    {
+      public:
+        explicit hasher128(uint64_t seed = 0)
+        {
+            XXH3_INITSTATE(&state_); // reset with seed reuses secret if state_.seed is equal to seed, it must not be garbage
+            reset(seed);
+        }
+        void reset(uint64_t seed = 0) { XXH3_128bits_reset_withSeed(&state_, seed); }
+        hasher128& update(std::string_view chunk) { XXH3_128bits_update(&state_, chunk.data(), chunk.size()); return *this; }
+        hash128_t digest() const
+        {
+            const auto result = XXH3_128bits_digest(&state_);
+            return {result.high64, result.low64};
+        }
+
+      private:
+        XXH3_state_t state_;
+    };
+
+    // hash64_file() and hash128_file() are in acmacs-base/hash-file.hh
+
+    // ----------------------------------------------------------------------
+    // transparent hash for unordered containers with std::string keys, lookup by std::string_view or const char* does not construct std::string
+    // requires std::equal_to<> as key equality, see string_hash_map and string_hash_set
+
+    struct string_hash
+    {
+        using is_transparent = void;
+        size_t operator()(std::string_view source) const noexcept { return static_cast<size_t>(hash64(source)); }
+    };
+
+    template <typename Value> using string_hash_map = std::unordered_map<std::string, Value, string_hash, std::equal_to<>>;
+    using string_hash_set = std::unordered_set<std::string, string_hash, std::equal_to<>>;
+
+} // namespace acmacs
+
+// XXH3 output is uniformly distributed, any 64 bits of it is good enough for hash tables
+template <> struct std::hash<acmacs::hash128_t>
+{
+    size_t operator()(const acmacs::hash128_t& value) const noexcept { return static_cast<size_t>(value.low); }
+};
+
+template <> struct fmt::formatter<acmacs::hash128_t> : fmt::formatter<std::string>
+{
+    template <typename FormatCtx> auto format(const acmacs::hash128_t& value, FormatCtx& ctx) const { return fmt::formatter<std::string>::format(value.hex(), ctx); }
+};
 
 // ----------------------------------------------------------------------
 
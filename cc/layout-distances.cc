@@ -0,0 +1,153 @@
+#include <array>
+#include <thread>
+#include <atomic>
+#include <exception>
+
+#include "acmacs-base/layout-distances.hh"
+
+// ----------------------------------------------------------------------
+
+namespace
+{
+    // coordinates of column_tile_size points of a layout in dimension-major order (at most 3 * 4KiB) are kept in L1 cache
+    // while distances to them from row_tile_size points are computed
+    constexpr size_t row_tile_size = 64;
+    constexpr size_t column_tile_size = 512;
+
+    struct tile_t
+    {
+        size_t first_row, last_row, first_column, last_column;
+        bool upper; // distances for columns above the diagonal only
+    };
+
+    inline std::vector<tile_t> make_tiles(size_t first_row, size_t last_row, size_t first_column, size_t last_column, bool upper)
+    {
+        std::vector<tile_t> tiles;
+        for (size_t row = first_row; row < last_row; row += row_tile_size) {
+            const auto row_end = std::min(row + row_tile_size, last_row);
+            for (size_t column = upper ? row + 1 : first_column; column < last_column; column += column_tile_size)
+                tiles.push_back(tile_t{row, row_end, column, std::min(column + column_tile_size, last_column), upper});
+        }
+        return tiles;
+    }
+
+    // num_dim is known at compile time, the loop over columns is vectorized
+    template <size_t num_dim> inline void row_distances(const acmacs::LayoutSoA& soa, size_t point_no, size_t first_column, size_t last_column, double* target)
+    {
+        std::array<const double*, num_dim> coordinates;
+        std::array<double, num_dim> point;
+        for (size_t dim = 0; dim < num_dim; ++dim) {
+            coordinates[dim] = soa.dimension(acmacs::number_of_dimensions_t{dim}).data();
+            point[dim] = coordinates[dim][point_no];
+        }
+        for (size_t column = first_column; column < last_column; ++column, ++target) {
+            double sum{0.0};
+            for (size_t dim = 0; dim < num_dim; ++dim) {
+                const double diff = coordinates[dim][column] - point[dim];
+                sum += diff * diff;
+            }
+            *target = std::sqrt(sum);
+        }
+    }
+
+    // any number of dimensions: squared differences are accumulated in target dimension by dimension
+    inline void row_distances(const acmacs::LayoutSoA& soa, size_t point_no, size_t first_column, size_t last_column, double* target)
+    {
+        const size_t size = last_column - first_column;
+        std::fill(target, target + size, 0.0);
+        for (acmacs::number_of_dimensions_t dim{0}; dim < soa.number_of_dimensions(); ++dim) {
+            const double* coordinates = soa.dimension(dim).data() + first_column;
+            const double point = soa.dimension(dim)[point_no];
+            for (size_t column = 0; column < size; ++column) {
+                const double diff = coordinates[column] - point;
+                target[column] += diff * diff;
+            }
+        }
+        for (size_t column = 0; column < size; ++column)
+            target[column] = std::sqrt(target[column]);
+    }
+
+    // target(row, first_column) returns pointer where distances from the row to [first_column, last_column) are written
+    template <typename Target> void compute_tile(const acmacs::LayoutSoA& soa, const tile_t& tile, Target target)
+    {
+        for (size_t row = tile.first_row; row < tile.last_row; ++row) {
+            const auto first = tile.upper ? std::max(tile.first_column, row + 1) : tile.first_column;
+            if (first < tile.last_column) {
+                switch (*soa.number_of_dimensions()) {
+                    case 2:
+                        row_distances<2>(soa, row, first, tile.last_column, target(row, first));
+                        break;
+                    case 3:
+                        row_distances<3>(soa, row, first, tile.last_column, target(row, first));
+                        break;
+                    default:
+                        row_distances(soa, row, first, tile.last_column, target(row, first));
+                        break;
+                }
+            }
+        }
+    }
+
+    template <typename Target> void compute_tiles(const acmacs::LayoutSoA& soa, const std::vector<tile_t>& tiles, size_t threads, Target target)
+    {
+        if (threads == 0)
+            threads = std::thread::hardware_concurrency();
+        threads = std::min(threads, tiles.size());
+        if (threads < 2) {
+            for (const auto& tile : tiles)
+                compute_tile(soa, tile, target);
+            return;
+        }
+
+        std::atomic<size_t> next_tile{0};
+        std::vector<std::exception_ptr> errors(threads);
+        std::vector<std::thread> workers;
+        for (size_t thread_no = 0; thread_no < threads; ++thread_no) {
+            workers.emplace_back([&, thread_no]() {
+                try {
+                    for (size_t tile_no = next_tile++; tile_no < tiles.size(); tile_no = next_tile++)
+                        compute_tile(soa, tiles[tile_no], target);
+                }
+                catch (...) {
+                    errors[thread_no] = std::current_exception();
+                }
+            });
+        }
+        for (auto& worker : workers)
+            worker.join();
+        for (const auto& err : errors) {
+            if (err)
+                std::rethrow_exception(err);
+        }
+    }
+
+} // namespace
+
+// ----------------------------------------------------------------------
+
+acmacs::LayoutDistances::LayoutDistances(const Layout& layout, size_t threads)
+    : number_of_points_{layout.number_of_points()}, distances_(number_of_points_ > 1 ? number_of_points_ * (number_of_points_ - 1) / 2 : 0)
+{
+    const LayoutSoA soa{layout};
+    compute_tiles(soa, make_tiles(0, number_of_points_, 0, number_of_points_, true), threads, [this](size_t row, size_t first_column) { return distances_.data() + index(row, first_column); });
+
+} // acmacs::LayoutDistances::LayoutDistances
+
+// ----------------------------------------------------------------------
+
+acmacs::LayoutDistancesAntigensSera::LayoutDistancesAntigensSera(const Layout& layout, size_t number_of_antigens, size_t threads)
+    : number_of_antigens_{number_of_antigens}, number_of_sera_{layout.number_of_points() - std::min(number_of_antigens, layout.number_of_points())}
+{
+    if (number_of_antigens > layout.number_of_points())
+        throw std::runtime_error{fmt::format("LayoutDistancesAntigensSera: invalid number of antigens {} for layout of {} points", number_of_antigens, layout.number_of_points())};
+    distances_.resize(number_of_antigens_ * number_of_sera_);
+    const LayoutSoA soa{layout};
+    compute_tiles(soa, make_tiles(0, number_of_antigens_, number_of_antigens_, layout.number_of_points(), false), threads,
+                  [this](size_t antigen_no, size_t first_column) { return distances_.data() + antigen_no * number_of_sera_ + (first_column - number_of_antigens_); });
+
+} // acmacs::LayoutDistancesAntigensSera::LayoutDistancesAntigensSera
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "acmacs-base/layout-soa.hh"
+
+// ----------------------------------------------------------------------
+
+namespace acmacs
+{
+    // Distances between all pairs of points of a layout, symmetric matrix is stored as packed upper triangle without
+    // the diagonal. Computed in tiles: coordinates of a block of points (dimension-major copy of the layout) stay in
+    // L1 cache while distances from a block of rows are written, tiles are distributed among threads.
+    // Distance to or from a disconnected point (NaN coordinates) is NaN, operator() returns no_distance for it,
+    // diagonal is not stored, distance of any point to itself is 0.
+    // threads: 0 - use all cpus
+    class LayoutDistances
+    {
+      public:
+        LayoutDistances() = default;
+        explicit LayoutDistances(const Layout& layout, size_t threads = 0);
+
+        size_t number_of_points() const noexcept { return number_of_points_; }
+
+        double operator()(size_t p1, size_t p2, double no_distance = std::numeric_limits<double>::quiet_NaN()) const
+        {
+            if (p1 == p2)
+                return 0.0;
+            if (const auto dist = distances_[p1 < p2 ? index(p1, p2) : index(p2, p1)]; !std::isnan(dist))
+                return dist;
+            else
+                return no_distance;
+        }
+
+        // distances from point_no to points point_no+1 .. number_of_points()-1
+        const double* row(size_t point_no) const { return distances_.data() + index(point_no, point_no + 1); }
+        const std::vector<double>& packed() const noexcept { return distances_; }
+
+      private:
+        size_t number_of_points_{0};
+        std::vector<double> distances_;
+
+        size_t index(size_t p1, size_t p2) const noexcept { return p1 * number_of_points_ - p1 * (p1 + 1) / 2 + (p2 - p1 - 1); } // p1 < p2
+    };
+
+    // ----------------------------------------------------------------------
+
+    // Rectangular block of distances between antigens (points [0, number_of_antigens)) and sera (the rest of the points),
+    // stored row-major by antigen, serum_no is relative to the first serum as in begin_sera().
+    class LayoutDistancesAntigensSera
+    {
+      public:
+        LayoutDistancesAntigensSera() = default;
+        LayoutDistancesAntigensSera(const Layout& layout, size_t number_of_antigens, size_t threads = 0);
+
+        size_t number_of_antigens() const noexcept { return number_of_antigens_; }
+        size_t number_of_sera() const noexcept { return number_of_sera_; }
+
+        double operator()(size_t antigen_no, size_t serum_no, double no_distance = std::numeric_limits<double>::quiet_NaN()) const
+        {
+            if (const auto dist = distances_[antigen_no * number_of_sera_ + serum_no]; !std::isnan(dist))
+                return dist;
+            else
+                return no_distance;
+        }
+
+        // distances from antigen_no to all sera
+        const double* row(size_t antigen_no) const { return distances_.data() + antigen_no * number_of_sera_; }
+
+      private:
+        size_t number_of_antigens_{0};
+        size_t number_of_sera_{0};
+        std::vector<double> distances_;
+    };
+
+} // namespace acmacs
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
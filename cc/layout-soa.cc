@@ -0,0 +1,214 @@
+#include <array>
+
+#include "acmacs-base/layout-soa.hh"
+
+// ----------------------------------------------------------------------
+
+acmacs::LayoutSoA::LayoutSoA(const Layout& source)
+    : LayoutSoA(source.number_of_points(), source.number_of_dimensions())
+{
+    const size_t num_dim = *source.number_of_dimensions();
+    const double* coord = source.as_flat_vector_double().data();
+    for (size_t point_no = 0; point_no < number_of_points(); ++point_no, coord += num_dim) {
+        for (size_t dim = 0; dim < num_dim; ++dim)
+            dimensions_[dim][point_no] = coord[dim];
+    }
+
+} // acmacs::LayoutSoA::LayoutSoA
+
+// ----------------------------------------------------------------------
+
+acmacs::LayoutSoA::LayoutSoA(const LayoutSoA& source, const std::vector<size_t>& indexes)
+    : LayoutSoA(indexes.size(), source.number_of_dimensions())
+{
+    for (size_t dim = 0; dim < dimensions_.size(); ++dim) {
+        const auto& source_dim = source.dimensions_[dim];
+        std::transform(std::begin(indexes), std::end(indexes), std::begin(dimensions_[dim]), [&source_dim](size_t index) { return source_dim[index]; });
+    }
+
+} // acmacs::LayoutSoA::LayoutSoA
+
+// ----------------------------------------------------------------------
+
+acmacs::Layout acmacs::LayoutSoA::to_layout() const
+{
+    const size_t num_dim = dimensions_.size();
+    Layout result(number_of_points(), number_of_dimensions());
+    double* coord = result.data();
+    for (size_t point_no = 0; point_no < number_of_points(); ++point_no, coord += num_dim) {
+        for (size_t dim = 0; dim < num_dim; ++dim)
+            coord[dim] = dimensions_[dim][point_no];
+    }
+    return result;
+
+} // acmacs::LayoutSoA::to_layout
+
+// ----------------------------------------------------------------------
+
+std::vector<std::vector<double>> acmacs::LayoutSoA::as_vector_of_vectors_double() const
+{
+    std::vector<std::vector<double>> result(number_of_points(), std::vector<double>(dimensions_.size()));
+    for (size_t dim = 0; dim < dimensions_.size(); ++dim) {
+        for (size_t point_no = 0; point_no < number_of_points(); ++point_no)
+            result[point_no][dim] = dimensions_[dim][point_no];
+    }
+    return result;
+
+} // acmacs::LayoutSoA::as_vector_of_vectors_double
+
+// ----------------------------------------------------------------------
+
+void acmacs::LayoutSoA::remove_points(const ReverseSortedIndexes& indexes, size_t base)
+{
+    std::vector<char> to_remove(number_of_points(), 0);
+    for (const auto index : indexes)
+        to_remove[index + base] = 1;
+    for (auto& dim : dimensions_) {
+        size_t kept = 0;
+        for (size_t point_no = 0; point_no < dim.size(); ++point_no) {
+            if (!to_remove[point_no])
+                dim[kept++] = dim[point_no];
+        }
+        dim.resize(kept);
+    }
+
+} // acmacs::LayoutSoA::remove_points
+
+// ----------------------------------------------------------------------
+
+// Comparisons with NaN are false, i.e. NaN never replaces the current min or max, the loops have no branches.
+// Compiler does not reorder floating point min/max reduction, it is vectorized by keeping independent min and max for each lane.
+
+static inline std::pair<double, double> minmax_skip_nan(const std::vector<double>& source)
+{
+    constexpr size_t lanes = 4;
+    std::array<double, lanes> min, max;
+    min.fill(std::numeric_limits<double>::infinity());
+    max.fill(-std::numeric_limits<double>::infinity());
+    size_t no = 0;
+    for (; (no + lanes) <= source.size(); no += lanes) {
+        for (size_t lane = 0; lane < lanes; ++lane) {
+            min[lane] = source[no + lane] < min[lane] ? source[no + lane] : min[lane];
+            max[lane] = source[no + lane] > max[lane] ? source[no + lane] : max[lane];
+        }
+    }
+    for (; no < source.size(); ++no) {
+        min[0] = source[no] < min[0] ? source[no] : min[0];
+        max[0] = source[no] > max[0] ? source[no] : max[0];
+    }
+    return {*std::min_element(std::begin(min), std::end(min)), *std::max_element(std::begin(max), std::end(max))};
+}
+
+std::vector<std::pair<double, double>> acmacs::LayoutSoA::minmax() const
+{
+    std::vector<std::pair<double, double>> result(dimensions_.size());
+    for (size_t dim = 0; dim < dimensions_.size(); ++dim) {
+        if (const auto [min, max] = minmax_skip_nan(dimensions_[dim]); min <= max) // there are coordinates which are not NaN, {0, 0} otherwise as in Layout::minmax()
+            result[dim] = std::pair(min, max);
+    }
+    return result;
+
+} // acmacs::LayoutSoA::minmax
+
+// ----------------------------------------------------------------------
+
+std::pair<std::vector<size_t>, std::vector<size_t>> acmacs::LayoutSoA::min_max_point_indexes() const
+{
+    const auto boundaries = minmax();
+    std::vector<size_t> min_points(dimensions_.size(), 0), max_points(dimensions_.size(), 0);
+    const auto index_of = [](const std::vector<double>& coord, double val) -> size_t {
+        if (const auto found = std::find(std::begin(coord), std::end(coord), val); found != std::end(coord))
+            return static_cast<size_t>(found - std::begin(coord));
+        else
+            return 0; // all coordinates are NaN
+    };
+    for (size_t dim = 0; dim < dimensions_.size(); ++dim) {
+        min_points[dim] = index_of(dimensions_[dim], boundaries[dim].first);
+        max_points[dim] = index_of(dimensions_[dim], boundaries[dim].second);
+    }
+    return {min_points, max_points};
+
+} // acmacs::LayoutSoA::min_max_point_indexes
+
+// ----------------------------------------------------------------------
+
+acmacs::Area acmacs::LayoutSoA::area() const
+{
+    const auto boundaries = minmax();
+    PointCoordinates min(number_of_dimensions()), max(number_of_dimensions());
+    for (number_of_dimensions_t dim{0}; dim < number_of_dimensions(); ++dim) {
+        min[dim] = boundaries[*dim].first;
+        max[dim] = boundaries[*dim].second;
+    }
+    return {min, max};
+
+} // acmacs::LayoutSoA::area
+
+// ----------------------------------------------------------------------
+
+acmacs::Area acmacs::LayoutSoA::area(const std::vector<size_t>& points) const // just for the specified point indexes
+{
+    PointCoordinates min(number_of_dimensions()), max(number_of_dimensions());
+    for (number_of_dimensions_t dim{0}; dim < number_of_dimensions(); ++dim) {
+        const auto& coord = dimensions_[*dim];
+        double dim_min = std::numeric_limits<double>::infinity(), dim_max = -std::numeric_limits<double>::infinity();
+        for (const auto point_no : points) {
+            dim_min = coord[point_no] < dim_min ? coord[point_no] : dim_min;
+            dim_max = coord[point_no] > dim_max ? coord[point_no] : dim_max;
+        }
+        min[dim] = dim_min;
+        max[dim] = dim_max;
+    }
+    return {min, max};
+
+} // acmacs::LayoutSoA::area
+
+// ----------------------------------------------------------------------
+
+std::shared_ptr<acmacs::LayoutSoA> acmacs::LayoutSoA::transform(const acmacs::Transformation& aTransformation) const
+{
+    auto result = std::make_shared<acmacs::LayoutSoA>(number_of_points(), number_of_dimensions());
+    const size_t num_dim = dimensions_.size();
+    if (num_dim != 2 && num_dim != 3)
+        throw std::runtime_error("invalid number_of_dimensions in LayoutSoA");
+    // target[dim] = sum(source[row] * transformation(row, dim))
+    for (size_t target_dim = 0; target_dim < num_dim; ++target_dim) {
+        auto& target = result->dimensions_[target_dim];
+        const double factor0 = aTransformation(size_t{0}, target_dim), factor1 = aTransformation(size_t{1}, target_dim);
+        const double* source0 = dimensions_[0].data();
+        const double* source1 = dimensions_[1].data();
+        for (size_t point_no = 0; point_no < target.size(); ++point_no)
+            target[point_no] = source0[point_no] * factor0 + source1[point_no] * factor1;
+        if (num_dim == 3) {
+            const double factor2 = aTransformation(size_t{2}, target_dim);
+            const double* source2 = dimensions_[2].data();
+            for (size_t point_no = 0; point_no < target.size(); ++point_no)
+                target[point_no] += source2[point_no] * factor2;
+        }
+    }
+    return result;
+
+} // acmacs::LayoutSoA::transform
+
+// ----------------------------------------------------------------------
+
+acmacs::PointCoordinates acmacs::LayoutSoA::centroid() const
+{
+    PointCoordinates result(number_of_dimensions(), 0.0);
+    for (number_of_dimensions_t dim{0}; dim < number_of_dimensions(); ++dim) {
+        double sum{0.0}, num_non_nan{0.0};
+        for (const double val : dimensions_[*dim]) {
+            const bool not_nan = !std::isnan(val);
+            sum += not_nan ? val : 0.0;
+            num_non_nan += not_nan ? 1.0 : 0.0;
+        }
+        result[dim] = sum / num_non_nan;
+    }
+    return result;
+
+} // acmacs::LayoutSoA::centroid
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
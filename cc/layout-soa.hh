@@ -0,0 +1,240 @@
+#pragma once
+
+#include "acmacs-base/layout.hh"
+
+// ----------------------------------------------------------------------
+
+namespace acmacs
+{
+    class LayoutSoA;
+
+    // skips disconnected points (with NaN coordinates)!
+    class LayoutSoAConstIterator
+    {
+      public:
+        PointCoordinates operator*() const;
+        LayoutSoAConstIterator& operator++();
+        bool operator==(const LayoutSoAConstIterator& rhs) const
+        {
+            if (&parent_ != &rhs.parent_)
+                throw std::runtime_error("LayoutSoAConstIterator: cannot compare iterators for different layouts");
+            return point_no_ == rhs.point_no_;
+        }
+        bool operator!=(const LayoutSoAConstIterator& rhs) const { return !operator==(rhs); }
+
+      private:
+        const LayoutSoA& parent_;
+        mutable size_t point_no_;
+
+        LayoutSoAConstIterator(const LayoutSoA& parent, size_t point_no) : parent_{parent}, point_no_{point_no} {}
+
+        friend class LayoutSoA;
+
+    }; // class LayoutSoAConstIterator
+
+    // skips disconnected points (with NaN coordinates)!
+    class LayoutSoADimensionConstIterator
+    {
+      public:
+        using difference_type = ssize_t;
+
+        double operator*() const;
+        LayoutSoADimensionConstIterator& operator++();
+
+        LayoutSoADimensionConstIterator operator+(difference_type offset) const { return {parent_, point_no_ + static_cast<size_t>(offset), dimension_no_}; }
+
+        bool operator==(const LayoutSoADimensionConstIterator& rhs) const
+        {
+            if (&parent_ != &rhs.parent_)
+                throw std::runtime_error("LayoutSoADimensionConstIterator: cannot compare iterators for different layouts");
+            if (dimension_no_ != rhs.dimension_no_)
+                throw std::runtime_error("LayoutSoADimensionConstIterator: cannot compare iterators for dimensions");
+            return point_no_ == rhs.point_no_;
+        }
+        bool operator!=(const LayoutSoADimensionConstIterator& rhs) const { return !operator==(rhs); }
+
+      private:
+        const LayoutSoA& parent_;
+        mutable size_t point_no_;
+        const number_of_dimensions_t dimension_no_;
+
+        LayoutSoADimensionConstIterator(const LayoutSoA& parent, size_t point_no, number_of_dimensions_t dimension_no) : parent_{parent}, point_no_{point_no}, dimension_no_{dimension_no} {}
+
+        friend class LayoutSoA;
+
+    }; // class LayoutSoADimensionConstIterator
+
+    // ----------------------------------------------------------------------
+
+    // Dimension-major (structure of arrays) variant of Layout with the same interface: coordinates of each dimension are
+    // stored contiguously, per-dimension reductions (minmax, area, centroid) read memory sequentially and are vectorized.
+    // Inserting and removing points is more expensive than in Layout.
+    // NaN is skipped per coordinate in reductions, i.e. results differ from Layout only for points having some but not all coordinates NaN.
+    class LayoutSoA
+    {
+      public:
+        LayoutSoA() : dimensions_(2) {}
+        LayoutSoA(size_t number_of_points, number_of_dimensions_t number_of_dimensions)
+            : dimensions_(*number_of_dimensions, std::vector<double>(number_of_points, std::numeric_limits<double>::quiet_NaN()))
+        {
+        }
+        explicit LayoutSoA(const Layout& source);
+        LayoutSoA(const LayoutSoA& source, const std::vector<size_t>& indexes);
+
+        Layout to_layout() const;
+
+        size_t number_of_points() const noexcept { return dimensions_.empty() ? 0 : dimensions_.front().size(); }
+        number_of_dimensions_t number_of_dimensions() const noexcept { return number_of_dimensions_t{dimensions_.size()}; }
+
+        void change_number_of_dimensions(number_of_dimensions_t num_dim, bool allow_dimensions_increase = false)
+        {
+            if (!allow_dimensions_increase && num_dim >= number_of_dimensions())
+                throw std::runtime_error(fmt::format("LayoutSoA::change_number_of_dimensions: dimensions increase: {} --> {}", number_of_dimensions(), num_dim));
+            dimensions_.resize(*num_dim, std::vector<double>(number_of_points(), std::numeric_limits<double>::quiet_NaN()));
+        }
+
+        // coordinates of all points in the dimension
+        const std::vector<double>& dimension(number_of_dimensions_t dimension_no) const { return dimensions_[*dimension_no]; }
+        std::vector<double>& dimension(number_of_dimensions_t dimension_no) { return dimensions_[*dimension_no]; }
+
+        const PointCoordinates operator[](size_t point_no) const
+        {
+            PointCoordinates result(number_of_dimensions());
+            for (number_of_dimensions_t dim{0}; dim < number_of_dimensions(); ++dim)
+                result[dim] = dimensions_[*dim][point_no];
+            return result;
+        }
+
+        // use update(index, point) instead of layout[index] = point
+
+        const PointCoordinates at(size_t point_no) const { return operator[](point_no); }
+
+        double operator()(size_t point_no, number_of_dimensions_t aDimensionNo) const { return dimensions_[*aDimensionNo][point_no]; }
+        double& operator()(size_t point_no, number_of_dimensions_t aDimensionNo) { return dimensions_[*aDimensionNo][point_no]; }
+        double coordinate(size_t point_no, number_of_dimensions_t aDimensionNo) const { return operator()(point_no, aDimensionNo); }
+        double& coordinate(size_t point_no, number_of_dimensions_t aDimensionNo) { return operator()(point_no, aDimensionNo); }
+        bool point_has_coordinates(size_t point_no) const
+        {
+            return std::none_of(std::begin(dimensions_), std::end(dimensions_), [point_no](const auto& dim) { return std::isnan(dim[point_no]); });
+        }
+        std::vector<double> as_flat_vector_double() const { return to_layout(); } // point-major
+        std::vector<std::vector<double>> as_vector_of_vectors_double() const;
+
+        void update(size_t point_no, const PointCoordinates& point)
+        {
+            assert(point_no < number_of_points());
+            assert(point.number_of_dimensions() == number_of_dimensions());
+            for (number_of_dimensions_t dim{0}; dim < number_of_dimensions(); ++dim)
+                coordinate(point_no, dim) = point[dim];
+        }
+
+        void set_nan(size_t point_no)
+        {
+            for (auto& dim : dimensions_)
+                dim[point_no] = std::numeric_limits<double>::quiet_NaN();
+        }
+
+        void remove_points(const ReverseSortedIndexes& indexes, size_t base);
+
+        void insert_point(size_t before, size_t base)
+        {
+            for (auto& dim : dimensions_)
+                dim.insert(std::next(std::begin(dim), static_cast<ssize_t>(before + base)), std::numeric_limits<double>::quiet_NaN());
+        }
+
+        size_t append_point()
+        {
+            for (auto& dim : dimensions_)
+                dim.push_back(std::numeric_limits<double>::quiet_NaN());
+            return number_of_points() - 1;
+        }
+
+        std::vector<std::pair<double, double>> minmax() const;
+
+        double distance(size_t p1, size_t p2, double no_distance = std::numeric_limits<double>::quiet_NaN()) const
+        {
+            double sum{0.0};
+            for (const auto& dim : dimensions_)
+                sum += (dim[p1] - dim[p2]) * (dim[p1] - dim[p2]);
+            return std::isnan(sum) ? no_distance : std::sqrt(sum);
+        }
+
+        // returns indexes for min points for each dimension and max points for each dimension
+        std::pair<std::vector<size_t>, std::vector<size_t>> min_max_point_indexes() const;
+        // returns boundary coordinates (min and max)
+        Area area() const;                                  // for all points
+        Area area(const std::vector<size_t>& points) const; // just for the specified point indexes
+        std::shared_ptr<LayoutSoA> transform(const Transformation& aTransformation) const;
+        PointCoordinates centroid() const;
+
+        LayoutSoAConstIterator begin() const { return {*this, 0}; }
+        LayoutSoAConstIterator end() const { return {*this, number_of_points()}; }
+        LayoutSoAConstIterator begin_antigens(size_t /*number_of_antigens*/) const { return {*this, 0}; }
+        LayoutSoAConstIterator end_antigens(size_t number_of_antigens) const { return {*this, number_of_antigens}; }
+        LayoutSoAConstIterator begin_sera(size_t number_of_antigens) const { return {*this, number_of_antigens}; }
+        LayoutSoAConstIterator end_sera(size_t /*number_of_antigens*/) const { return {*this, number_of_points()}; }
+
+        LayoutSoADimensionConstIterator begin_dimension(number_of_dimensions_t dimension_no) const { return {*this, 0, dimension_no}; }
+        LayoutSoADimensionConstIterator end_dimension(number_of_dimensions_t dimension_no) const { return {*this, number_of_points(), dimension_no}; }
+        LayoutSoADimensionConstIterator begin_antigens_dimension(size_t /*number_of_antigens*/, number_of_dimensions_t dimension_no) const { return {*this, 0, dimension_no}; }
+        LayoutSoADimensionConstIterator end_antigens_dimension(size_t number_of_antigens, number_of_dimensions_t dimension_no) const { return {*this, number_of_antigens, dimension_no}; }
+        LayoutSoADimensionConstIterator begin_sera_dimension(size_t number_of_antigens, number_of_dimensions_t dimension_no) const { return {*this, number_of_antigens, dimension_no}; }
+        LayoutSoADimensionConstIterator end_sera_dimension(size_t /*number_of_antigens*/, number_of_dimensions_t dimension_no) const { return {*this, number_of_points(), dimension_no}; }
+
+      private:
+        std::vector<std::vector<double>> dimensions_;
+
+    }; // class LayoutSoA
+
+    inline PointCoordinates LayoutSoAConstIterator::operator*() const
+    {
+        while (point_no_ < parent_.number_of_points() && !parent_.point_has_coordinates(point_no_))
+            ++point_no_; // skip disconnected points
+        return parent_.at(point_no_);
+    }
+
+    inline LayoutSoAConstIterator& LayoutSoAConstIterator::operator++()
+    {
+        if (point_no_ < parent_.number_of_points()) // point_no_ is incremented by operator*!
+            ++point_no_;
+        // do not skip disconnected points to avoid jumping over end iterator
+        return *this;
+    }
+
+    inline double LayoutSoADimensionConstIterator::operator*() const
+    {
+        while (point_no_ < parent_.number_of_points() && !parent_.point_has_coordinates(point_no_))
+            ++point_no_; // skip disconnected points
+        return parent_.coordinate(point_no_, dimension_no_);
+    }
+
+    inline LayoutSoADimensionConstIterator& LayoutSoADimensionConstIterator::operator++()
+    {
+        if (point_no_ < parent_.number_of_points()) // point_no_ is incremented by operator*!
+            ++point_no_;
+        // do not skip disconnected points to avoid jumping over end iterator
+        return *this;
+    }
+
+} // namespace acmacs
+
+// ----------------------------------------------------------------------
+
+// format for LayoutSoA is format for double of each coordinate, e.g. :.8f
+
+template <> struct fmt::formatter<acmacs::LayoutSoA> : public fmt::formatter<acmacs::fmt_helper::float_formatter>
+{
+    template <typename FormatContext> auto format(const acmacs::LayoutSoA& layout, FormatContext& ctx)
+    {
+        fmt::format_to(ctx.out(), "Layout {}d ({})\n", layout.number_of_dimensions(), layout.number_of_points());
+        const auto num_digits_in_point_no = static_cast<int>(std::log10(layout.number_of_points())) + 1;
+        for (size_t no = 0; no < layout.number_of_points(); ++no)
+            fmt::format_to(ctx.out(), "  {:{}d} {}\n", no, num_digits_in_point_no, format_val(layout[no]));
+        return ctx.out();
+    }
+};
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
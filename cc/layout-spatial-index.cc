@@ -0,0 +1,355 @@
+#include <queue>
+#include <thread>
+#include <atomic>
+#include <exception>
+
+#include "acmacs-base/layout-spatial-index.hh"
+
+// ----------------------------------------------------------------------
+
+namespace
+{
+    constexpr double points_per_cell = 2.0;
+    constexpr size_t min_moved_points_before_rebuild = 16;
+    constexpr size_t nearest_for_all_chunk = 256;
+
+    inline std::vector<double> to_vector(const acmacs::PointCoordinates& point)
+    {
+        std::vector<double> result(*point.number_of_dimensions());
+        for (acmacs::number_of_dimensions_t dim{0}; dim < point.number_of_dimensions(); ++dim)
+            result[*dim] = point[dim];
+        return result;
+    }
+
+    inline double point_distance2(const acmacs::Layout& layout, size_t point_no, const std::vector<double>& point)
+    {
+        const double* coord = layout.data() + point_no * point.size();
+        double sum{0.0};
+        for (size_t dim = 0; dim < point.size(); ++dim)
+            sum += (coord[dim] - point[dim]) * (coord[dim] - point[dim]);
+        return sum;
+    }
+
+} // namespace
+
+// ----------------------------------------------------------------------
+
+void acmacs::LayoutSpatialIndex::rebuild()
+{
+    const size_t num_dim = *layout_.number_of_dimensions();
+    const size_t num_points = layout_.number_of_points();
+    moved_.assign(num_points, 0);
+    moved_points_.clear();
+
+    origin_.assign(num_dim, std::numeric_limits<double>::infinity());
+    std::vector<double> max(num_dim, -std::numeric_limits<double>::infinity());
+    size_t connected{0};
+    for (size_t point_no = 0; point_no < num_points; ++point_no) {
+        if (layout_.point_has_coordinates(point_no)) {
+            ++connected;
+            for (size_t dim = 0; dim < num_dim; ++dim) {
+                origin_[dim] = std::min(origin_[dim], layout_(point_no, number_of_dimensions_t{dim}));
+                max[dim] = std::max(max[dim], layout_(point_no, number_of_dimensions_t{dim}));
+            }
+        }
+    }
+    if (connected == 0) {
+        origin_.assign(num_dim, 0.0);
+        max.assign(num_dim, 0.0);
+    }
+
+    // cubic cells, about points_per_cell points per cell for uniformly distributed points,
+    // flat dimensions (all points have the same coordinate) are not allowed to make the volume zero
+    std::vector<double> extent(num_dim);
+    std::transform(std::begin(max), std::end(max), std::begin(origin_), std::begin(extent), [](double mx, double mn) { return mx - mn; });
+    const auto largest_extent = num_dim > 0 ? *std::max_element(std::begin(extent), std::end(extent)) : 0.0;
+    const auto min_extent = largest_extent > 0.0 ? largest_extent * 1e-6 : 1.0;
+    const auto volume = std::accumulate(std::begin(extent), std::end(extent), 1.0, [min_extent](double vol, double ext) { return vol * std::max(ext, min_extent); });
+    const auto target_cells = std::max(1.0, static_cast<double>(connected) / points_per_cell);
+    cell_size_ = std::pow(volume / target_cells, 1.0 / static_cast<double>(num_dim));
+    cells_per_dim_.resize(num_dim);
+    for (;;) {
+        double total_cells{1.0};
+        for (size_t dim = 0; dim < num_dim; ++dim) {
+            cells_per_dim_[dim] = static_cast<size_t>(std::floor(extent[dim] / cell_size_)) + 1;
+            total_cells *= static_cast<double>(cells_per_dim_[dim]);
+        }
+        if (total_cells <= target_cells * 4.0 + 1.0) // too many cells when some dimensions are flat
+            break;
+        cell_size_ *= 1.25;
+    }
+
+    cell_stride_.resize(num_dim);
+    size_t number_of_cells{1};
+    for (size_t dim = 0; dim < num_dim; ++dim) {
+        cell_stride_[dim] = number_of_cells;
+        number_of_cells *= cells_per_dim_[dim];
+    }
+
+    // counting sort of points by cell
+    std::vector<size_t> point_cell(num_points, number_of_cells);
+    cell_start_.assign(number_of_cells + 1, 0);
+    for (size_t point_no = 0; point_no < num_points; ++point_no) {
+        if (layout_.point_has_coordinates(point_no)) {
+            size_t cell_no{0};
+            for (size_t dim = 0; dim < num_dim; ++dim)
+                cell_no += cell_coordinate(layout_(point_no, number_of_dimensions_t{dim}), dim) * cell_stride_[dim];
+            point_cell[point_no] = cell_no;
+            ++cell_start_[cell_no + 1];
+        }
+    }
+    std::partial_sum(std::begin(cell_start_), std::end(cell_start_), std::begin(cell_start_));
+    cell_points_.resize(connected);
+    auto cell_fill = cell_start_;
+    for (size_t point_no = 0; point_no < num_points; ++point_no) {
+        if (point_cell[point_no] < number_of_cells)
+            cell_points_[cell_fill[point_cell[point_no]]++] = point_no;
+    }
+
+} // acmacs::LayoutSpatialIndex::rebuild
+
+// ----------------------------------------------------------------------
+
+void acmacs::LayoutSpatialIndex::update(size_t point_no)
+{
+    if (point_no >= moved_.size()) // point appended to the layout
+        moved_.resize(point_no + 1, 0);
+    if (!moved_[point_no]) {
+        moved_[point_no] = 1;
+        moved_points_.push_back(point_no);
+        if (moved_points_.size() > std::max(min_moved_points_before_rebuild, layout_.number_of_points() / 32))
+            rebuild();
+    }
+
+} // acmacs::LayoutSpatialIndex::update
+
+// ----------------------------------------------------------------------
+
+// calls func(cell_no, cell) for every cell in the box of cells [first, last] (inclusive)
+template <typename F> void acmacs::LayoutSpatialIndex::for_each_cell(const std::vector<size_t>& first, const std::vector<size_t>& last, F&& func) const
+{
+    if (first.empty()) {
+        func(size_t{0}, first);
+        return;
+    }
+    auto cell = first;
+    for (;;) {
+        size_t cell_no{0};
+        for (size_t dim = 0; dim < cell.size(); ++dim)
+            cell_no += cell[dim] * cell_stride_[dim];
+        func(cell_no, cell);
+        size_t dim{0};
+        for (; dim < cell.size() && cell[dim] == last[dim]; ++dim)
+            cell[dim] = first[dim];
+        if (dim == cell.size())
+            break;
+        ++cell[dim];
+    }
+
+} // acmacs::LayoutSpatialIndex::for_each_cell
+
+// ----------------------------------------------------------------------
+
+// calls func(point_no) for connected points in the cells covering box [min, max] and for moved points, func checks exact condition
+template <typename F> void acmacs::LayoutSpatialIndex::for_each_point_in_box(const std::vector<double>& min, const std::vector<double>& max, F&& func) const
+{
+    std::vector<size_t> first(min.size()), last(max.size());
+    for (size_t dim = 0; dim < min.size(); ++dim) {
+        first[dim] = cell_coordinate(min[dim], dim);
+        last[dim] = cell_coordinate(max[dim], dim);
+    }
+    for_each_cell(first, last, [this, &func](size_t cell_no, const std::vector<size_t>& /*cell*/) {
+        for (size_t index = cell_start_[cell_no]; index < cell_start_[cell_no + 1]; ++index) {
+            if (!moved_[cell_points_[index]])
+                func(cell_points_[index]);
+        }
+    });
+    for (const auto point_no : moved_points_) {
+        if (point_no < layout_.number_of_points() && layout_.point_has_coordinates(point_no))
+            func(point_no);
+    }
+
+} // acmacs::LayoutSpatialIndex::for_each_point_in_box
+
+// ----------------------------------------------------------------------
+
+std::vector<size_t> acmacs::LayoutSpatialIndex::within(const PointCoordinates& center, double radius) const
+{
+    std::vector<size_t> result;
+    if (!center.exists() || !(radius >= 0.0))
+        return result;
+    const auto point = to_vector(center);
+    std::vector<double> min(point), max(point);
+    for (size_t dim = 0; dim < point.size(); ++dim) {
+        min[dim] -= radius;
+        max[dim] += radius;
+    }
+    for_each_point_in_box(min, max, [this, &result, &point, radius2 = radius * radius](size_t point_no) {
+        if (point_distance2(layout_, point_no, point) <= radius2)
+            result.push_back(point_no);
+    });
+    std::sort(std::begin(result), std::end(result));
+    return result;
+
+} // acmacs::LayoutSpatialIndex::within
+
+// ----------------------------------------------------------------------
+
+std::vector<size_t> acmacs::LayoutSpatialIndex::within(const Area& area) const
+{
+    std::vector<size_t> result;
+    if (!area.min.exists() || !area.max.exists())
+        return result;
+    const auto min = to_vector(area.min), max = to_vector(area.max);
+    for_each_point_in_box(min, max, [this, &result, &min, &max](size_t point_no) {
+        const double* coord = layout_.data() + point_no * min.size();
+        for (size_t dim = 0; dim < min.size(); ++dim) {
+            if (coord[dim] < min[dim] || coord[dim] > max[dim])
+                return;
+        }
+        result.push_back(point_no);
+    });
+    std::sort(std::begin(result), std::end(result));
+    return result;
+
+} // acmacs::LayoutSpatialIndex::within
+
+// ----------------------------------------------------------------------
+
+std::vector<acmacs::LayoutSpatialIndex::neighbour_t> acmacs::LayoutSpatialIndex::nearest(const PointCoordinates& point, size_t k) const
+{
+    return nearest(point, k, std::numeric_limits<size_t>::max());
+
+} // acmacs::LayoutSpatialIndex::nearest
+
+// ----------------------------------------------------------------------
+
+std::vector<acmacs::LayoutSpatialIndex::neighbour_t> acmacs::LayoutSpatialIndex::nearest(size_t point_no, size_t k) const
+{
+    if (!layout_.point_has_coordinates(point_no))
+        return {};
+    return nearest(layout_[point_no], k, point_no);
+
+} // acmacs::LayoutSpatialIndex::nearest
+
+// ----------------------------------------------------------------------
+
+// Cells are visited in rings (shells of the box of cells) around the cell of the point. Search stops when k points
+// are found and the farthest of them is closer than any cell outside of the visited box.
+
+std::vector<acmacs::LayoutSpatialIndex::neighbour_t> acmacs::LayoutSpatialIndex::nearest(const PointCoordinates& point, size_t k, size_t exclude) const
+{
+    if (k == 0 || !point.exists() || cell_points_.size() + moved_points_.size() == 0)
+        return {};
+    const auto query = to_vector(point);
+    const size_t num_dim = query.size();
+
+    std::priority_queue<std::pair<double, size_t>> heap; // k nearest found so far, max-heap by (distance2, point_no)
+    const auto add = [&](size_t point_no) {
+        if (point_no == exclude)
+            return;
+        const std::pair<double, size_t> candidate{point_distance2(layout_, point_no, query), point_no};
+        if (heap.size() < k)
+            heap.push(candidate);
+        else if (candidate < heap.top()) {
+            heap.pop();
+            heap.push(candidate);
+        }
+    };
+
+    for (const auto point_no : moved_points_) {
+        if (point_no < layout_.number_of_points() && layout_.point_has_coordinates(point_no))
+            add(point_no);
+    }
+
+    std::vector<size_t> center(num_dim), first(num_dim), last(num_dim);
+    for (size_t dim = 0; dim < num_dim; ++dim)
+        center[dim] = cell_coordinate(query[dim], dim);
+    for (size_t ring = 0;; ++ring) {
+        bool whole_grid{true};
+        double bound = std::numeric_limits<double>::infinity(); // distance from query to the nearest cell outside of the box
+        for (size_t dim = 0; dim < num_dim; ++dim) {
+            first[dim] = center[dim] > ring ? center[dim] - ring : 0;
+            last[dim] = std::min(center[dim] + ring, cells_per_dim_[dim] - 1);
+            if (first[dim] > 0) {
+                whole_grid = false;
+                bound = std::min(bound, query[dim] - (origin_[dim] + static_cast<double>(first[dim]) * cell_size_));
+            }
+            if (last[dim] < (cells_per_dim_[dim] - 1)) {
+                whole_grid = false;
+                bound = std::min(bound, origin_[dim] + static_cast<double>(last[dim] + 1) * cell_size_ - query[dim]);
+            }
+        }
+        for_each_cell(first, last, [&](size_t cell_no, const std::vector<size_t>& cell) {
+            if (ring > 0) { // inner cells were visited in the previous rings
+                bool on_ring{false};
+                for (size_t dim = 0; !on_ring && dim < num_dim; ++dim)
+                    on_ring = cell[dim] == center[dim] + ring || (center[dim] >= ring && cell[dim] == center[dim] - ring);
+                if (!on_ring)
+                    return;
+            }
+            for (size_t index = cell_start_[cell_no]; index < cell_start_[cell_no + 1]; ++index) {
+                if (!moved_[cell_points_[index]])
+                    add(cell_points_[index]);
+            }
+        });
+        if (whole_grid)
+            break;
+        bound = std::max(bound, 0.0);
+        if (heap.size() == k && heap.top().first <= bound * bound)
+            break;
+    }
+
+    std::vector<neighbour_t> result(heap.size());
+    for (auto target = result.rbegin(); target != result.rend(); ++target, heap.pop())
+        *target = neighbour_t{heap.top().second, std::sqrt(heap.top().first)};
+    return result;
+
+} // acmacs::LayoutSpatialIndex::nearest
+
+// ----------------------------------------------------------------------
+
+std::vector<std::vector<acmacs::LayoutSpatialIndex::neighbour_t>> acmacs::LayoutSpatialIndex::nearest_for_all(size_t k, size_t threads) const
+{
+    std::vector<std::vector<neighbour_t>> result(layout_.number_of_points());
+    const auto compute = [this, k, &result](size_t first, size_t last) {
+        for (size_t point_no = first; point_no < last; ++point_no)
+            result[point_no] = nearest(point_no, k);
+    };
+
+    if (threads == 0)
+        threads = std::thread::hardware_concurrency();
+    threads = std::min(threads, result.size() / nearest_for_all_chunk + 1);
+    if (threads < 2) {
+        compute(0, result.size());
+        return result;
+    }
+
+    std::atomic<size_t> next_chunk{0};
+    std::vector<std::exception_ptr> errors(threads);
+    std::vector<std::thread> workers;
+    for (size_t thread_no = 0; thread_no < threads; ++thread_no) {
+        workers.emplace_back([&, thread_no]() {
+            try {
+                for (size_t first = (next_chunk++) * nearest_for_all_chunk; first < result.size(); first = (next_chunk++) * nearest_for_all_chunk)
+                    compute(first, std::min(first + nearest_for_all_chunk, result.size()));
+            }
+            catch (...) {
+                errors[thread_no] = std::current_exception();
+            }
+        });
+    }
+    for (auto& worker : workers)
+        worker.join();
+    for (const auto& err : errors) {
+        if (err)
+            std::rethrow_exception(err);
+    }
+    return result;
+
+} // acmacs::LayoutSpatialIndex::nearest_for_all
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
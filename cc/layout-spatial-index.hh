@@ -0,0 +1,71 @@
+#pragma once
+
+#include "acmacs-base/layout.hh"
+
+// ----------------------------------------------------------------------
+
+namespace acmacs
+{
+    // Uniform grid over points of a layout for radius, Area and k nearest neighbours queries. Cells are cubes, their
+    // size is chosen to have about two points per cell, points of each cell are stored contiguously. Disconnected
+    // points (NaN coordinates) are not indexed and never reported.
+    //
+    // Index refers to the layout, it must outlive the index. After moving a point with Layout::update() or
+    // Layout::set_nan(), call update(point_no): the point is taken out of its cell and scanned linearly by queries
+    // until the number of such points exceeds 1/32 of the layout and the grid is rebuilt. Call rebuild() after
+    // removing or inserting points or changing the number of dimensions.
+    class LayoutSpatialIndex
+    {
+      public:
+        using neighbour_t = std::pair<size_t, double>; // point_no, distance
+
+        explicit LayoutSpatialIndex(const Layout& layout) : layout_{layout} { rebuild(); }
+
+        void rebuild();
+        void update(size_t point_no);
+
+        // point indexes in ascending order
+        std::vector<size_t> within(const PointCoordinates& center, double radius) const; // distance to center <= radius
+        std::vector<size_t> within(const Area& area) const;                              // area.min <= coordinates <= area.max
+
+        // sorted by distance (then by point_no), fewer than k if there are not enough connected points
+        std::vector<neighbour_t> nearest(const PointCoordinates& point, size_t k) const;
+        std::vector<neighbour_t> nearest(size_t point_no, size_t k) const; // point_no itself is excluded, empty if point_no is disconnected
+        // k nearest neighbours of every point, threads: 0 - use all cpus
+        std::vector<std::vector<neighbour_t>> nearest_for_all(size_t k, size_t threads = 0) const;
+
+        size_t number_of_cells() const noexcept { return cell_start_.size() - 1; }
+
+      private:
+        const Layout& layout_;
+        std::vector<double> origin_;         // min coordinates of the indexed points
+        double cell_size_{1.0};
+        std::vector<size_t> cells_per_dim_;
+        std::vector<size_t> cell_stride_;   // cell_no = sum(cell coordinate * stride)
+        std::vector<size_t> cell_start_;    // points of the cell_no are cell_points_[cell_start_[cell_no] .. cell_start_[cell_no + 1])
+        std::vector<size_t> cell_points_;
+        std::vector<char> moved_;           // point is not in the grid (moved after rebuild) and is in moved_points_
+        std::vector<size_t> moved_points_;
+
+        // clamped before conversion: coordinates of a query box may be far outside of the grid or infinite
+        size_t cell_coordinate(double coordinate, size_t dim) const
+        {
+            const auto cell = std::floor((coordinate - origin_[dim]) / cell_size_);
+            if (!(cell > 0.0))
+                return 0;
+            if (const auto last = cells_per_dim_[dim] - 1; cell >= static_cast<double>(last))
+                return last;
+            return static_cast<size_t>(cell);
+        }
+
+        std::vector<neighbour_t> nearest(const PointCoordinates& point, size_t k, size_t exclude) const;
+        template <typename F> void for_each_cell(const std::vector<size_t>& first, const std::vector<size_t>& last, F&& func) const;
+        template <typename F> void for_each_point_in_box(const std::vector<double>& min, const std::vector<double>& max, F&& func) const;
+    };
+
+} // namespace acmacs
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
@@ -1,3 +1,8 @@
+#include <array>
+#include <thread>
+#include <atomic>
+#include <exception>
+
 #include "acmacs-base/layout.hh"
 
 // ----------------------------------------------------------------------
@@ -18,11 +23,11 @@ acmacs::Area acmacs::intersection(const Area& a1, const Area& a2)
 std::pair<std::vector<size_t>, std::vector<size_t>> acmacs::Layout::min_max_point_indexes() const
 {
     const auto num_dim = number_of_dimensions();
-    std::vector<size_t> min_points(*num_dim, 0), max_points(*num_dim, 0);
     size_t point_no = 0;
     for (; !operator[](point_no).exists(); ++point_no); // skip NaN points at the beginning
-    PointCoordinates min_coordinates(operator[](point_no));
-    PointCoordinates max_coordinates(min_coordinates);
+    std::vector<size_t> min_points(*num_dim, point_no), max_points(*num_dim, point_no);
+    PointCoordinates min_coordinates(operator[](point_no).copy()); // operator[] returns reference to the layout data
+    PointCoordinates max_coordinates(min_coordinates.copy());
     ++point_no;
     for (; point_no < number_of_points(); ++point_no) {
         const auto point = operator[](point_no);
@@ -89,20 +94,137 @@ acmacs::Area acmacs::Layout::area(const std::vector<size_t>& points) const // ju
 
 // ----------------------------------------------------------------------
 
+// matrix times point for every point, num_dim is known at compile time, loops are unrolled and vectorized,
+// NaN coordinates of disconnected points propagate to the result without branching,
+// source and target may be the same (in-place transformation)
+template <size_t num_dim> static void transform_points(const acmacs::Transformation& aTransformation, const double* source, double* target, size_t number_of_points)
+{
+    std::array<std::array<double, num_dim>, num_dim> matrix;
+    for (size_t row = 0; row < num_dim; ++row) {
+        for (size_t column = 0; column < num_dim; ++column)
+            matrix[row][column] = aTransformation(row, column);
+    }
+    for (size_t point_no = 0; point_no < number_of_points; ++point_no, source += num_dim, target += num_dim) {
+        std::array<double, num_dim> point;
+        std::copy(source, source + num_dim, point.begin());
+        for (size_t column = 0; column < num_dim; ++column) {
+            double sum = point[0] * matrix[0][column];
+            for (size_t row = 1; row < num_dim; ++row)
+                sum += point[row] * matrix[row][column];
+            target[column] = sum;
+        }
+    }
+}
+
+using transform_points_t = void (*)(const acmacs::Transformation&, const double*, double*, size_t);
+
+// throws for unsupported number of dimensions before any thread is started, kernels do not throw
+static transform_points_t transform_points_for(acmacs::number_of_dimensions_t num_dim)
+{
+    switch (*num_dim) {
+        case 2:
+            return &transform_points<2>;
+        case 3:
+            return &transform_points<3>;
+        default:
+            throw std::runtime_error{fmt::format("Layout::transform: unsupported number of dimensions: {}", num_dim)};
+    }
+}
+
+static constexpr size_t transform_points_per_thread = 1 << 16;
+
+static void transform_points(const acmacs::Transformation& aTransformation, acmacs::number_of_dimensions_t num_dim, const double* source, double* target, size_t number_of_points, size_t threads)
+{
+    const auto transform = transform_points_for(num_dim);
+    if (threads == 0)
+        threads = std::thread::hardware_concurrency();
+    threads = std::min(threads, number_of_points / transform_points_per_thread + 1);
+    if (threads < 2) {
+        transform(aTransformation, source, target, number_of_points);
+        return;
+    }
+
+    std::vector<std::thread> workers;
+    const size_t chunk = (number_of_points + threads - 1) / threads;
+    for (size_t first = 0; first < number_of_points; first += chunk) {
+        const auto offset = first * *num_dim;
+        workers.emplace_back([&aTransformation, transform, source = source + offset, target = target + offset, size = std::min(chunk, number_of_points - first)]() {
+            transform(aTransformation, source, target, size);
+        });
+    }
+    for (auto& worker : workers)
+        worker.join();
+}
+
+// ----------------------------------------------------------------------
+
 std::shared_ptr<acmacs::Layout> acmacs::Layout::transform(const acmacs::Transformation& aTransformation) const
 {
     auto result = std::make_shared<acmacs::Layout>(number_of_points(), number_of_dimensions());
-    for (size_t p_no = 0; p_no < number_of_points(); ++p_no)
-        result->update(p_no, aTransformation.transform(at(p_no)));
+    transform(aTransformation, *result);
     return result;
 
 } // acmacs::Layout::transform
 
 // ----------------------------------------------------------------------
 
+void acmacs::Layout::transform(const Transformation& aTransformation, Layout& output, size_t threads) const
+{
+    if (output.number_of_dimensions() != number_of_dimensions() || output.number_of_points() != number_of_points())
+        output = Layout(number_of_points(), number_of_dimensions());
+    transform_points(aTransformation, number_of_dimensions(), data(), output.data(), number_of_points(), threads);
+
+} // acmacs::Layout::transform
+
+// ----------------------------------------------------------------------
+
+void acmacs::Layout::transform_in_place(const Transformation& aTransformation, size_t threads)
+{
+    transform_points(aTransformation, number_of_dimensions(), data(), data(), number_of_points(), threads);
+
+} // acmacs::Layout::transform_in_place
+
+// ----------------------------------------------------------------------
+
+void acmacs::transform_in_place(const Transformation& aTransformation, const std::vector<Layout*>& layouts, size_t threads)
+{
+    if (threads == 0)
+        threads = std::thread::hardware_concurrency();
+    threads = std::min(threads, layouts.size());
+    if (threads < 2) {
+        for (auto* layout : layouts)
+            layout->transform_in_place(aTransformation, 1);
+        return;
+    }
+
+    std::atomic<size_t> next_layout{0};
+    std::vector<std::exception_ptr> errors(threads);
+    std::vector<std::thread> workers;
+    for (size_t thread_no = 0; thread_no < threads; ++thread_no) {
+        workers.emplace_back([&, thread_no]() {
+            try {
+                for (size_t layout_no = next_layout++; layout_no < layouts.size(); layout_no = next_layout++)
+                    layouts[layout_no]->transform_in_place(aTransformation, 1);
+            }
+            catch (...) {
+                errors[thread_no] = std::current_exception();
+            }
+        });
+    }
+    for (auto& worker : workers)
+        worker.join();
+    for (const auto& err : errors) {
+        if (err)
+            std::rethrow_exception(err);
+    }
+
+} // acmacs::transform_in_place
+
+// ----------------------------------------------------------------------
+
 acmacs::PointCoordinates acmacs::Layout::centroid() const
 {
-    PointCoordinates result(static_cast<double>(*number_of_dimensions()), 0.0);
+    PointCoordinates result(number_of_dimensions(), 0.0);
     size_t num_non_nan = number_of_points();
     for (size_t p_no = 0; p_no < number_of_points(); ++p_no) {
         if (const auto coord = at(p_no); coord.exists())
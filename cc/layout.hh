@@ -251,7 +251,11 @@ namespace acmacs
         // returns boundary coordinates (min and max)
         Area area() const;                                  // for all points
         Area area(const std::vector<size_t>& points) const; // just for the specified point indexes
+        // translation is not applied, as in Transformation::transform(PointCoordinates), disconnected points remain NaN
+        // threads: 0 - use all cpus, multiple threads are used for large layouts only
         std::shared_ptr<Layout> transform(const Transformation& aTransformation) const;
+        void transform(const Transformation& aTransformation, Layout& output, size_t threads = 0) const; // output is resized if necessary
+        void transform_in_place(const Transformation& aTransformation, size_t threads = 0);
         PointCoordinates centroid() const;
 
         LayoutConstIterator begin() const { return {*this, 0}; }
@@ -273,6 +277,9 @@ namespace acmacs
 
     }; // class Layout
 
+    // applies the same transformation to many layouts (e.g. all projections of a chart), layouts are distributed among threads
+    void transform_in_place(const Transformation& aTransformation, const std::vector<Layout*>& layouts, size_t threads = 0);
+
     inline PointCoordinates LayoutConstIterator::operator*() const
     {
         while (point_no_ < parent_.number_of_points() && !parent_.point_has_coordinates(point_no_))
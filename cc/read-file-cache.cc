@@ -0,0 +1,170 @@
+// in-process cache of decompressed file content
+
+#include <sys/stat.h>
+#include <cstdlib>
+#include <limits>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+#include "acmacs-base/string-from-chars.hh"
+#include "acmacs-base/read-file.hh"
+
+// ----------------------------------------------------------------------
+
+namespace acmacs::file::content_cache
+{
+    struct file_id_t
+    {
+        dev_t device{0};
+        ino_t inode{0};
+        off_t size{0};
+        timespec mtime{0, 0};
+
+        bool operator==(const file_id_t& rhs) const
+        {
+            return device == rhs.device && inode == rhs.inode && size == rhs.size && mtime.tv_sec == rhs.mtime.tv_sec && mtime.tv_nsec == rhs.mtime.tv_nsec;
+        }
+    };
+
+    static inline bool file_id(const std::string& filename, file_id_t& id)
+    {
+        struct stat st;
+        if (::stat(filename.c_str(), &st) != 0 || !S_ISREG(st.st_mode))
+            return false;
+#ifdef __APPLE__
+        id = file_id_t{st.st_dev, st.st_ino, st.st_size, st.st_mtimespec};
+#else
+        id = file_id_t{st.st_dev, st.st_ino, st.st_size, st.st_mtim};
+#endif
+        return true;
+    }
+
+    struct entry_t
+    {
+        std::string filename;
+        file_id_t id;
+        shared_content content;
+    };
+
+    struct state_t
+    {
+        state_t()
+        {
+            if (const char* size = std::getenv("ACMACS_CONTENT_CACHE_SIZE"); size && *size) {
+                if (const auto mib = acmacs::string::from_chars<size_t>(std::string_view{size}); mib != std::numeric_limits<size_t>::max())
+                    budget = mib * 1024 * 1024;
+            }
+        }
+
+        std::mutex access;
+        std::list<entry_t> entries; // most recently used first
+        std::unordered_map<std::string, std::list<entry_t>::iterator> by_filename;
+        size_t budget{256ul * 1024 * 1024};
+        size_t memory_used{0};
+        size_t hits{0}, misses{0}, evicted{0};
+
+        // access must be locked
+        void remove(std::list<entry_t>::iterator en)
+        {
+            memory_used -= en->content->size();
+            by_filename.erase(en->filename);
+            entries.erase(en);
+        }
+
+        // access must be locked
+        void evict()
+        {
+            while (memory_used > budget && !entries.empty()) {
+                remove(std::prev(entries.end()));
+                ++evicted;
+            }
+        }
+    };
+
+    static state_t& state()
+    {
+        static state_t state_;
+        return state_;
+    }
+
+} // namespace acmacs::file::content_cache
+
+// ----------------------------------------------------------------------
+
+acmacs::file::shared_content acmacs::file::read_cached(std::string_view filename)
+{
+    using namespace content_cache;
+
+    std::string name{filename};
+    file_id_t id;
+    if (!file_id(name, id)) // stdin, pipes, devices, missing files: not cacheable, read() reports errors
+        return std::make_shared<const std::string>(static_cast<std::string>(read(filename)));
+
+    auto& st = state();
+    {
+        std::lock_guard<std::mutex> lock{st.access};
+        if (const auto found = st.by_filename.find(name); found != st.by_filename.end()) {
+            if (found->second->id == id) {
+                ++st.hits;
+                st.entries.splice(st.entries.begin(), st.entries, found->second);
+                return found->second->content;
+            }
+            st.remove(found->second); // file changed
+        }
+        ++st.misses;
+    }
+
+    // read and decompress without holding the lock, concurrent misses for the same file may read it twice, the last one stays in the cache
+    auto content = std::make_shared<const std::string>(static_cast<std::string>(read(filename)));
+
+    std::lock_guard<std::mutex> lock{st.access};
+    if (content->size() <= st.budget) {
+        if (const auto found = st.by_filename.find(name); found != st.by_filename.end())
+            st.remove(found->second);
+        st.entries.push_front(entry_t{name, id, content});
+        st.by_filename.emplace(std::move(name), st.entries.begin());
+        st.memory_used += content->size();
+        st.evict();
+    }
+    return content;
+
+} // acmacs::file::read_cached
+
+// ----------------------------------------------------------------------
+
+void acmacs::file::content_cache::set_memory_budget(size_t bytes)
+{
+    auto& st = state();
+    std::lock_guard<std::mutex> lock{st.access};
+    st.budget = bytes;
+    st.evict();
+
+} // acmacs::file::content_cache::set_memory_budget
+
+// ----------------------------------------------------------------------
+
+void acmacs::file::content_cache::clear()
+{
+    auto& st = state();
+    std::lock_guard<std::mutex> lock{st.access};
+    st.by_filename.clear();
+    st.entries.clear();
+    st.memory_used = 0;
+
+} // acmacs::file::content_cache::clear
+
+// ----------------------------------------------------------------------
+
+acmacs::file::content_cache::statistics_t acmacs::file::content_cache::statistics()
+{
+    auto& st = state();
+    std::lock_guard<std::mutex> lock{st.access};
+    return {st.hits, st.misses, st.evicted, st.entries.size(), st.memory_used};
+
+} // acmacs::file::content_cache::statistics
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
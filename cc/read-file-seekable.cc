@@ -0,0 +1,100 @@
+// random access to the uncompressed content of a (compressed) file
+
+#include <cstring>
+#include <algorithm>
+
+#include "acmacs-base/xz.hh"
+#include "acmacs-base/bzip2.hh"
+#include "acmacs-base/gzip.hh"
+#include "acmacs-base/brotli.hh"
+#include "acmacs-base/zstd.hh"
+#include "acmacs-base/read-file.hh"
+
+// ----------------------------------------------------------------------
+
+acmacs::file::seekable_reader::seekable_reader(std::string_view filename, const read_hints& hints)
+    : file_{filename, hints}
+{
+    const auto raw = file_.raw();
+    if (raw.size() >= sizeof(xz_internal::sXzSig) && xz_compressed(raw.data())) {
+        compressed_ = true;
+        blocks_ = xz_block_index(raw); // empty if index is broken, the file is decompressed completely then
+    }
+    else if (raw.size() >= sizeof(xz_internal::sXzSig))
+        compressed_ = zstd_compressed(raw.data()) || bz2_compressed(raw.data()) || gzip_compressed(raw.data()) || brotli_compressed(raw);
+
+} // acmacs::file::seekable_reader::seekable_reader
+
+// ----------------------------------------------------------------------
+
+size_t acmacs::file::seekable_reader::size() const
+{
+    if (!compressed_)
+        return file_.size();
+    else if (!blocks_.empty())
+        return blocks_.back().uncompressed_offset + blocks_.back().uncompressed_size;
+    else
+        return whole().size();
+
+} // acmacs::file::seekable_reader::size
+
+// ----------------------------------------------------------------------
+
+const std::string& acmacs::file::seekable_reader::whole() const
+{
+    if (!whole_cached_) {
+        cache_ = decompress_if_necessary(file_.raw());
+        whole_cached_ = true;
+    }
+    return cache_;
+
+} // acmacs::file::seekable_reader::whole
+
+// ----------------------------------------------------------------------
+
+void acmacs::file::seekable_reader::read_range(size_t offset, size_t length, std::string& output)
+{
+    const auto total = size();
+    if (offset >= total) {
+        output.clear();
+        return;
+    }
+    length = std::min(length, total - offset);
+
+    if (!compressed_) {
+        output.assign(file_.raw().substr(offset, length));
+        return;
+    }
+    if (blocks_.empty()) {
+        output.assign(std::string_view{whole()}.substr(offset, length));
+        return;
+    }
+
+    output.resize(length);
+    // the last block starting at or before offset
+    auto block = std::prev(std::upper_bound(std::begin(blocks_), std::end(blocks_), offset, [](size_t off, const auto& blk) { return off < blk.uncompressed_offset; }));
+    for (size_t copied = 0; copied < length; ++block) {
+        const auto block_no = static_cast<size_t>(block - std::begin(blocks_));
+        const auto in_block = offset + copied - block->uncompressed_offset;
+        const auto chunk = std::min(block->uncompressed_size - in_block, length - copied);
+        if (chunk == block->uncompressed_size && block_no != cached_block_) { // whole block requested, decompress directly into output
+            xz_decompress_block(file_.raw(), *block, output.data() + copied);
+        }
+        else {
+            if (block_no != cached_block_) {
+                cache_.resize(block->uncompressed_size);
+                cached_block_.reset(); // cache_ is invalid if decompression throws
+                xz_decompress_block(file_.raw(), *block, cache_.data());
+                cached_block_ = block_no;
+            }
+            std::memcpy(output.data() + copied, cache_.data() + in_block, chunk);
+        }
+        copied += chunk;
+    }
+
+} // acmacs::file::seekable_reader::read_range
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
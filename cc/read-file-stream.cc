@@ -0,0 +1,356 @@
+// reading from file descriptor (stdin) with decompression on the fly
+
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <limits>
+#include <algorithm>
+#include <zlib.h>
+#include <bzlib.h>
+#include <zstd.h>
+
+#pragma GCC diagnostic push
+#ifdef __clang__
+#pragma GCC diagnostic ignored "-Wdocumentation"
+#pragma GCC diagnostic ignored "-Wdocumentation-unknown-command"
+#pragma GCC diagnostic ignored "-Wreserved-id-macro"
+#pragma GCC diagnostic ignored "-Wzero-as-null-pointer-constant"
+#endif
+#define lzma_nothrow
+#include <lzma.h>
+#pragma GCC diagnostic pop
+
+#ifdef __clang__
+#pragma GCC diagnostic ignored "-Wzero-as-null-pointer-constant"
+#endif
+
+#include "acmacs-base/fmt.hh"
+#include "acmacs-base/xz.hh"
+#include "acmacs-base/bzip2.hh"
+#include "acmacs-base/gzip.hh"
+#include "acmacs-base/brotli.hh"
+#include "acmacs-base/zstd.hh"
+#include "acmacs-base/read-file.hh"
+
+// ----------------------------------------------------------------------
+
+namespace acmacs::file
+{
+    namespace
+    {
+        constexpr size_t SniffSize = 1024; // brotli_compressed() needs more than just magic
+
+        class fd_input
+        {
+          public:
+            // reads at least SniffSize bytes (or up to eof) to allow format detection
+            fd_input(int fd, size_t chunk_size) : fd_{fd}, buffer_(std::max(chunk_size, SniffSize), ' ')
+            {
+                while (head_size_ < SniffSize) {
+                    if (const auto bytes_read = read_some(buffer_.data() + head_size_, buffer_.size() - head_size_); bytes_read > 0)
+                        head_size_ += bytes_read;
+                    else
+                        break;
+                }
+            }
+
+            std::string_view head() const { return {buffer_.data(), head_size_}; }
+
+            // first call returns head, subsequent calls read next chunk, empty at eof
+            std::string_view next()
+            {
+                if (head_size_) {
+                    const auto size = head_size_;
+                    head_size_ = 0;
+                    return {buffer_.data(), size};
+                }
+                return {buffer_.data(), read_some(buffer_.data(), buffer_.size())};
+            }
+
+            // reads directly into target
+            size_t read_some(char* target, size_t size)
+            {
+                for (;;) {
+                    if (const auto bytes_read = ::read(fd_, target, size); bytes_read >= 0)
+                        return static_cast<size_t>(bytes_read);
+                    else if (errno != EINTR)
+                        throw std::runtime_error(std::string("Cannot read from file descriptor: ") + strerror(errno));
+                }
+            }
+
+            size_t chunk_size() const { return buffer_.size(); }
+
+          private:
+            int fd_;
+            std::string buffer_;
+            size_t head_size_{0};
+        };
+
+        // makes room for more output after used bytes, output grows geometrically
+        inline void make_room(std::string& output, size_t used)
+        {
+            if (used == output.size())
+                output.resize(output.size() * 2);
+        }
+
+        // ----------------------------------------------------------------------
+
+        void read_plain(fd_input& input, std::string& output)
+        {
+            const auto head = input.next(); // output is larger than chunk
+            std::memcpy(output.data(), head.data(), head.size());
+            size_t used = head.size();
+            for (;;) {
+                make_room(output, used);
+                if (const auto bytes_read = input.read_some(output.data() + used, output.size() - used); bytes_read > 0)
+                    used += bytes_read;
+                else
+                    break;
+            }
+            output.resize(used);
+        }
+
+        // ----------------------------------------------------------------------
+
+        void read_gzip(fd_input& input, std::string& output)
+        {
+            constexpr size_t MaxChunk = std::numeric_limits<uInt>::max(); // avail_out is 32 bit
+            z_stream strm;
+            strm.zalloc = Z_NULL;
+            strm.zfree = Z_NULL;
+            strm.opaque = Z_NULL;
+            strm.next_in = Z_NULL;
+            strm.avail_in = 0;
+            if (inflateInit2(&strm, 15 + 32) != Z_OK)
+                throw std::runtime_error("gzip decompression failed during initialization");
+            try {
+                size_t used = 0;
+                for (;;) {
+                    if (strm.avail_in == 0) {
+                        const auto chunk = input.next();
+                        if (chunk.empty())
+                            throw std::runtime_error("gzip decompression failed: unexpected end of input");
+                        strm.next_in = reinterpret_cast<decltype(strm.next_in)>(const_cast<char*>(chunk.data()));
+                        strm.avail_in = static_cast<decltype(strm.avail_in)>(chunk.size());
+                    }
+                    make_room(output, used);
+                    const auto out_chunk = std::min(output.size() - used, MaxChunk);
+                    strm.next_out = reinterpret_cast<decltype(strm.next_out)>(output.data() + used);
+                    strm.avail_out = static_cast<decltype(strm.avail_out)>(out_chunk);
+                    const auto r = inflate(&strm, Z_NO_FLUSH);
+                    used += out_chunk - strm.avail_out;
+                    if (r == Z_STREAM_END)
+                        break;
+                    else if (r != Z_OK && r != Z_BUF_ERROR)
+                        throw std::runtime_error("gzip decompression failed, code: " + std::to_string(r));
+                }
+                output.resize(used);
+                inflateEnd(&strm);
+            }
+            catch (std::exception&) {
+                inflateEnd(&strm);
+                throw;
+            }
+        }
+
+        // ----------------------------------------------------------------------
+
+        // releases decoder memory when reading or decoding throws
+        struct lzma_stream_guard
+        {
+            lzma_stream strm = LZMA_STREAM_INIT;
+            lzma_stream_guard() = default;
+            lzma_stream_guard(const lzma_stream_guard&) = delete;
+            lzma_stream_guard& operator=(const lzma_stream_guard&) = delete;
+            ~lzma_stream_guard() { lzma_end(&strm); }
+        };
+
+        void read_xz(fd_input& input, std::string& output)
+        {
+            lzma_stream_guard guard;
+            auto& strm = guard.strm;
+            if (lzma_stream_decoder(&strm, UINT64_MAX, LZMA_TELL_UNSUPPORTED_CHECK | LZMA_CONCATENATED) != LZMA_OK)
+                throw std::runtime_error("lzma decompression failed 1");
+            size_t used = 0;
+            bool eof = false;
+            for (;;) {
+                if (strm.avail_in == 0 && !eof) {
+                    const auto chunk = input.next();
+                    eof = chunk.empty();
+                    strm.next_in = reinterpret_cast<const uint8_t*>(chunk.data());
+                    strm.avail_in = chunk.size();
+                }
+                make_room(output, used);
+                strm.next_out = reinterpret_cast<uint8_t*>(output.data() + used);
+                strm.avail_out = output.size() - used;
+                const auto r = lzma_code(&strm, eof ? LZMA_FINISH : LZMA_RUN);
+                used = output.size() - strm.avail_out;
+                if (r == LZMA_STREAM_END)
+                    break;
+                else if (r != LZMA_OK)
+                    throw std::runtime_error("lzma decompression failed 2");
+            }
+            output.resize(used);
+        }
+
+        // ----------------------------------------------------------------------
+
+        void read_bz2(fd_input& input, std::string& output)
+        {
+            constexpr size_t MaxChunk = std::numeric_limits<unsigned int>::max(); // avail_out is 32 bit
+            bz_stream strm;
+            strm.bzalloc = nullptr;
+            strm.bzfree = nullptr;
+            strm.opaque = nullptr;
+            strm.avail_in = 0;
+            if (BZ2_bzDecompressInit(&strm, 0 /*verbosity*/, 0 /* not small */) != BZ_OK)
+                throw std::runtime_error("bz2 decompression failed during initialization");
+            try {
+                size_t used = 0;
+                bool output_pending = false; // previous call filled output completely and may have more to emit
+                bool next_stream = false;    // not the first stream, bad magic means trailing garbage
+                for (;;) {
+                    if (strm.avail_in == 0 && !output_pending) {
+                        const auto chunk = input.next();
+                        if (chunk.empty())
+                            throw std::runtime_error("bz2 decompression failed: unexpected end of input");
+                        strm.next_in = const_cast<char*>(chunk.data());
+                        strm.avail_in = static_cast<decltype(strm.avail_in)>(chunk.size());
+                    }
+                    make_room(output, used);
+                    const auto out_chunk = std::min(output.size() - used, MaxChunk);
+                    strm.next_out = output.data() + used;
+                    strm.avail_out = static_cast<decltype(strm.avail_out)>(out_chunk);
+                    const auto r = BZ2_bzDecompress(&strm);
+                    used += out_chunk - strm.avail_out;
+                    output_pending = strm.avail_out == 0;
+                    if (r == BZ_STREAM_END) {
+                        // multi-stream input (pbzip2, concatenated files): continue with the next stream, trailing garbage is ignored as bzip2 does
+                        if (strm.avail_in == 0) {
+                            const auto chunk = input.next();
+                            strm.next_in = const_cast<char*>(chunk.data());
+                            strm.avail_in = static_cast<decltype(strm.avail_in)>(chunk.size());
+                        }
+                        if (strm.avail_in == 0)
+                            break;
+                        const auto next_in = strm.next_in;
+                        const auto avail_in = strm.avail_in;
+                        BZ2_bzDecompressEnd(&strm);
+                        if (BZ2_bzDecompressInit(&strm, 0 /*verbosity*/, 0 /* not small */) != BZ_OK)
+                            throw std::runtime_error("bz2 decompression failed during initialization");
+                        strm.next_in = next_in;
+                        strm.avail_in = avail_in;
+                        output_pending = false;
+                        next_stream = true;
+                    }
+                    else if (r == BZ_DATA_ERROR_MAGIC && next_stream)
+                        break;
+                    else if (r != BZ_OK)
+                        throw std::runtime_error("bz2 decompression failed, code: " + std::to_string(r));
+                }
+                output.resize(used);
+                BZ2_bzDecompressEnd(&strm);
+            }
+            catch (std::exception&) {
+                BZ2_bzDecompressEnd(&strm);
+                throw;
+            }
+        }
+
+        // ----------------------------------------------------------------------
+
+        void read_zstd(fd_input& input, std::string& output)
+        {
+            ZSTD_DCtx* ctx = ZSTD_createDCtx();
+            if (!ctx)
+                throw std::runtime_error("zstd decompression failed during initialization");
+            try {
+                ZSTD_inBuffer in{nullptr, 0, 0};
+                size_t used = 0, last_res = 0;
+                bool output_pending = false;
+                for (;;) {
+                    if (in.pos == in.size && !output_pending) {
+                        const auto chunk = input.next();
+                        if (chunk.empty())
+                            break;
+                        in = ZSTD_inBuffer{chunk.data(), chunk.size(), 0};
+                    }
+                    make_room(output, used);
+                    ZSTD_outBuffer out{output.data(), output.size(), used};
+                    last_res = ZSTD_decompressStream(ctx, &out, &in);
+                    if (ZSTD_isError(last_res))
+                        throw std::runtime_error(std::string{"zstd decompression failed: "} + ZSTD_getErrorName(last_res));
+                    used = out.pos;
+                    output_pending = used == output.size();
+                }
+                if (last_res != 0)
+                    throw std::runtime_error("zstd decompression failed: unexpected end of input");
+                output.resize(used);
+                ZSTD_freeDCtx(ctx);
+            }
+            catch (std::exception&) {
+                ZSTD_freeDCtx(ctx);
+                throw;
+            }
+        }
+
+        // ----------------------------------------------------------------------
+
+        void read_brotli(fd_input& input, std::string& output)
+        {
+            brotli_decoder decoder; // destructor releases decoder state if reading or decoding throws
+            output.clear();
+            for (;;) {
+                const auto chunk = input.next();
+                if (chunk.empty()) {
+                    decoder.finish(); // throws if stream is incomplete
+                    break;
+                }
+                if (decoder.push(chunk, output))
+                    break;
+            }
+        }
+
+    } // namespace
+} // namespace acmacs::file
+
+// ----------------------------------------------------------------------
+
+std::string acmacs::file::read_from_file_descriptor(int fd, size_t chunk_size)
+{
+    fd_input input{fd, chunk_size};
+    const auto head = input.head();
+    std::string output(input.chunk_size() * 4, ' ');
+    if (head.size() < sizeof(xz_internal::sXzSig)) // too short to be compressed
+        read_plain(input, output);
+    else if (xz_compressed(head.data()))
+        read_xz(input, output);
+    else if (zstd_compressed(head.data()))
+        read_zstd(input, output);
+    else if (brotli_compressed(head))
+        read_brotli(input, output);
+    else if (bz2_compressed(head.data()))
+        read_bz2(input, output);
+    else if (gzip_compressed(head.data()))
+        read_gzip(input, output);
+    else
+        read_plain(input, output);
+    return output;
+
+} // acmacs::file::read_from_file_descriptor
+
+// ----------------------------------------------------------------------
+
+std::string acmacs::file::read_raw_from_file_descriptor(int fd, size_t chunk_size)
+{
+    fd_input input{fd, chunk_size};
+    std::string output(input.chunk_size() * 4, ' ');
+    read_plain(input, output);
+    return output;
+
+} // acmacs::file::read_raw_from_file_descriptor
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
@@ -6,43 +6,84 @@
 #include <cstdio>
 #include <cstdlib>
 #include <sys/types.h>
+#include <sys/stat.h>
 #include <sys/mman.h>
+#include <sys/ioctl.h>
+#ifdef __linux__
+#include <sys/xattr.h>
+#endif
+#ifdef __linux__
+#include <linux/fs.h> // FICLONE
+#endif
+#include <limits>
+#include <thread>
+#include <utility>
 
 #include "acmacs-base/filesystem.hh"
 #include "acmacs-base/string-compare.hh"
+#include "acmacs-base/string-from-chars.hh"
 #include "acmacs-base/fmt.hh"
 #include "acmacs-base/xz.hh"
 #include "acmacs-base/bzip2.hh"
 #include "acmacs-base/gzip.hh"
+#include "acmacs-base/zstd.hh"
 #include "acmacs-base/brotli.hh"
 #include "acmacs-base/date.hh"
 #include "acmacs-base/read-file.hh"
+#include "acmacs-base/decompress-cache.hh"
 #include "acmacs-base/temp-file.hh"
 
 // ----------------------------------------------------------------------
 
-acmacs::file::read_access::read_access(std::string_view aFilename)
+namespace acmacs::file
 {
-    if (aFilename == "-") {
-        constexpr size_t chunk_size = 1024 * 100;
-        data_.resize(chunk_size);
-        ssize_t start = 0;
-        for (;;) {
-            if (const auto bytes_read = ::read(0, data_.data() + start, chunk_size); bytes_read > 0) {
-                start += bytes_read;
-                data_.resize(static_cast<size_t>(start));
-            }
-            else
-                break;
+    static inline int madvise_flag(access_pattern pattern)
+    {
+        switch (pattern) {
+            case access_pattern::normal:
+                return MADV_NORMAL;
+            case access_pattern::sequential:
+                return MADV_SEQUENTIAL;
+            case access_pattern::random:
+                return MADV_RANDOM;
+            case access_pattern::willneed:
+                return MADV_WILLNEED;
         }
+        return MADV_NORMAL;
+    }
+
+    static inline int mmap_flags([[maybe_unused]] const read_hints& hints)
+    {
+#ifdef MAP_POPULATE
+        if (hints.populate)
+            return MAP_FILE | MAP_PRIVATE | MAP_POPULATE;
+#endif
+        return MAP_FILE | MAP_PRIVATE;
+    }
+
+} // namespace acmacs::file
+
+// ----------------------------------------------------------------------
+
+acmacs::file::read_access::read_access(std::string_view aFilename, const read_hints& hints)
+{
+    if (aFilename == "-") {
+        stdin_pending_ = true;
     }
     else if (fs::exists(aFilename)) {
         len_ = fs::file_size(aFilename);
         fd = ::open(aFilename.data(), O_RDONLY);
         if (fd >= 0) {
-            mapped_ = reinterpret_cast<char*>(mmap(nullptr, len_, PROT_READ, MAP_FILE | MAP_PRIVATE, fd, 0));
+            mapped_ = reinterpret_cast<char*>(mmap(nullptr, len_, PROT_READ, mmap_flags(hints), fd, 0));
             if (mapped_ == MAP_FAILED)
                 throw cannot_read{fmt::format("{}: {}", aFilename, strerror(errno))};
+            // advices are hints, failures are ignored
+            if (hints.pattern != access_pattern::normal)
+                madvise(mapped_, len_, madvise_flag(hints.pattern));
+#ifdef MADV_HUGEPAGE
+            if (hints.huge_pages)
+                madvise(mapped_, len_, MADV_HUGEPAGE);
+#endif
         }
         else {
             throw not_opened{fmt::format("{}: {}", aFilename, strerror(errno))};
@@ -57,11 +98,12 @@ acmacs::file::read_access::read_access(std::string_view aFilename)
 // ----------------------------------------------------------------------
 
 acmacs::file::read_access::read_access(read_access&& other)
-    : fd{other.fd}, len_{other.len_}, mapped_{other.mapped_}, data_{other.data_}
+    : fd{other.fd}, len_{other.len_}, mapped_{other.mapped_}, stdin_pending_{other.stdin_pending_}, data_{std::move(other.data_)}
 {
     other.fd = -1;
     other.len_ = 0;
     other.mapped_ = nullptr;
+    other.stdin_pending_ = false;
     other.data_.clear();
 
 } // acmacs::file::read_access::read_access
@@ -85,11 +127,13 @@ acmacs::file::read_access& acmacs::file::read_access::operator=(read_access&& ot
     fd = other.fd;
     len_ = other.len_;
     mapped_ = other.mapped_;
-    data_ = other.data_;
+    stdin_pending_ = other.stdin_pending_;
+    data_ = std::move(other.data_);
 
     other.fd = -1;
     other.len_ = 0;
     other.mapped_ = nullptr;
+    other.stdin_pending_ = false;
     other.data_.clear();
 
     return *this;
@@ -98,82 +142,306 @@ acmacs::file::read_access& acmacs::file::read_access::operator=(read_access&& ot
 
 // ----------------------------------------------------------------------
 
-std::string acmacs::file::decompress_if_necessary(std::string_view aSource)
+const std::string& acmacs::file::read_access::stdin_raw() const
 {
-    if (xz_compressed(aSource.data()))
-        return xz_decompress(aSource);
-    else if (brotli_compressed(aSource))
-        return brotli_decompress(aSource);
-    else if (bz2_compressed(aSource.data()))
-        return bz2_decompress(aSource);
-    else if (gzip_compressed(aSource.data())) {
-        return gzip_decompress(aSource);
+    if (stdin_pending_) {
+        data_ = read_raw_from_file_descriptor(0);
+        stdin_pending_ = false;
     }
-    else
-        return std::string(aSource);
+    return data_;
 
-} // acmacs::file::decompress_if_necessary
+} // acmacs::file::read_access::stdin_raw
 
 // ----------------------------------------------------------------------
 
-std::string acmacs::file::read_from_file_descriptor(int fd, size_t chunk_size)
+acmacs::file::read_access::operator std::string() &&
 {
-    std::string buffer;
-    std::string::size_type offset = 0;
-    for (;;) {
-        buffer.resize(buffer.size() + chunk_size, ' ');
-        const auto bytes_read = ::read(fd, (&*buffer.begin()) + offset, chunk_size);
-        if (bytes_read < 0)
-            throw std::runtime_error(std::string("Cannot read from file descriptor: ") + strerror(errno));
-        if (static_cast<size_t>(bytes_read) < chunk_size) {
-            buffer.resize(buffer.size() - chunk_size + static_cast<size_t>(bytes_read));
-            break;
+    if (mapped_)
+        return decompress_if_necessary(raw());
+    if (stdin_pending_) { // raw data not requested, single buffer
+        stdin_pending_ = false;
+        return read_from_file_descriptor(0);
+    }
+    return decompress_if_necessary(std::move(data_));
+
+} // acmacs::file::read_access::operator std::string
+
+// ----------------------------------------------------------------------
+
+acmacs::file::prefetch_t::prefetch_t(std::vector<std::filesystem::path> filenames)
+    : cancelled_{std::make_unique<std::atomic<bool>>(false)}
+{
+    thread_ = std::thread([filenames = std::move(filenames), cancelled = cancelled_.get()]() {
+        for (const auto& filename : filenames) {
+            if (*cancelled)
+                break;
+            if (const int fd = ::open(filename.c_str(), O_RDONLY); fd >= 0) {
+#if defined(POSIX_FADV_WILLNEED)
+                posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+#elif defined(F_RDADVISE)
+                struct stat st;
+                if (fstat(fd, &st) == 0) {
+                    radvisory advice{.ra_offset = 0, .ra_count = static_cast<int>(std::min(st.st_size, static_cast<off_t>(std::numeric_limits<int>::max())))};
+                    fcntl(fd, F_RDADVISE, &advice);
+                }
+#endif
+                ::close(fd);
+            }
         }
-        offset += static_cast<size_t>(bytes_read);
+    });
+
+} // acmacs::file::prefetch_t::prefetch_t
+
+// ----------------------------------------------------------------------
+
+acmacs::file::prefetch_t& acmacs::file::prefetch_t::operator=(prefetch_t&& rhs)
+{
+    if (this != &rhs) {
+        cancel();
+        wait();
+        cancelled_ = std::move(rhs.cancelled_);
+        thread_ = std::move(rhs.thread_);
     }
-    return decompress_if_necessary(std::string_view(buffer));
+    return *this;
 
-} // acmacs::file::read_from_file_descriptor
+} // acmacs::file::prefetch_t::operator=
 
 // ----------------------------------------------------------------------
 
-void acmacs::file::backup(std::string_view _to_backup, std::string_view _backup_dir, backup_move bm)
+acmacs::file::prefetch_t::~prefetch_t()
 {
-    const fs::path to_backup{_to_backup}, backup_dir{_backup_dir};
+    cancel();
+    wait();
 
-    if (fs::exists(to_backup)) {
-        try {
-            fs::create_directory(backup_dir);
-        }
-        catch (std::exception& err) {
-            fmt::print(stderr, "> ERROR cannot create directory {}: {}\n", backup_dir.native(), err);
-            throw;
+} // acmacs::file::prefetch_t::~prefetch_t
+
+// ----------------------------------------------------------------------
+
+std::string acmacs::file::decompress_if_necessary(std::string_view aSource)
+{
+    std::string output;
+    decompress_if_necessary(aSource, output);
+    return output;
+
+} // acmacs::file::decompress_if_necessary
+
+// ----------------------------------------------------------------------
+
+namespace acmacs::file
+{
+    using decompressor_t = void (*)(std::string_view input, std::string& output);
+
+    // nullptr if source is not compressed
+    static decompressor_t decompressor_for(std::string_view aSource)
+    {
+        if (xz_compressed(aSource.data()))
+            return [](std::string_view input, std::string& out) { xz_decompress(input, out); };
+        else if (zstd_compressed(aSource.data()))
+            return [](std::string_view input, std::string& out) { zstd_decompress(input, out); };
+        else if (brotli_compressed(aSource))
+            return [](std::string_view input, std::string& out) { brotli_decompress(input, out); };
+        else if (bz2_compressed(aSource.data()))
+            return [](std::string_view input, std::string& out) { bz2_decompress(input, out); };
+        else if (gzip_compressed(aSource.data()))
+            return [](std::string_view input, std::string& out) { gzip_decompress(input, out); };
+        else
+            return nullptr;
+    }
+
+    static void decompress(decompressor_t decompressor, std::string_view aSource, std::string& output)
+    {
+        if (!decompress_cache::get(aSource, output)) {
+            decompressor(aSource, output);
+            decompress_cache::put(aSource, output);
         }
+    }
+
+} // namespace acmacs::file
+
+// ----------------------------------------------------------------------
+
+void acmacs::file::decompress_if_necessary(std::string_view aSource, std::string& output)
+{
+    if (const auto decompressor = decompressor_for(aSource); decompressor)
+        decompress(decompressor, aSource, output);
+    else
+        output.assign(aSource);
+
+} // acmacs::file::decompress_if_necessary
+
+// ----------------------------------------------------------------------
+
+std::string acmacs::file::decompress_if_necessary(std::string&& aSource)
+{
+    const auto decompressor = decompressor_for(aSource);
+    if (!decompressor)
+        return std::move(aSource);
+    std::string output;
+    decompress(decompressor, aSource, output);
+    return output;
 
+} // acmacs::file::decompress_if_necessary
+
+// ----------------------------------------------------------------------
+
+namespace acmacs::file
+{
+    // next backup name <backup_dir>/<stem>.~<YYYYmmdd>-<NNN>~<extension>, today's backups are found by a single directory scan, version 999 is reused when exhausted
+    static fs::path backup_name(const fs::path& to_backup, const fs::path& backup_dir)
+    {
         auto extension = to_backup.extension();
         auto stem = to_backup.stem();
-        if ((extension == ".bz2" || extension == ".xz" || extension == ".gz") && !stem.extension().empty()) {
+        if ((extension == ".bz2" || extension == ".xz" || extension == ".gz" || extension == ".zst") && !stem.extension().empty()) {
             extension = stem.extension();
             extension += to_backup.extension();
             stem = stem.stem();
         }
-        const auto today = date::display(date::today(), "%Y%m%d");
-        for (int version = 1; version < 1000; ++version) {
-            char infix[4];
-            std::snprintf(infix, 4, "%03d", version);
-            fs::path new_name = backup_dir / (stem.string() + ".~" + today + '-' + infix + '~' + extension.string());
-            if (!fs::exists(new_name) || version == 999) {
-                try {
-                    if (bm == backup_move::yes)
-                        fs::rename(to_backup, new_name); // if new_name exists it will be removed before doing rename
-                    else
-                        fs::copy_file(to_backup, new_name, fs::copy_options::overwrite_existing);
-                }
-                catch (std::exception& err) {
-                    fmt::print(stderr, ">> WARNING backing up \"{}\" to \"{}\" failed: {}\n", to_backup.native(), new_name.native(), err);
+        const auto prefix = fmt::format("{}.~{}-", stem.string(), date::display(date::today(), "%Y%m%d"));
+        const auto suffix = fmt::format("~{}", extension.string());
+        constexpr size_t version_size = 3;
+        int last_version = 0;
+        for (const auto& entry : fs::directory_iterator(backup_dir)) {
+            if (const auto name = entry.path().filename().string(); name.size() == (prefix.size() + version_size + suffix.size()) && acmacs::string::startswith(name, prefix) && acmacs::string::endswith(name, suffix)) {
+                if (const auto version = acmacs::string::from_chars<int>(std::string_view{name}.substr(prefix.size(), version_size)); version < 1000)
+                    last_version = std::max(last_version, version);
+            }
+        }
+        return backup_dir / fmt::format("{}{:03d}{}", prefix, std::min(last_version + 1, 999), suffix);
+    }
+
+    // shares data extents of source with target (btrfs, xfs, apfs...), returns false if not supported by platform or filesystem
+    static bool reflink([[maybe_unused]] const fs::path& source, [[maybe_unused]] const fs::path& target)
+    {
+#ifdef FICLONE
+        bool result = false;
+        if (const int src = ::open(source.c_str(), O_RDONLY); src >= 0) {
+            struct stat st;
+            if (fstat(src, &st) == 0) {
+                if (const int dst = ::open(target.c_str(), O_WRONLY | O_TRUNC | O_CREAT, st.st_mode & 07777); dst >= 0) {
+                    result = ioctl(dst, FICLONE, src) == 0;
+                    ::close(dst);
+                    if (!result)
+                        ::unlink(target.c_str());
                 }
-                break;
             }
+            ::close(src);
+        }
+        return result;
+#else
+        return false;
+#endif
+    }
+
+    static void make_backup_dir(const fs::path& backup_dir)
+    {
+        try {
+            fs::create_directory(backup_dir);
+        }
+        catch (std::exception& err) {
+            fmt::print(stderr, "> ERROR cannot create directory {}: {}\n", backup_dir.native(), err);
+            throw;
+        }
+    }
+
+    // to_backup is going to be replaced by rename, i.e. its content is not going to change and it can be hard linked into backup dir
+    static void backup_before_replace(const fs::path& to_backup)
+    {
+        const auto backup_dir = to_backup.parent_path() / ".backup";
+        make_backup_dir(backup_dir);
+        fs::path new_name;
+        try {
+            new_name = backup_name(to_backup, backup_dir);
+            std::error_code ec;
+            fs::remove(new_name, ec); // version 999 is overwritten
+            fs::create_hard_link(to_backup, new_name, ec);
+            if (ec && !reflink(to_backup, new_name))
+                fs::copy_file(to_backup, new_name, fs::copy_options::overwrite_existing);
+        }
+        catch (std::exception& err) {
+            fmt::print(stderr, ">> WARNING backing up \"{}\" to \"{}\" failed: {}\n", to_backup.native(), new_name.native(), err);
+        }
+    }
+
+    // copies extended attributes (including ACLs stored as system.posix_acl_*) of filename to fd, returns false if any of them cannot be copied
+    static bool copy_xattrs([[maybe_unused]] const char* filename, [[maybe_unused]] int fd)
+    {
+#ifdef __linux__
+        const auto names_size = llistxattr(filename, nullptr, 0);
+        if (names_size <= 0)
+            return names_size == 0 || errno == ENOTSUP;
+        std::string names(static_cast<size_t>(names_size), '\0');
+        if (llistxattr(filename, names.data(), names.size()) != names_size)
+            return false;
+        std::string value;
+        for (const char* name = names.data(); name < names.data() + names.size(); name += std::strlen(name) + 1) {
+            const auto value_size = lgetxattr(filename, name, nullptr, 0);
+            if (value_size < 0)
+                return false;
+            value.resize(static_cast<size_t>(value_size));
+            if (lgetxattr(filename, name, value.data(), value.size()) != value_size || fsetxattr(fd, name, value.data(), value.size(), 0) != 0)
+                return false;
+        }
+#endif
+        return true;
+    }
+
+} // namespace acmacs::file
+
+// ----------------------------------------------------------------------
+
+// Existing regular file owned by the caller and not hard linked elsewhere is replaced by renaming a new file over it. Temp file
+// gets mode, group and extended attributes of the file, if any of them cannot be set, -1 is returned and the file is written in place.
+int acmacs::file::detail::open_replacement(const std::string& filename, std::string& temp_name)
+{
+    struct stat st;
+    if (lstat(filename.c_str(), &st) != 0 || !S_ISREG(st.st_mode) || st.st_nlink != 1 || st.st_uid != geteuid())
+        return -1;
+    const fs::path path{filename};
+    temp_name = (path.parent_path() / fmt::format(".{}.XXXXXX", path.filename().native())).native();
+    const int fd = mkstemp(temp_name.data());
+    if (fd >= 0) {
+        if (fchown(fd, static_cast<uid_t>(-1), st.st_gid) == 0 && fchmod(fd, st.st_mode & 07777) == 0 && copy_xattrs(filename.c_str(), fd))
+            return fd;
+        ::close(fd);
+        ::unlink(temp_name.c_str());
+    }
+    temp_name.clear();
+    return -1;
+
+} // acmacs::file::detail::open_replacement
+
+// ----------------------------------------------------------------------
+
+void acmacs::file::detail::commit_replacement(int fd, std::string_view filename, const std::string& temp_name)
+{
+    const bool synced = fsync(fd) == 0; // data must be on disk before rename replaces the file
+    const auto sync_errno = errno;
+    if (::close(fd) != 0 || !synced)
+        throw std::runtime_error(fmt::format("Cannot write {}: {}", filename, strerror(synced ? errno : sync_errno)));
+    backup_before_replace(fs::path{filename});
+    if (::rename(temp_name.c_str(), std::string{filename}.c_str()) != 0)
+        throw std::runtime_error(fmt::format("Cannot rename {} to {}: {}", temp_name, filename, strerror(errno)));
+
+} // acmacs::file::detail::commit_replacement
+
+// ----------------------------------------------------------------------
+
+void acmacs::file::backup(std::string_view _to_backup, std::string_view _backup_dir, backup_move bm)
+{
+    const fs::path to_backup{_to_backup}, backup_dir{_backup_dir};
+
+    if (fs::exists(to_backup)) {
+        make_backup_dir(backup_dir);
+        fs::path new_name;
+        try {
+            new_name = backup_name(to_backup, backup_dir);
+            if (bm == backup_move::yes)
+                fs::rename(to_backup, new_name); // if new_name exists it will be removed before doing rename
+            else if (!reflink(to_backup, new_name))
+                fs::copy_file(to_backup, new_name, fs::copy_options::overwrite_existing);
+        }
+        catch (std::exception& err) {
+            fmt::print(stderr, ">> WARNING backing up \"{}\" to \"{}\" failed: {}\n", to_backup.native(), new_name.native(), err);
         }
     }
 
@@ -189,10 +457,26 @@ void acmacs::file::backup(const std::string_view to_backup, backup_move bm)
 
 // ----------------------------------------------------------------------
 
-void acmacs::file::write(std::string_view aFilename, std::string_view aData, force_compression aForceCompression, backup_file aBackupFile)
+void acmacs::file::write_to_file_descriptor(int fd, std::string_view data, std::string_view filename)
+{
+    while (!data.empty()) {
+        if (const auto written = ::write(fd, data.data(), data.size()); written > 0)
+            data.remove_prefix(static_cast<size_t>(written));
+        else if (written == 0)
+            throw std::runtime_error(fmt::format("Cannot write {}: no data written", filename));
+        else if (errno != EINTR)
+            throw std::runtime_error(fmt::format("Cannot write {}: {}", filename, strerror(errno)));
+    }
+
+} // acmacs::file::write_to_file_descriptor
+
+// ----------------------------------------------------------------------
+
+void acmacs::file::write(std::string_view aFilename, std::string_view aData, force_compression aForceCompression, backup_file aBackupFile, const compression_policy& policy)
 {
     using namespace std::string_view_literals;
     int f = -1;
+    std::string temp_name; // if not empty, data is written into temp file which then atomically replaces aFilename, old file is hard linked into backup dir
     if (aFilename == "-") {
         f = 1;
     }
@@ -205,28 +489,47 @@ void acmacs::file::write(std::string_view aFilename, std::string_view aData, for
             throw std::runtime_error(fmt::format("Cannot open /dev/null: {}", strerror(errno)));
     }
     else {
-        if (aBackupFile == backup_file::yes && aFilename.substr(0, 4) != "/dev") // allow writing to /dev/ without making backup attempt
-            backup(aFilename);
-        f = open(aFilename.data(), O_WRONLY | O_TRUNC | O_CREAT, 0644);
-        if (f < 0)
-            throw std::runtime_error(fmt::format("Cannot open {}: {}", aFilename, strerror(errno)));
+        const std::string filename{aFilename};
+        if (aBackupFile == backup_file::yes && aFilename.substr(0, 4) != "/dev") { // allow writing to /dev/ without making backup attempt
+            f = detail::open_replacement(filename, temp_name);
+            if (temp_name.empty())
+                backup(aFilename);
+        }
+        if (f < 0) {
+            f = open(filename.c_str(), O_WRONLY | O_TRUNC | O_CREAT, 0644);
+            if (f < 0)
+                throw std::runtime_error(fmt::format("Cannot open {}: {}", aFilename, strerror(errno)));
+        }
     }
     try {
-        if (aForceCompression == force_compression::yes || (aFilename.size() > 3 && (acmacs::string::endswith(aFilename, ".xz"sv) || acmacs::string::endswith(aFilename, ".gz"sv)))) {
-            const auto compressed = acmacs::string::endswith(aFilename, ".gz"sv) ? gzip_compress(aData) : xz_compress(aData);
-            if (::write(f, compressed.data(), compressed.size()) < 0)
-                throw std::runtime_error(fmt::format("Cannot write {}: {}", aFilename, strerror(errno)));
+        if (aForceCompression == force_compression::yes || (aFilename.size() > 3 && (acmacs::string::endswith(aFilename, ".xz"sv) || acmacs::string::endswith(aFilename, ".gz"sv) || acmacs::string::endswith(aFilename, ".zst"sv) || acmacs::string::endswith(aFilename, ".bz2"sv)))) {
+            const auto compressed = [aFilename, aData, &policy]() {
+                if (acmacs::string::endswith(aFilename, ".gz"sv))
+                    return gzip_compress(aData, policy);
+                else if (acmacs::string::endswith(aFilename, ".zst"sv))
+                    return zstd_compress(aData, policy);
+                else if (acmacs::string::endswith(aFilename, ".bz2"sv))
+                    return bz2_compress(aData, policy);
+                else
+                    return xz_compress(aData, policy);
+            }();
+            write_to_file_descriptor(f, compressed, aFilename);
         }
         else {
-            if (::write(f, aData.data(), aData.size()) < 0)
-                throw std::runtime_error(fmt::format("Cannot write {}: {}", aFilename, strerror(errno)));
+            write_to_file_descriptor(f, aData, aFilename);
         }
-        if (f > 2)
+        if (!temp_name.empty())
+            detail::commit_replacement(std::exchange(f, -1), aFilename, temp_name);
+        else if (f > 2) {
             close(f);
+            f = -1;
+        }
     }
     catch (std::exception&) {
         if (f > 2)
             close(f);
+        if (!temp_name.empty())
+            ::unlink(temp_name.c_str());
         throw;
     }
 
@@ -1,8 +1,17 @@
 #pragma once
 
 #include <stdexcept>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <filesystem>
 #include <string>
 #include <string_view>
+#include <vector>
+#include <optional>
+
+#include "acmacs-base/compression.hh"
+#include "acmacs-base/xz.hh"
 
 // ----------------------------------------------------------------------
 
@@ -12,9 +21,23 @@ namespace acmacs::file
     enum class backup_file { no, yes };
     enum class backup_move { no, yes };
 
+      // hints passed to the kernel when a file is mmapped by read_access, all of them are advisory and ignored if unsupported by the platform
+    enum class access_pattern { normal, sequential, random, willneed };
+
+    struct read_hints
+    {
+        bool populate{false};                                 // MAP_POPULATE: pre-fault the whole file during mmap (Linux)
+        access_pattern pattern{access_pattern::normal};       // madvise advice for the mapped region, e.g. sequential for reading the whole file once
+        bool huge_pages{false};                               // MADV_HUGEPAGE: transparent huge pages (Linux)
+    };
+
       // ----------------------------------------------------------------------
 
     std::string decompress_if_necessary(std::string_view aSource);
+      // decompresses (or copies) into output replacing its content, capacity of output is reused
+    void decompress_if_necessary(std::string_view aSource, std::string& output);
+      // uncompressed source is moved to the result without copying
+    std::string decompress_if_necessary(std::string&& aSource);
 
       // ----------------------------------------------------------------------
 
@@ -27,34 +50,143 @@ namespace acmacs::file
     {
      public:
         read_access() = default;
-        read_access(std::string_view aFilename);
+        read_access(std::string_view aFilename, const read_hints& hints = {});
         ~read_access();
         read_access(const read_access&) = delete;
         read_access(read_access&&);
         read_access& operator=(const read_access&) = delete;
         read_access& operator=(read_access&&);
-        operator std::string() const { return mapped_ ? decompress_if_necessary({mapped_, len_}) : decompress_if_necessary(data_); }
-        size_t size() const { return mapped_ ? len_ : data_.size(); }
-        const char* data() const { return mapped_ ? mapped_ : data_.data(); }
-        std::string_view raw() const { return mapped_ ? std::string_view(mapped_, len_) : std::string_view{data_}; }
-        bool valid() const { return mapped_ != nullptr || !data_.empty(); }
+        operator std::string() const& { return decompress_if_necessary(raw()); }
+        operator std::string() &&;
+        size_t size() const { return mapped_ ? len_ : stdin_raw().size(); }
+        const char* data() const { return mapped_ ? mapped_ : stdin_raw().data(); }
+        std::string_view raw() const { return mapped_ ? std::string_view(mapped_, len_) : std::string_view{stdin_raw()}; }
+        bool valid() const { return mapped_ != nullptr || !stdin_raw().empty(); }
 
      private:
         int fd = -1;
         size_t len_ = 0;
         char* mapped_ = nullptr;
-        std::string data_;
+          // stdin ("-") is read on first use: converting rvalue read_access to std::string decompresses on the fly into the result
+          // without keeping raw data, raw(), data(), size(), valid() and lvalue conversion read and keep data as piped
+        mutable bool stdin_pending_ = false;
+        mutable std::string data_;
+
+        const std::string& stdin_raw() const;
 
     }; // class read_access
 
-    inline read_access read(std::string_view aFilename) { return read_access{aFilename}; }
-    std::string read_from_file_descriptor(int fd, size_t chunk_size = 1024);
+    inline read_access read(std::string_view aFilename, const read_hints& hints = {}) { return read_access{aFilename, hints}; }
+      // read-ahead for the files in a background thread, missing files are silently ignored.
+      // Destroying the handle cancels advising the remaining files and joins the thread, wait() joins without cancelling.
+    class prefetch_t
+    {
+      public:
+        prefetch_t() = default;
+        explicit prefetch_t(std::vector<std::filesystem::path> filenames);
+        prefetch_t(prefetch_t&&) = default;
+        prefetch_t& operator=(prefetch_t&& rhs);
+        ~prefetch_t();
+
+        void cancel() { if (cancelled_) *cancelled_ = true; }
+        void wait() { if (thread_.joinable()) thread_.join(); }
+
+      private:
+        std::unique_ptr<std::atomic<bool>> cancelled_;
+        std::thread thread_;
+    };
+
+      // initiates read-ahead and returns immediately, keep the returned handle while the files are needed
+    [[nodiscard]] inline prefetch_t prefetch(std::vector<std::filesystem::path> filenames) { return prefetch_t{std::move(filenames)}; }
+
+      // ----------------------------------------------------------------------
+      // in-process cache of decompressed file content, entries are keyed by path and validated by mtime, size and inode on every call,
+      // unchanged files are neither re-read nor re-decompressed. Returned buffers are immutable and stay valid after eviction.
+      // Memory budget is 256MiB by default, ACMACS_CONTENT_CACHE_SIZE=<MiB> overrides it, 0 disables caching.
+
+    using shared_content = std::shared_ptr<const std::string>;
+    shared_content read_cached(std::string_view filename);
+
+    namespace content_cache
+    {
+        struct statistics_t
+        {
+            size_t hits{0};
+            size_t misses{0};
+            size_t evicted{0};
+            size_t entries{0};
+            size_t memory_used{0};
+        };
+
+        void set_memory_budget(size_t bytes); // least recently used entries are evicted immediately if the new budget is exceeded
+        void clear();
+        statistics_t statistics();
+
+    } // namespace content_cache
+
+      // ----------------------------------------------------------------------
+
+      // ----------------------------------------------------------------------
+      // random access to the uncompressed content of a file. For multi-block .xz (written with compression_policy::block_size, xz -T or
+      // xz --block-size) only blocks covering the requested range are decompressed, the last decompressed block is kept for subsequent reads.
+      // Uncompressed files are read directly, other compressed files are decompressed completely on the first access. Not thread safe.
+
+    class seekable_reader
+    {
+      public:
+        explicit seekable_reader(std::string_view filename, const read_hints& hints = {.pattern = access_pattern::random});
+
+        size_t size() const; // uncompressed
+        bool seekable() const { return blocks_.size() > 1 || !compressed_; } // reading a range does not require decompressing preceding data
+        size_t number_of_blocks() const { return blocks_.size(); }
+
+        // range is clipped at the end of data, output content is replaced
+        void read_range(size_t offset, size_t length, std::string& output);
+        std::string read_range(size_t offset, size_t length)
+        {
+            std::string output;
+            read_range(offset, length, output);
+            return output;
+        }
+
+      private:
+        read_access file_;
+        bool compressed_{false};
+        std::vector<xz_block_t> blocks_;
+        mutable std::optional<size_t> cached_block_; // index in blocks_ of the block in cache_
+        mutable bool whole_cached_{false};            // cache_ holds the whole content of non seekable compressed file
+        mutable std::string cache_;
+
+        const std::string& whole() const;
+    };
+
+      // ----------------------------------------------------------------------
+
+      // input is decompressed on the fly, format is detected by the first bytes
+    std::string read_from_file_descriptor(int fd, size_t chunk_size = 1024 * 1024);
+      // input as is, without decompression
+    std::string read_raw_from_file_descriptor(int fd, size_t chunk_size = 1024 * 1024);
     inline std::string read_stdin() { return read_from_file_descriptor(0); }
-    void write(std::string_view aFilename, std::string_view aData, force_compression aForceCompression = force_compression::no, backup_file aBackupFile = backup_file::yes);
+      // writes all data retrying after short writes and EINTR, filename is for error messages
+    void write_to_file_descriptor(int fd, std::string_view data, std::string_view filename);
+      // Existing file owned by the caller and not hard linked elsewhere is replaced atomically by renaming a new file over it, the old file
+      // is hard linked into the backup dir. Mode, group and extended attributes are kept, if any of them cannot be set (and for other files)
+      // the file is backed up by copying and overwritten in place.
+    void write(std::string_view aFilename, std::string_view aData, force_compression aForceCompression = force_compression::no, backup_file aBackupFile = backup_file::yes,
+               const compression_policy& policy = default_compression_policy());
 
     void backup(std::string_view to_backup, std::string_view backup_dir, backup_move bm = backup_move::no);
     void backup(std::string_view to_backup, backup_move bm = backup_move::no);
 
+    namespace detail
+    {
+          // replacing file by rename as write() does, used by writer (file-writer.hh) too
+          // returns descriptor of temp file to write to, or -1 (temp_name is empty) if filename is to be backed up by copying and overwritten in place
+        int open_replacement(const std::string& filename, std::string& temp_name);
+          // syncs and closes fd, hard links filename into the backup dir and renames temp file to filename, temp file is not removed on failure
+        void commit_replacement(int fd, std::string_view filename, const std::string& temp_name);
+    }
+
 } // namespace acmacs::file
 
 // ----------------------------------------------------------------------
@@ -648,6 +648,14 @@ rjson::v3::value_read rjson::v3::parse_file(std::string_view filename)
 
 // ----------------------------------------------------------------------
 
+rjson::v3::value_read rjson::v3::parse_file(std::string_view filename, std::string_view content)
+{
+    return parse(std::string{content}, filename);
+
+} // rjson::v3::parse_file
+
+// ----------------------------------------------------------------------
+
 inline to_json::json format_to_json(const rjson::v3::value& val) noexcept
 {
     using namespace std::string_view_literals;
@@ -169,6 +169,9 @@ namespace rjson::v3
             std::optional<std::string> scontent_{std::nullopt}; // see constructor with with_content_ above
         };
 
+        // hash index pointer of object content (small_map_with_unique_keys_t) does not make value larger
+        static_assert(sizeof(object) <= sizeof(string));
+
         class number : public simple
         {
           public:
@@ -324,6 +327,7 @@ namespace rjson::v3
     value_read parse_string(std::string_view data);
     value parse_string_no_keep(std::string_view data); // assume data is kept somewhere, do not copy it
     value_read parse_file(std::string_view filename);
+    value_read parse_file(std::string_view filename, std::string_view content); // content already read (e.g. by acmacs::file::read_cached), filename is for error messages
 
     enum class output { compact, compact_with_spaces, pretty, pretty1, pretty2, pretty4, pretty8 };
 
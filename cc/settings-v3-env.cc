@@ -142,7 +142,9 @@ std::string acmacs::settings::v3::detail::Environment::format_toplevel() const
 
 void acmacs::settings::v3::detail::LoadedDataFiles::load(std::string_view filename)
 {
-    file_data_.insert(file_data_.begin(), rjson::v3::parse_file(filename));
+    auto content = acmacs::file::read_cached(filename);
+    file_data_.insert(file_data_.begin(), rjson::v3::parse_file(filename, *content));
+    file_content_.insert(file_content_.begin(), std::move(content));
     filenames_.insert(filenames_.begin(), std::string{filename});
 
 } // acmacs::settings::v3::detail::LoadedDataFiles::load
@@ -154,8 +156,11 @@ void acmacs::settings::v3::detail::LoadedDataFiles::reload(Data& settings)
     using namespace std::string_view_literals;
     for (auto index{filenames_.size()}; index > 0; --index) {
         if (!filenames_[index - 1].empty()) {
-            AD_LOG(acmacs::log::settings, "re-loading {}", filenames_[index - 1]);
-            file_data_[index - 1] = rjson::v3::parse_file(filenames_[index - 1]);
+            if (auto content = acmacs::file::read_cached(filenames_[index - 1]); content != file_content_[index - 1]) {
+                AD_LOG(acmacs::log::settings, "re-loading {}", filenames_[index - 1]);
+                file_data_[index - 1] = rjson::v3::parse_file(filenames_[index - 1], *content);
+                file_content_[index - 1] = std::move(content);
+            }
         }
         if (const auto& val = file_data_[index - 1]["init"sv]; !val.is_null())
             settings.apply(val);
@@ -2,6 +2,7 @@
 
 #include "acmacs-base/rjson-v3.hh"
 #include "acmacs-base/flat-map.hh"
+#include "acmacs-base/read-file.hh"
 
 // ----------------------------------------------------------------------
 
@@ -73,6 +74,7 @@ namespace acmacs::settings::v3
           private:
             std::vector<std::string> filenames_;
             std::vector<rjson::v3::value_read> file_data_;
+            std::vector<acmacs::file::shared_content> file_content_; // unchanged files are not re-parsed by reload()
         };
 
     } // namespace detail
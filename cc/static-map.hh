@@ -0,0 +1,166 @@
+#pragma once
+
+// Compile time perfect hash map over a constexpr std::array of key-value pairs (hash and displace):
+// keys are distributed into buckets, for every bucket (largest first) a displacement is searched for
+// that puts all its keys into free slots. Lookup is hashing the key, two table reads and one key comparison,
+// it never throws, miss is reported by nullptr.
+//
+//   static constexpr std::array table{std::pair<std::string_view, uint32_t>{"red", 0xFF0000}, ...};
+//   static constexpr acmacs::static_map color_by_name{table};
+//   if (const auto* color = color_by_name.find(name); color) ...
+//
+// Construction in a constant expression fails to compile if keys are duplicated.
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <string_view>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+// ----------------------------------------------------------------------
+
+namespace acmacs
+{
+    namespace static_map_internal
+    {
+        constexpr uint64_t mix(uint64_t hash) noexcept // splitmix64 finalizer
+        {
+            hash = (hash ^ (hash >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            hash = (hash ^ (hash >> 27)) * 0x94D049BB133111EBULL;
+            return hash ^ (hash >> 31);
+        }
+
+        template <typename Key> constexpr uint64_t hash(const Key& key) noexcept
+        {
+            if constexpr (std::is_integral_v<Key> || std::is_enum_v<Key>) {
+                return mix(static_cast<uint64_t>(key));
+            }
+            else {
+                static_assert(std::is_convertible_v<const Key&, std::string_view>, "acmacs::static_map: unsupported key type");
+                uint64_t result = 0xCBF29CE484222325ULL; // FNV-1a
+                for (const char cc : std::string_view{key})
+                    result = (result ^ static_cast<uint8_t>(cc)) * 0x100000001B3ULL;
+                return mix(result);
+            }
+        }
+
+    } // namespace static_map_internal
+
+    // ----------------------------------------------------------------------
+
+    template <typename Key, typename Value, size_t N> class static_map
+    {
+      public:
+        using key_type = std::remove_const_t<Key>;
+        using entry_type = std::pair<Key, Value>;
+
+        static_assert(N > 0 && N < 0xFFFF, "acmacs::static_map: unsupported number of entries");
+
+        constexpr static_map(const std::array<entry_type, N>& entries) : entries_{entries}
+        {
+            std::array<uint64_t, N> hashes{};
+            std::array<uint16_t, number_of_buckets + 1> bucket_start{};
+            for (size_t entry_no = 0; entry_no < N; ++entry_no) {
+                hashes[entry_no] = static_map_internal::hash(key_type{entries_[entry_no].first});
+                ++bucket_start[bucket(hashes[entry_no]) + 1];
+            }
+            for (size_t bucket_no = 0; bucket_no < number_of_buckets; ++bucket_no)
+                bucket_start[bucket_no + 1] = static_cast<uint16_t>(bucket_start[bucket_no + 1] + bucket_start[bucket_no]);
+
+            // entry numbers grouped by bucket (counting sort)
+            std::array<uint16_t, N> bucket_entries{};
+            auto bucket_fill = bucket_start;
+            for (size_t entry_no = 0; entry_no < N; ++entry_no)
+                bucket_entries[bucket_fill[bucket(hashes[entry_no])]++] = static_cast<uint16_t>(entry_no);
+
+            // place largest buckets first, while most slots are free
+            std::array<uint16_t, number_of_buckets> bucket_order{};
+            for (size_t bucket_no = 0; bucket_no < number_of_buckets; ++bucket_no)
+                bucket_order[bucket_no] = static_cast<uint16_t>(bucket_no);
+            std::sort(std::begin(bucket_order), std::end(bucket_order),
+                      [&bucket_start](auto b1, auto b2) { return (bucket_start[b1 + 1] - bucket_start[b1]) > (bucket_start[b2 + 1] - bucket_start[b2]); });
+
+            slots_.fill(empty_slot);
+            for (const auto bucket_no : bucket_order) {
+                const auto first = bucket_start[bucket_no], last = bucket_start[bucket_no + 1];
+                if (first == last)
+                    break;
+                for (auto e1 = first; e1 < last; ++e1) {
+                    for (auto e2 = static_cast<uint16_t>(e1 + 1); e2 < last; ++e2) {
+                        if (hashes[bucket_entries[e1]] == hashes[bucket_entries[e2]])
+                            throw std::invalid_argument{"acmacs::static_map: duplicating keys or hash collision"};
+                    }
+                }
+                for (uint32_t displacement = 0;; ++displacement) {
+                    if (displacement > max_displacement)
+                        throw std::invalid_argument{"acmacs::static_map: cannot find displacement"};
+                    bool placed = true;
+                    for (auto en = first; placed && en < last; ++en) {
+                        const auto slot_no = slot(hashes[bucket_entries[en]], displacement);
+                        placed = slots_[slot_no] == empty_slot;
+                        for (auto prev = first; placed && prev < en; ++prev) // keys of the same bucket must not collide
+                            placed = slot(hashes[bucket_entries[prev]], displacement) != slot_no;
+                    }
+                    if (placed) {
+                        displacements_[bucket_no] = displacement;
+                        for (auto en = first; en < last; ++en)
+                            slots_[slot(hashes[bucket_entries[en]], displacement)] = bucket_entries[en];
+                        break;
+                    }
+                }
+            }
+        }
+
+        constexpr const Value* find(const key_type& key) const noexcept
+        {
+            const auto hash = static_map_internal::hash(key);
+            if (const auto entry_no = slots_[slot(hash, displacements_[bucket(hash)])]; entry_no != empty_slot && entries_[entry_no].first == key)
+                return &entries_[entry_no].second;
+            else
+                return nullptr;
+        }
+
+        constexpr bool contains(const key_type& key) const noexcept { return find(key) != nullptr; }
+
+        constexpr Value get_or(const key_type& key, const Value& dflt) const noexcept
+        {
+            if (const auto* found = find(key); found)
+                return *found;
+            else
+                return dflt;
+        }
+
+        // entries in the original order
+        constexpr size_t size() const noexcept { return N; }
+        constexpr auto begin() const noexcept { return entries_.begin(); }
+        constexpr auto end() const noexcept { return entries_.end(); }
+
+      private:
+        static constexpr size_t number_of_slots = std::bit_ceil(N + N / 4);      // load factor at most 0.8
+        static constexpr size_t number_of_buckets = N < 4 ? size_t{1} : N / 4; // 4 keys in a bucket on average
+        static constexpr uint16_t empty_slot = 0xFFFF;
+        static constexpr uint32_t max_displacement = 1'000'000;
+
+        std::array<entry_type, N> entries_;
+        std::array<uint16_t, number_of_slots> slots_{};
+        std::array<uint32_t, number_of_buckets> displacements_{};
+
+        static constexpr size_t bucket(uint64_t hash) noexcept { return static_cast<size_t>((hash >> 32) % number_of_buckets); }
+        static constexpr size_t slot(uint64_t hash, uint32_t displacement) noexcept
+        {
+            return static_cast<size_t>(static_map_internal::mix(hash + displacement * 0x9E3779B97F4A7C15ULL) & (number_of_slots - 1));
+        }
+
+    }; // class static_map<Key, Value, N>
+
+    template <typename Key, typename Value, size_t N> static_map(const std::array<std::pair<Key, Value>, N>&) -> static_map<Key, Value, N>;
+
+} // namespace acmacs
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
@@ -1,6 +1,20 @@
+#ifdef NDEBUG
+#undef NDEBUG
+#endif
+
+#include <cassert>
+
 #include "acmacs-base/brotli.hh"
 #include "acmacs-base/argv.hh"
 #include "acmacs-base/read-file.hh"
+#include "acmacs-base/timeit.hh"
+#include "../test/file-test.hh"
+
+// ----------------------------------------------------------------------
+
+// without arguments: checks of brotli_encoder and brotli_decoder
+// with source: compresses or decompresses it and reports the ratio, then compares per-record compression and decompression
+// (records of --record-size bytes) using a new instance for every record and reusing one encoder and decoder
 
 using namespace acmacs::argv;
 
@@ -8,10 +22,15 @@ struct Options : public argv
 {
     Options(int a_argc, const char* const a_argv[], on_error on_err = on_error::exit) : argv() { parse(a_argc, a_argv, on_err); }
 
-    argument<str> source{*this, arg_name{"source"}, mandatory};
-    argument<str> output{*this, arg_name{"output"}, dflt{""}};
+    option<size_t> record_size{*this, 'r', "record-size", dflt{4096ul}};
+    option<int> quality{*this, 'q', "quality", dflt{5}};
+
+    argument<str> source{*this, arg_name{"source"}, dflt{""}};
 };
 
+static void check();
+static void benchmark(std::string_view data, size_t record_size, int quality);
+
 // ----------------------------------------------------------------------
 
 int main(int argc, const char* const argv[])
@@ -19,18 +38,25 @@ int main(int argc, const char* const argv[])
     int exit_code = 0;
     try {
         Options opt(argc, argv);
-        acmacs::file::read_access raw_data(opt.source);
-        const auto data = raw_data.raw();
-        fmt::print(stderr, ">>>> {} -> {}\n", opt.source, data.size());
-        if (acmacs::file::brotli_compressed(data)) {
-            fmt::print(stderr, ">>>> decompressing\n");
-            const std::string decompressed = acmacs::file::brotli_decompress(data);
-            fmt::print(stderr, ">>>> decompressed: {} ratio: {:.4f}\n", decompressed.size(), static_cast<double>(data.size()) / static_cast<double>(decompressed.size()));
+        if (opt.source->empty()) {
+            check();
         }
         else {
-            fmt::print(stderr, ">>>> compressing\n");
-            const std::string compressed = acmacs::file::brotli_compress(data);
-            fmt::print(stderr, ">>>> compressed: {} ratio: {:.4f}\n", compressed.size(), static_cast<double>(compressed.size()) / static_cast<double>(data.size()));
+            acmacs::file::read_access raw_data(opt.source);
+            const auto data = raw_data.raw();
+            fmt::print(stderr, ">>>> {} -> {}\n", opt.source, data.size());
+            if (acmacs::file::brotli_compressed(data)) {
+                fmt::print(stderr, ">>>> decompressing\n");
+                const std::string decompressed = acmacs::file::brotli_decompress(data);
+                fmt::print(stderr, ">>>> decompressed: {} ratio: {:.4f}\n", decompressed.size(), static_cast<double>(data.size()) / static_cast<double>(decompressed.size()));
+                benchmark(decompressed, opt.record_size, opt.quality);
+            }
+            else {
+                fmt::print(stderr, ">>>> compressing\n");
+                const std::string compressed = acmacs::file::brotli_compress(data);
+                fmt::print(stderr, ">>>> compressed: {} ratio: {:.4f}\n", compressed.size(), static_cast<double>(compressed.size()) / static_cast<double>(data.size()));
+                benchmark(data, opt.record_size, opt.quality);
+            }
         }
     }
     catch (std::exception& err) {
@@ -41,3 +67,153 @@ int main(int argc, const char* const argv[])
 }
 
 // ----------------------------------------------------------------------
+
+template <typename Exc, typename F> static bool throws(F&& func)
+{
+    try {
+        func();
+    }
+    catch (Exc&) {
+        return true;
+    }
+    return false;
+}
+
+void check()
+{
+    using namespace acmacs::file;
+
+    const auto source = test::make_source(3 * 1024 * 1024 + 101, 0);
+
+    // whole stream for different qualities
+    for (const int quality : {0, 1, 5, 11}) {
+        brotli_encoder encoder{quality};
+        const auto input = quality == 11 ? std::string_view{source}.substr(0, 100000) : std::string_view{source};
+        const auto compressed = encoder.compress(input);
+        assert(compressed.size() < input.size() / 2);
+        assert(brotli_decompress(compressed) == input);
+        assert(brotli_compressed(compressed));
+    }
+
+    // chunked: pieces of various sizes, flush makes everything pushed so far decodable
+    {
+        brotli_encoder encoder{compression_policy{.speed = compression_speed::fastest}};
+        brotli_decoder decoder;
+        std::string compressed, decompressed;
+        size_t offset = 0;
+        for (const size_t piece : {size_t{1}, size_t{7}, size_t{1000}, size_t{65536}, size_t{1024 * 1024}, size_t{3}}) {
+            encoder.push(std::string_view{source}.substr(offset, piece), compressed);
+            offset += piece;
+        }
+        encoder.flush(compressed);
+        assert(!decoder.push(compressed, decompressed));
+        assert(decompressed == std::string_view{source}.substr(0, offset));
+        const auto flushed = compressed.size();
+        encoder.push(std::string_view{source}.substr(offset), compressed);
+        encoder.finish(compressed);
+        assert(decoder.push(std::string_view{compressed}.substr(flushed), decompressed));
+        assert(decompressed == source);
+        decoder.finish(); // stream is complete
+    }
+
+    // encoder and decoder state reuse: consecutive streams are independent, decoder input is pushed in small pieces
+    {
+        brotli_encoder encoder{5};
+        brotli_decoder decoder;
+        for (size_t stream_no = 0; stream_no < 4; ++stream_no) {
+            const auto input = test::make_source(stream_no == 2 ? 0 : 10000 * (stream_no + 1), stream_no);
+            std::string compressed;
+            encoder.size_hint(input.size());
+            for (size_t offset = 0; offset < input.size(); offset += 3000)
+                encoder.push(std::string_view{input}.substr(offset, 3000), compressed);
+            encoder.finish(compressed);
+            assert(brotli_decompress(compressed) == input);
+
+            std::string decompressed;
+            bool finished = false;
+            for (size_t offset = 0; offset < compressed.size(); offset += 17) {
+                assert(!finished);
+                finished = decoder.push(std::string_view{compressed}.substr(offset, 17), decompressed);
+            }
+            assert(finished);
+            assert(decompressed == input);
+            assert(decoder.decompress(encoder.compress(input)) == input);
+        }
+    }
+
+    // moved encoder and decoder continue the stream, moved-from ones remain usable
+    {
+        brotli_encoder encoder{1};
+        std::string compressed;
+        encoder.push(std::string_view{source}.substr(0, 5000), compressed);
+        brotli_encoder moved{std::move(encoder)};
+        moved.push(std::string_view{source}.substr(5000, 5000), compressed);
+        moved.finish(compressed);
+        assert(brotli_decompress(compressed) == std::string_view{source}.substr(0, 10000));
+        assert(brotli_decompress(encoder.compress("reused")) == "reused");
+
+        brotli_decoder decoder;
+        std::string decompressed;
+        assert(!decoder.push(std::string_view{compressed}.substr(0, 10), decompressed));
+        brotli_decoder moved_decoder;
+        moved_decoder = std::move(decoder);
+        assert(moved_decoder.push(std::string_view{compressed}.substr(10), decompressed));
+        assert(decompressed == std::string_view{source}.substr(0, 10000));
+        assert(decoder.decompress(moved.compress("reused")) == "reused");
+    }
+
+    // errors
+    {
+        const auto compressed = brotli_encoder{5}.compress(std::string_view{source}.substr(0, 100000));
+        brotli_decoder decoder;
+        std::string output;
+        assert(throws<BrotliError>([&] { decoder.decompress(std::string_view{compressed}.substr(0, compressed.size() / 2), output); }));
+        assert(!decoder.push(std::string_view{compressed}.substr(0, compressed.size() / 2), output));
+        assert(throws<BrotliError>([&] { decoder.finish(); }));
+        assert(throws<BrotliError>([&] { decoder.decompress(compressed + "trailing", output); }));
+        assert(throws<BrotliError>([&] { decoder.decompress(std::string(1000, '\xFF'), output); }));
+        assert(decoder.decompress(compressed) == std::string_view{source}.substr(0, 100000)); // usable after errors
+    }
+}
+
+// ----------------------------------------------------------------------
+
+void benchmark(std::string_view data, size_t record_size, int quality)
+{
+    using namespace acmacs::file;
+
+    std::vector<std::string_view> records;
+    for (size_t offset = 0; offset < data.size(); offset += record_size)
+        records.push_back(data.substr(offset, record_size));
+    std::vector<std::string> compressed(records.size());
+    std::string decompressed;
+
+    const auto new_instance_start = acmacs::timestamp();
+    for (size_t record_no = 0; record_no < records.size(); ++record_no)
+        compressed[record_no] = brotli_compress(records[record_no], compression_policy{.level = quality});
+    const auto new_instance_compress = acmacs::elapsed_seconds(new_instance_start);
+    const auto new_instance_decompress_start = acmacs::timestamp();
+    for (const auto& record : compressed)
+        brotli_decompress(record, decompressed);
+    const auto new_instance_decompress = acmacs::elapsed_seconds(new_instance_decompress_start);
+
+    brotli_encoder encoder{quality};
+    const auto reuse_start = acmacs::timestamp();
+    for (size_t record_no = 0; record_no < records.size(); ++record_no)
+        encoder.compress(records[record_no], compressed[record_no]);
+    const auto reuse_compress = acmacs::elapsed_seconds(reuse_start);
+    brotli_decoder decoder;
+    const auto reuse_decompress_start = acmacs::timestamp();
+    for (const auto& record : compressed)
+        decoder.decompress(record, decompressed);
+    const auto reuse_decompress = acmacs::elapsed_seconds(reuse_decompress_start);
+
+    fmt::print(stderr, ">>>> {} records of {} bytes, quality {}\n", records.size(), record_size, quality);
+    fmt::print(stderr, "     new instance per record: compress {:.3f}s decompress {:.3f}s\n", new_instance_compress, new_instance_decompress);
+    fmt::print(stderr, "     reused encoder/decoder:  compress {:.3f}s decompress {:.3f}s\n", reuse_compress, reuse_decompress);
+}
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
@@ -0,0 +1,121 @@
+#ifdef NDEBUG
+#undef NDEBUG
+#endif
+
+#include <cassert>
+
+#include "acmacs-base/bzip2.hh"
+#include "acmacs-base/argv.hh"
+#include "acmacs-base/timeit.hh"
+#include "acmacs-base/read-file.hh"
+#include "acmacs-base/file-writer.hh"
+#include "../test/file-test.hh"
+
+// ----------------------------------------------------------------------
+
+// without arguments: round trips of multi-stream (parallel) and single stream (writer) data
+// with source: compresses or decompresses it and reports time and ratio
+
+using namespace acmacs::argv;
+
+struct Options : public argv
+{
+    Options(int a_argc, const char* const a_argv[], on_error on_err = on_error::exit) : argv() { parse(a_argc, a_argv, on_err); }
+
+    option<size_t> threads{*this, 't', "threads", dflt{0UL}, desc{"0 - use all cpus"}};
+
+    argument<str> source{*this, arg_name{"source"}, dflt{""}};
+};
+
+static void check();
+
+// ----------------------------------------------------------------------
+
+int main(int argc, const char* const argv[])
+{
+    int exit_code = 0;
+    try {
+        Options opt(argc, argv);
+        if (opt.source->empty()) {
+            check();
+            return exit_code;
+        }
+        const auto threads = static_cast<uint32_t>(*opt.threads);
+        acmacs::file::read_access raw_data(opt.source);
+        const auto data = raw_data.raw();
+        fmt::print(stderr, ">>>> {} -> {}\n", opt.source, data.size());
+        if (data.size() > 3 && acmacs::file::bz2_compressed(data.data())) {
+            fmt::print(stderr, ">>>> decompressing\n");
+            Timeit ti{">>>> decompression"};
+            const std::string decompressed = acmacs::file::bz2_decompress(data, threads);
+            ti.report();
+            fmt::print(stderr, ">>>> decompressed: {} ratio: {:.4f}\n", decompressed.size(), static_cast<double>(data.size()) / static_cast<double>(decompressed.size()));
+        }
+        else {
+            fmt::print(stderr, ">>>> compressing\n");
+            Timeit ti{">>>> compression"};
+            const std::string compressed = acmacs::file::bz2_compress(data, acmacs::file::compression_policy{.threads = threads});
+            ti.report();
+            fmt::print(stderr, ">>>> compressed: {} ratio: {:.4f}\n", compressed.size(), static_cast<double>(compressed.size()) / static_cast<double>(data.size()));
+            if (acmacs::file::bz2_decompress(compressed, threads) != data)
+                throw std::runtime_error("round trip failed");
+        }
+    }
+    catch (std::exception& err) {
+        fmt::print(stderr, "> ERROR {}\n", err);
+        exit_code = 1;
+    }
+    return exit_code;
+}
+
+// ----------------------------------------------------------------------
+
+void check()
+{
+    using namespace acmacs::file;
+
+    const auto source = test::make_source(3 * 1024 * 1024 + 101, 2);
+
+    // pbzip2 style: one stream per block of 100k (fastest), output does not depend on the number of threads
+    const auto compressed = bz2_compress(source, compression_policy{.speed = compression_speed::fastest, .threads = 1});
+    assert(bz2_compressed(compressed.data()));
+    assert(bz2_compress(source, compression_policy{.speed = compression_speed::fastest, .threads = 4}) == compressed);
+    for (const uint32_t threads : {1u, 4u})
+        assert(bz2_decompress(compressed, threads) == source);
+
+    // input not larger than one block is a single stream
+    const auto small = std::string_view{source}.substr(0, 100000);
+    assert(bz2_decompress(bz2_compress(small, compression_policy{.speed = compression_speed::fastest}), 4) == small);
+    assert(bz2_decompress(bz2_compress("", compression_policy{}), 4).empty());
+
+    // trailing garbage after the last stream is ignored, the last stream found by the parallel decoder does not end at the end of input
+    // and serial decompression is used
+    const auto with_garbage = compressed + "trailing garbage";
+    for (const uint32_t threads : {1u, 4u})
+        assert(bz2_decompress(with_garbage, threads) == source);
+
+    // output of writer is a single stream, concatenated files are decompressed by streams
+    const test::temp_directory dir{"bzip2"};
+    const auto filename = dir / "data.bz2";
+    writer{filename.native(), force_compression::no, backup_file::no} << source;
+    const auto written = static_cast<std::string>(read_access{filename.native()}.raw());
+    for (const uint32_t threads : {1u, 4u}) {
+        assert(bz2_decompress(written, threads) == source);
+        assert(bz2_decompress(written + compressed, threads) == source + source);
+    }
+
+    // truncated input is reported
+    bool thrown = false;
+    try {
+        bz2_decompress(std::string_view{compressed}.substr(0, compressed.size() / 2), 4);
+    }
+    catch (std::exception&) {
+        thrown = true;
+    }
+    assert(thrown);
+}
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
@@ -0,0 +1,79 @@
+#include "acmacs-base/argv.hh"
+#include "acmacs-base/timeit.hh"
+#include "acmacs-base/read-file.hh"
+#include "acmacs-base/gzip.hh"
+#include "acmacs-base/xz.hh"
+#include "acmacs-base/brotli.hh"
+#include "acmacs-base/bzip2.hh"
+#include "acmacs-base/zstd.hh"
+
+// compares speed and ratio of the supported codecs and compression policies on the given (uncompressed or compressed) file
+
+using namespace acmacs::argv;
+
+struct Options : public argv
+{
+    Options(int a_argc, const char* const a_argv[], on_error on_err = on_error::exit) : argv() { parse(a_argc, a_argv, on_err); }
+
+    option<str_array> policies{*this, 'p', "policy", desc{"fastest, balanced, best or level[:threads], can be used multiple times, default: fastest, balanced and best"}};
+    option<size_t> threads{*this, 't', "threads", dflt{0UL}, desc{"0 - use all cpus, for policies without :threads"}};
+
+    argument<str> source{*this, arg_name{"source"}, mandatory};
+};
+
+struct codec_t
+{
+    std::string_view name;
+    std::string (*compress)(std::string_view input, const acmacs::file::compression_policy& policy);
+    std::string (*decompress)(std::string_view input);
+};
+
+// ----------------------------------------------------------------------
+
+int main(int argc, const char* const argv[])
+{
+    int exit_code = 0;
+    try {
+        Options opt(argc, argv);
+        const std::string data = acmacs::file::read(opt.source);
+
+        std::vector<std::string_view> policy_names{"fastest", "balanced", "best"};
+        if (!opt.policies->empty())
+            policy_names = *opt.policies;
+
+        const codec_t codecs[] = {
+            {"gzip", [](std::string_view input, const acmacs::file::compression_policy& policy) { return acmacs::file::gzip_compress(input, policy); }, [](std::string_view input) { return acmacs::file::gzip_decompress(input); }},
+            {"xz", [](std::string_view input, const acmacs::file::compression_policy& policy) { return acmacs::file::xz_compress(input, policy); }, [](std::string_view input) { return acmacs::file::xz_decompress(input); }},
+            {"brotli", [](std::string_view input, const acmacs::file::compression_policy& policy) { return acmacs::file::brotli_compress(input, policy); }, [](std::string_view input) { return acmacs::file::brotli_decompress(input); }},
+            {"bz2", [](std::string_view input, const acmacs::file::compression_policy& policy) { return acmacs::file::bz2_compress(input, policy); }, [](std::string_view input) { return acmacs::file::bz2_decompress(input); }},
+            {"zstd", [](std::string_view input, const acmacs::file::compression_policy& policy) { return acmacs::file::zstd_compress(input, policy); }, [](std::string_view input) { return acmacs::file::zstd_decompress(input); }},
+        };
+
+        fmt::print("{}: {} bytes\n", opt.source, data.size());
+        fmt::print("{:<8s} {:<10s} {:>12s} {:>7s} {:>10s} {:>10s}\n", "codec", "policy", "compressed", "ratio", "compress", "decompress");
+        for (const auto& codec : codecs) {
+            for (const auto policy_name : policy_names) {
+                auto policy = acmacs::file::parse_compression_policy(policy_name);
+                if (policy_name.find(':') == std::string_view::npos)
+                    policy.threads = static_cast<uint32_t>(*opt.threads);
+                const auto compress_start = acmacs::timestamp();
+                const auto compressed = codec.compress(data, policy);
+                const auto compress_time = acmacs::elapsed_seconds(compress_start);
+                const auto decompress_start = acmacs::timestamp();
+                const auto decompressed = codec.decompress(compressed);
+                const auto decompress_time = acmacs::elapsed_seconds(decompress_start);
+                if (decompressed != data)
+                    throw std::runtime_error{fmt::format("{} {}: decompressed data differs from the source", codec.name, policy_name)};
+                fmt::print("{:<8s} {:<10s} {:>12d} {:>7.4f} {:>9.3f}s {:>9.3f}s\n", codec.name, policy_name, compressed.size(),
+                           static_cast<double>(compressed.size()) / static_cast<double>(data.size()), compress_time, decompress_time);
+            }
+        }
+    }
+    catch (std::exception& err) {
+        fmt::print(stderr, "> ERROR {}\n", err);
+        exit_code = 1;
+    }
+    return exit_code;
+}
+
+// ----------------------------------------------------------------------
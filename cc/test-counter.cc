@@ -0,0 +1,205 @@
+#ifdef NDEBUG
+#undef NDEBUG
+#endif
+
+#include <cassert>
+#include <random>
+
+#include "acmacs-base/counter.hh"
+#include "acmacs-base/log.hh"
+
+// ----------------------------------------------------------------------
+
+// Counter is compared with std::map: keys in random order, string keys counted via string_view, merge(), parallel(),
+// sorted_by_key(), entries() and references returned by const methods while counting continues
+
+template <typename Key> static bool same(const acmacs::Counter<Key>& counter, const std::map<Key, size_t>& expected)
+{
+    const auto entries = counter.sorted_by_key();
+    return counter.size() == expected.size() && std::equal(entries.begin(), entries.end(), expected.begin(), expected.end(), [](const auto& e1, const auto& e2) { return e1.first == e2.first && e1.second == e2.second; });
+}
+
+static std::vector<std::string> make_words(size_t count, size_t range, size_t seed)
+{
+    std::mt19937 generator{static_cast<std::mt19937::result_type>(seed)};
+    std::vector<std::string> words(count);
+    for (auto& word : words)
+        word = fmt::format("A/PERTH/{}/2009", generator() % range);
+    return words;
+}
+
+// ----------------------------------------------------------------------
+
+// CounterCharSome: direct loop for short data, byte_histogram() for long data (in several threads for large data),
+// chars outside of [first_char, last_char) are ignored in both cases
+template <size_t first_char, size_t last_char> static void check_counter_char(const std::string& data, size_t threads)
+{
+    using counter_t = acmacs::CounterCharSome<first_char, last_char, uint32_t>;
+    std::array<uint32_t, 256> expected{};
+    for (const char ch : data)
+        ++expected[static_cast<unsigned char>(ch)];
+
+    const auto check = [&expected](const counter_t& counter, uint32_t factor) {
+        for (size_t byte = first_char; byte < last_char; ++byte)
+            assert(counter.counter()[byte - first_char] == expected[byte] * factor);
+    };
+
+    counter_t counter;
+    counter.count(data, threads);
+    check(counter, 1);
+    counter.count(std::begin(data), std::end(data)); // contiguous iterators
+    check(counter, 2);
+    const std::vector<char> vec(std::begin(data), std::end(data));
+    counter.update(counter_t{vec});
+    check(counter, 3);
+}
+
+// ----------------------------------------------------------------------
+
+int main(int /*argc*/, const char* /*argv*/[])
+{
+    int exit_code = 0;
+    try {
+        // string keys counted by string_view, sorted_by_key() is a sorted copy, counting continues after it
+        {
+            const auto words = make_words(5000, 700, 1);
+            acmacs::Counter<std::string> counter;
+            std::map<std::string, size_t> expected;
+            for (size_t no = 0; no < words.size(); ++no) {
+                counter.count(std::string_view{words[no]});
+                ++expected[words[no]];
+                if (no % 500 == 0)
+                    assert(same(counter, expected));
+            }
+            assert(same(counter, expected));
+            assert(counter.total() == words.size());
+            for (const auto& [word, num] : expected) {
+                assert(counter[std::string_view{word}] == num);
+                assert(counter[word] == num);
+            }
+            assert(counter["A/PERTH/700/2009"] == 0);
+
+            // entries() is not copied, in the order of first occurrence
+            assert(&counter.entries() == &counter.entries());
+            assert(counter.entries().size() == expected.size());
+            std::vector<std::string> first_occurrence;
+            for (const auto& word : words) {
+                if (std::find(first_occurrence.begin(), first_occurrence.end(), word) == first_occurrence.end())
+                    first_occurrence.push_back(word);
+            }
+            assert(std::equal(counter.entries().begin(), counter.entries().end(), first_occurrence.begin(), first_occurrence.end(), [](const auto& entry, const auto& word) { return entry.first == word; }));
+
+            const auto& max = counter.max();
+            const auto max_count = max.second;
+            const auto max_key = max.first;
+            const auto& min_value = counter.min_value();
+            assert(min_value.first == expected.begin()->first);
+            const auto top = counter.sorted_max_first(10);
+            assert(top.size() == 10 && top.front()->second == max_count);
+            const auto top_key = top.front()->first;
+            assert(std::is_sorted(top.begin(), top.end(), [](const auto* e1, const auto* e2) { return e1->second > e2->second; }));
+            counter.sorted_by_key();
+            counter.report();
+            assert(max.first == max_key && max.second == max_count); // const methods do not move entries
+            assert(min_value.first == expected.begin()->first);
+            assert(top.front()->first == top_key && top.front()->second == max_count);
+
+            std::vector<std::thread> readers; // concurrent const use
+            std::vector<int> read_ok(4, 0);
+            for (size_t thread_no = 0; thread_no < read_ok.size(); ++thread_no)
+                readers.emplace_back([&, thread_no]() { read_ok[thread_no] = same(counter, expected) && counter.report() == counter.report(); });
+            for (auto& reader : readers)
+                reader.join();
+            assert(std::all_of(read_ok.begin(), read_ok.end(), [](int ok) { return ok != 0; }));
+
+            counter.count(std::string{"A/PERTH/16/2009"}, 5);
+            expected["A/PERTH/16/2009"] += 5;
+            counter.count_if(false, "ignored");
+            assert(same(counter, expected));
+        }
+
+        // merge
+        {
+            const auto words1 = make_words(3000, 400, 2), words2 = make_words(2000, 800, 3);
+            acmacs::Counter<std::string> counter1, counter2, empty;
+            std::map<std::string, size_t> expected;
+            for (const auto& word : words1) {
+                counter1.count(word);
+                ++expected[word];
+            }
+            for (const auto& word : words2) {
+                counter2.count(word);
+                ++expected[word];
+            }
+            counter1.merge(counter2);
+            assert(same(counter1, expected));
+            empty.merge(counter1);
+            assert(same(empty, expected));
+            counter1.merge(acmacs::Counter<std::string>{});
+            assert(same(counter1, expected));
+        }
+
+        // parallel counting is the same as sequential, integer keys
+        {
+            std::mt19937 generator{4};
+            std::vector<int> source(100000);
+            for (auto& val : source)
+                val = static_cast<int>(generator() % 1000) - 500;
+            std::map<int, size_t> expected;
+            for (const auto val : source)
+                ++expected[val / 3];
+            for (const size_t threads : {1ul, 2ul, 3ul, 0ul}) {
+                const auto counter = acmacs::Counter<int>::parallel(source, [](int val) { return val / 3; }, threads);
+                assert(same(counter, expected));
+            }
+            const auto sequential = acmacs::Counter(source, [](int val) { return val / 3; });
+            assert(same(sequential, expected));
+
+            bool thrown = false;
+            try {
+                acmacs::Counter<int>::parallel(source, [](int val) { if (val == 7) throw std::runtime_error{"seven"}; return val; }, 2);
+            }
+            catch (std::runtime_error&) {
+                thrown = true;
+            }
+            assert(thrown);
+        }
+
+        // CounterCharSome, data shorter and longer than direct_count_max, all byte values including ones below and above the range
+        {
+            std::mt19937 generator{5};
+            for (const size_t size : {0ul, 1ul, 100ul, 4096ul, 4097ul, 100000ul, 9ul * 1024 * 1024}) {
+                std::string data(size, '-');
+                for (size_t pos = 0; pos < size; pos += 1 + generator() % 8) // runs of the same char
+                    data[pos] = static_cast<char>(generator() % 256);
+                check_counter_char<0, 256>(data, 1);
+                check_counter_char<'A', 'Z' + 1>(data, 1);
+                check_counter_char<'-', '~'>(data, 3); // several threads for data larger than 8Mb
+            }
+        }
+
+        // formatting, string keys are quoted
+        {
+            acmacs::Counter<std::string> strings;
+            strings.count("b");
+            strings.count("a");
+            strings.count("b");
+            assert(fmt::format("{}", strings) == R"(counter{{"a": 1, "b": 2}})");
+            acmacs::Counter<int> ints;
+            ints.count(2);
+            ints.count(1);
+            assert(fmt::format("{}", ints) == "counter{{1: 1, 2: 1}}");
+            assert(fmt::format("{}", acmacs::Counter<std::string>{}) == "counter{{}}");
+        }
+    }
+    catch (std::exception& err) {
+        AD_ERROR("{}", err);
+        exit_code = 1;
+    }
+    return exit_code;
+}
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
@@ -0,0 +1,129 @@
+#ifdef NDEBUG
+#undef NDEBUG
+#endif
+
+#include <cassert>
+
+#include "acmacs-base/filesystem.hh"
+#include "acmacs-base/fmt.hh"
+#include "acmacs-base/log.hh"
+#include "acmacs-base/decompress-cache.hh"
+#include "acmacs-base/read-file.hh"
+#include "../test/file-test.hh"
+
+// ----------------------------------------------------------------------
+
+static std::string compressed(size_t no) { return fmt::format("{:0>{}}", no, 300 * 1024); } // cacheable key
+static std::string decompressed(size_t no) { return std::string(1024 * 1024, static_cast<char>('A' + no % 26)); }
+
+static size_t directory_size(const fs::path& directory)
+{
+    size_t total = 0;
+    for (const auto& entry : fs::recursive_directory_iterator(directory)) {
+        if (entry.is_regular_file())
+            total += static_cast<size_t>(entry.file_size());
+    }
+    return total;
+}
+
+// ----------------------------------------------------------------------
+
+int main(int /*argc*/, const char* /*argv*/[])
+{
+    namespace cache = acmacs::file::decompress_cache;
+
+    int exit_code = 0;
+    const acmacs::file::test::temp_directory dir{"decompress-cache"};
+
+    try {
+        std::string output;
+
+        // disabled cache stores nothing
+        cache::disable();
+        cache::put(compressed(0), decompressed(0));
+        assert(!cache::get(compressed(0), output));
+        assert(cache::statistics().stored == 0);
+
+        constexpr size_t max_size = 8 * 1024 * 1024;
+        cache::enable(dir.path().native(), max_size);
+        assert(cache::enabled());
+
+        // small input is not cached
+        cache::put("short", decompressed(0));
+        assert(!cache::get("short", output));
+        assert(cache::statistics().stored == 0);
+
+        // directory is walked once on the first put, then only when the estimate exceeds the limit
+        for (size_t no = 0; no < 6; ++no)
+            cache::put(compressed(no), decompressed(no));
+        assert(cache::statistics().stored == 6);
+        assert(cache::statistics().scans == 1);
+        assert(cache::statistics().evicted == 0);
+        for (size_t no = 0; no < 6; ++no) {
+            assert(cache::get(compressed(no), output));
+            assert(output == decompressed(no));
+        }
+        assert(cache::statistics().hits == 6);
+        assert(!cache::get(compressed(100), output));
+        assert(cache::statistics().misses > 0);
+
+        // least recently used entries are evicted, entry 0 is used and survives
+        assert(cache::get(compressed(0), output));
+        for (size_t no = 6; no < 12; ++no)
+            cache::put(compressed(no), decompressed(no));
+        const auto stat = cache::statistics();
+        assert(stat.stored == 12);
+        assert(stat.evicted > 0);
+        assert(stat.scans < stat.stored);
+        assert(directory_size(dir) <= max_size);
+        assert(cache::get(compressed(0), output) && output == decompressed(0));
+        assert(!cache::get(compressed(1), output));
+        assert(cache::get(compressed(11), output) && output == decompressed(11));
+
+        // entries removed by another process are noticed at the next walk, the stale estimate does not cause eviction
+        fs::remove_all(dir);
+        for (size_t no = 20; no < 27; ++no)
+            cache::put(compressed(no), decompressed(no));
+        assert(cache::statistics().evicted == stat.evicted);
+        assert(cache::statistics().scans > stat.scans);
+        for (size_t no = 20; no < 27; ++no)
+            assert(cache::get(compressed(no), output) && output == decompressed(no));
+
+        // walk is repeated after a number of puts even if the estimate is below the limit
+        cache::enable(dir.path().native(), 1024ul * 1024 * 1024);
+        const auto scans = cache::statistics().scans;
+        for (size_t no = 0; no < 40; ++no)
+            cache::put(compressed(no), decompressed(no));
+        assert(cache::statistics().scans == scans + 2);
+
+        // entry larger than the limit is not stored
+        cache::enable(dir.path().native(), 512 * 1024);
+        cache::put(compressed(200), decompressed(200));
+        assert(!cache::get(compressed(200), output));
+
+        // temp files left by killed writers are removed at the next walk after a grace period, the ones being written are kept
+        const auto stale_temp = dir / "ab" / ".stale.XXXXXX", fresh_temp = dir / "ab" / ".fresh.XXXXXX";
+        fs::create_directories(stale_temp.parent_path());
+        for (const auto& temp : {stale_temp, fresh_temp})
+            acmacs::file::write(temp.native(), decompressed(0), acmacs::file::force_compression::no, acmacs::file::backup_file::no);
+        fs::last_write_time(stale_temp, fs::file_time_type::clock::now() - std::chrono::hours{2});
+        cache::enable(dir.path().native(), 1024ul * 1024 * 1024);
+        cache::put(compressed(300), decompressed(300));
+        assert(!fs::exists(stale_temp));
+        assert(fs::exists(fresh_temp));
+
+        cache::disable();
+        assert(!cache::enabled());
+    }
+    catch (std::exception& err) {
+        AD_ERROR("{}", err);
+        exit_code = 1;
+    }
+
+    return exit_code;
+}
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
@@ -0,0 +1,152 @@
+#ifdef NDEBUG
+#undef NDEBUG
+#endif
+
+#include <cassert>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/xattr.h>
+#endif
+
+#include "acmacs-base/read-file.hh"
+#include "acmacs-base/log.hh"
+#include "../test/file-test.hh"
+
+// ----------------------------------------------------------------------
+
+// acmacs::file::write with backup: version numbering of backups, existing file replaced by rename with the old one hard linked
+// into .backup, files hard linked elsewhere and symlinks are overwritten in place
+
+static struct stat stat_of(const fs::path& path)
+{
+    struct stat st;
+    assert(::stat(path.c_str(), &st) == 0);
+    return st;
+}
+
+static std::string content(const fs::path& path) { return static_cast<std::string>(acmacs::file::read(path.native())); }
+
+// backups of <stem><extension> sorted by name, i.e. by date and version
+static std::vector<fs::path> backups(const fs::path& backup_dir, std::string_view stem, std::string_view extension = ".json")
+{
+    std::vector<fs::path> result;
+    for (const auto& entry : fs::directory_iterator(backup_dir)) {
+        if (const auto name = entry.path().filename().string(); name.starts_with(fmt::format("{}.~", stem)) && name.ends_with(fmt::format("~{}", extension)))
+            result.push_back(entry.path());
+    }
+    std::sort(std::begin(result), std::end(result));
+    return result;
+}
+
+// <stem>.~<date>-<NNN>~<extension>
+static std::string version_of(const fs::path& backup)
+{
+    const auto name = backup.filename().string();
+    const auto end = name.rfind('~');
+    return name.substr(end - 3, 3);
+}
+
+// ----------------------------------------------------------------------
+
+int main(int /*argc*/, const char* /*argv*/[])
+{
+    int exit_code = 0;
+    const acmacs::file::test::temp_directory dir{"file-backup"};
+    const auto backup_dir = dir / ".backup";
+
+    try {
+        // new file, nothing to back up
+        const auto filename = dir / "data.json";
+        acmacs::file::write(filename.native(), "1");
+        assert(content(filename) == "1");
+        assert(!fs::exists(backup_dir) || backups(backup_dir, "data").empty());
+
+        // replaced by rename, old file is hard linked into backup dir, mode is kept
+        fs::permissions(filename, fs::perms::owner_read | fs::perms::owner_write | fs::perms::group_read);
+        const auto old_inode = stat_of(filename).st_ino;
+        acmacs::file::write(filename.native(), "2");
+        assert(content(filename) == "2");
+        assert(stat_of(filename).st_ino != old_inode);
+        assert((stat_of(filename).st_mode & 07777) == 0640);
+        auto saved = backups(backup_dir, "data");
+        assert(saved.size() == 1);
+        assert(version_of(saved[0]) == "001");
+        assert(stat_of(saved[0]).st_ino == old_inode);
+        assert(content(saved[0]) == "1");
+
+        // next version is one more than the last existing one, gaps are not filled
+        const auto name = saved[0].filename().string();
+        const auto version_pos = name.rfind('~') - 3;
+        fs::rename(saved[0], backup_dir / (name.substr(0, version_pos) + "005" + name.substr(version_pos + 3)));
+        acmacs::file::write(filename.native(), "3");
+        saved = backups(backup_dir, "data");
+        assert(saved.size() == 2);
+        assert(version_of(saved[0]) == "005");
+        assert(version_of(saved[1]) == "006");
+        assert(content(saved[1]) == "2");
+
+#ifdef __linux__
+        // extended attributes are kept (skipped if the filesystem does not support user attributes)
+        if (setxattr(filename.c_str(), "user.acmacs-test", "kept", 4, 0) == 0) {
+            const auto inode = stat_of(filename).st_ino;
+            acmacs::file::write(filename.native(), "3");
+            assert(stat_of(filename).st_ino != inode);
+            char value[16];
+            assert(getxattr(filename.c_str(), "user.acmacs-test", value, sizeof(value)) == 4 && std::string_view(value, 4) == "kept");
+            assert(backups(backup_dir, "data").size() == 3);
+            fs::remove(backups(backup_dir, "data").back());
+        }
+#endif
+
+        // hard linked elsewhere: written in place, other link sees the new content, backup is a copy
+        const auto other_link = dir / "other-link.json";
+        fs::create_hard_link(filename, other_link);
+        const auto linked_inode = stat_of(filename).st_ino;
+        acmacs::file::write(filename.native(), "4");
+        assert(stat_of(filename).st_ino == linked_inode);
+        assert(content(other_link) == "4");
+        saved = backups(backup_dir, "data");
+        assert(saved.size() == 3);
+        assert(version_of(saved[2]) == "007");
+        assert(content(saved[2]) == "3");
+        assert(stat_of(saved[2]).st_ino != linked_inode);
+
+        // symlink: stays a symlink, target is written in place, backup is named after the symlink
+        const auto target = dir / "target.json";
+        const auto symlink = dir / "symlink.json";
+        acmacs::file::write(target.native(), "5");
+        fs::create_symlink(target.filename(), symlink);
+        acmacs::file::write(symlink.native(), "6");
+        assert(fs::is_symlink(symlink));
+        assert(content(target) == "6");
+        saved = backups(backup_dir, "symlink");
+        assert(saved.size() == 1);
+        assert(content(saved[0]) == "5");
+
+        // compressed file
+        const auto compressed = dir / "data.json.xz";
+        acmacs::file::write(compressed.native(), "7");
+        acmacs::file::write(compressed.native(), "8");
+        assert(content(compressed) == "8");
+        saved = backups(backup_dir, "data", ".json.xz");
+        assert(saved.size() == 1);
+        assert(version_of(saved[0]) == "001");
+        assert(content(saved[0]) == "7");
+
+        // no backup requested: replaced in place, nothing added to backup dir
+        acmacs::file::write(compressed.native(), "9", acmacs::file::force_compression::no, acmacs::file::backup_file::no);
+        assert(content(compressed) == "9");
+        assert(backups(backup_dir, "data", ".json.xz").size() == 1);
+    }
+    catch (std::exception& err) {
+        AD_ERROR("{}", err);
+        exit_code = 1;
+    }
+
+    return exit_code;
+}
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
@@ -0,0 +1,162 @@
+#ifdef NDEBUG
+#undef NDEBUG
+#endif
+
+#include <cassert>
+#include <filesystem>
+#include <sys/stat.h>
+#include <functional>
+
+#include "acmacs-base/file-writer.hh"
+#include "acmacs-base/gzip.hh"
+#include "acmacs-base/xz.hh"
+#include "acmacs-base/bzip2.hh"
+#include "acmacs-base/brotli.hh"
+#include "acmacs-base/zstd.hh"
+#include "acmacs-base/log.hh"
+#include "../test/file-test.hh"
+
+// ----------------------------------------------------------------------
+
+// output of each codec is written through acmacs::file::writer in appends of various sizes (small ones, the ones crossing
+// encoder chunk boundary, the ones larger than a chunk) and read back with acmacs::file::read
+
+static void write(const std::filesystem::path& filename, std::string_view source, const acmacs::file::compression_policy& policy)
+{
+    acmacs::file::writer writer{filename.string(), acmacs::file::force_compression::no, acmacs::file::backup_file::no, policy};
+    size_t offset = 0;
+    for (const size_t piece : {size_t{1}, size_t{100}, size_t{70000}, size_t{3 * 1024 * 1024}, size_t{10}, size_t{1024 * 1024 - 7}, size_t{1024 * 1024 + 13}}) {
+        const auto size = std::min(piece, source.size() - offset);
+        writer << source.substr(offset, size);
+        offset += size;
+    }
+    writer.append(source.substr(offset));
+    writer.close();
+    writer.close(); // no-op
+}
+
+// ----------------------------------------------------------------------
+
+int main(int /*argc*/, const char* /*argv*/[])
+{
+    int exit_code = 0;
+    const acmacs::file::test::temp_directory dir{"file-writer"};
+
+    try {
+        const auto source = acmacs::file::test::make_source(7 * 1024 * 1024 + 333);
+
+        const std::vector<std::pair<const char*, std::function<bool(std::string_view)>>> codecs{
+            {"plain.txt", [](std::string_view raw) { return !acmacs::file::xz_compressed(raw.data()); }},
+            {"data.gz", [](std::string_view raw) { return acmacs::file::gzip_compressed(raw.data()); }},
+            {"data.xz", [](std::string_view raw) { return acmacs::file::xz_compressed(raw.data()); }},
+            {"data.bz2", [](std::string_view raw) { return acmacs::file::bz2_compressed(raw.data()); }},
+            {"data.br", [](std::string_view raw) { return acmacs::file::brotli_compressed(raw); }},
+            {"data.zst", [](std::string_view raw) { return acmacs::file::zstd_compressed(raw.data()); }},
+        };
+
+        for (const auto speed : {acmacs::file::compression_speed::fastest, acmacs::file::compression_speed::balanced}) {
+            const acmacs::file::compression_policy policy{.speed = speed, .threads = 2};
+            for (const auto& [name, compressed] : codecs) {
+                const auto filename = dir / name;
+                write(filename, source, policy);
+                const auto data = acmacs::file::read(filename.string());
+                assert(compressed(data.raw()));
+                if (std::string_view{name} != "plain.txt")
+                    assert(data.raw().size() < source.size() / 2);
+                const std::string read_back = data;
+                assert(read_back == source);
+            }
+        }
+
+        // empty output is a valid stream for each codec
+        for (const auto& [name, compressed] : codecs) {
+            const auto filename = dir / name;
+            acmacs::file::writer{filename.string(), acmacs::file::force_compression::no, acmacs::file::backup_file::no};
+            if (std::string_view{name} == "plain.txt")
+                assert(std::filesystem::file_size(filename) == 0); // read_access cannot map an empty file
+            else if (std::string_view{name} == "data.br")
+                assert(acmacs::file::brotli_decompress(acmacs::file::read(filename.string()).raw()).empty()); // brotli has no signature, streams shorter than 16 bytes are not detected
+            else
+                assert(static_cast<std::string>(acmacs::file::read(filename.string())).empty());
+        }
+
+        // forced compression uses xz
+        {
+            const auto filename = dir / "forced";
+            {
+                acmacs::file::writer writer{filename.string(), acmacs::file::force_compression::yes, acmacs::file::backup_file::no};
+                writer << "forced";
+            }
+            const auto data = acmacs::file::read(filename.string());
+            assert(acmacs::file::xz_compressed(data.raw().data()));
+            assert(static_cast<std::string>(data) == "forced");
+        }
+
+        // existing file is replaced on close(), it is intact while writing, the old one is hard linked into the backup dir
+        {
+            const auto filename = dir / "replaced.json.xz";
+            const auto content = [&filename]() { return static_cast<std::string>(acmacs::file::read(filename.string())); };
+            const auto inode = [&filename]() {
+                struct stat st;
+                assert(::stat(filename.c_str(), &st) == 0);
+                return st.st_ino;
+            };
+            const auto temp_files = [&dir]() {
+                return std::count_if(std::filesystem::directory_iterator{dir}, std::filesystem::directory_iterator{}, [](const auto& entry) { return entry.path().filename().string().starts_with(".replaced"); });
+            };
+            acmacs::file::write(filename.string(), "old", acmacs::file::force_compression::no, acmacs::file::backup_file::no);
+            const auto old_inode = inode();
+            {
+                acmacs::file::writer writer{filename.string()};
+                writer << std::string_view{source}.substr(0, 100000);
+                assert(content() == "old");
+                assert(temp_files() == 1);
+            }
+            assert(content() == std::string_view{source}.substr(0, 100000));
+            assert(inode() != old_inode);
+            assert(temp_files() == 0);
+            const std::vector<std::filesystem::directory_entry> backups(std::filesystem::directory_iterator{dir / ".backup"}, std::filesystem::directory_iterator{});
+            assert(backups.size() == 1);
+            struct stat backup_st;
+            assert(::stat(backups.front().path().c_str(), &backup_st) == 0 && backup_st.st_ino == old_inode);
+            assert(static_cast<std::string>(acmacs::file::read(backups.front().path().string())) == "old");
+
+            // writer destroyed by exception: temp file is removed, the file is kept, no backup made
+            try {
+                acmacs::file::writer writer{filename.string()};
+                writer << "partial";
+                throw std::runtime_error{"interrupted"};
+            }
+            catch (std::runtime_error&) {
+            }
+            assert(content() == std::string_view{source}.substr(0, 100000));
+            assert(temp_files() == 0);
+            assert(std::distance(std::filesystem::directory_iterator{dir / ".backup"}, std::filesystem::directory_iterator{}) == 1);
+        }
+
+        // writing after close fails
+        {
+            acmacs::file::writer writer{(dir / "closed.txt").string(), acmacs::file::force_compression::no, acmacs::file::backup_file::no};
+            writer.close();
+            bool thrown = false;
+            try {
+                writer << "data";
+            }
+            catch (std::runtime_error&) {
+                thrown = true;
+            }
+            assert(thrown);
+        }
+    }
+    catch (std::exception& err) {
+        AD_ERROR("{}", err);
+        exit_code = 1;
+    }
+
+    return exit_code;
+}
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
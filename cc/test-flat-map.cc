@@ -0,0 +1,368 @@
+#ifdef NDEBUG
+#undef NDEBUG
+#endif
+
+#include <cassert>
+#include <random>
+#include <algorithm>
+#include <thread>
+#include <map>
+
+#include "acmacs-base/argv.hh"
+#include "acmacs-base/timeit.hh"
+#include "acmacs-base/hash.hh"
+#include "acmacs-base/flat-map.hh"
+
+// without --benchmark: checks of flat maps against std::map/std::multimap
+// --benchmark: compares lookup in frozen_map_with_unique_keys_t (blocked index) with std::lower_bound over the sorted vector,
+// keys are integers, seqdb hash index like 8 hex digit strings and names sharing long prefixes
+
+using namespace acmacs::argv;
+
+struct Options : public argv
+{
+    Options(int a_argc, const char* const a_argv[], on_error on_err = on_error::exit) : argv() { parse(a_argc, a_argv, on_err); }
+
+    option<bool> benchmark{*this, 'b', "benchmark"};
+    option<size_t> entries{*this, 'n', "entries", dflt{1'000'000UL}};
+    option<size_t> lookups{*this, 'l', "lookups", dflt{10'000'000UL}};
+    option<size_t> threads{*this, 't', "threads", dflt{4UL}, desc{"concurrent readers of the frozen map"}};
+};
+
+template <typename Key> static void compare(std::string_view name, const std::vector<Key>& keys, size_t lookups, size_t threads)
+{
+    std::mt19937_64 generator{1};
+    std::vector<Key> to_find(lookups);
+    for (auto& key : to_find)
+        key = keys[generator() % keys.size()];
+
+    acmacs::frozen_map_with_unique_keys_t<Key, size_t> frozen;
+    std::vector<std::pair<Key, size_t>> sorted;
+    for (size_t no = 0; no < keys.size(); ++no) {
+        frozen.emplace(keys[no], no);
+        sorted.emplace_back(keys[no], no);
+    }
+    std::sort(std::begin(sorted), std::end(sorted), [](const auto& e1, const auto& e2) { return e1.first < e2.first; });
+    sorted.erase(std::unique(std::begin(sorted), std::end(sorted), [](const auto& e1, const auto& e2) { return e1.first == e2.first; }), std::end(sorted));
+
+    size_t found_lower_bound{0}, found_frozen{0};
+    const auto lower_bound_start = acmacs::timestamp();
+    for (const auto& key : to_find) {
+        if (const auto found = std::lower_bound(std::begin(sorted), std::end(sorted), key, [](const auto& en, const auto& k2) { return en.first < k2; }); found != std::end(sorted) && found->first == key)
+            found_lower_bound += found->second;
+    }
+    const auto lower_bound_time = acmacs::elapsed_seconds(lower_bound_start);
+
+    const auto freeze_start = acmacs::timestamp();
+    frozen.freeze();
+    const auto freeze_time = acmacs::elapsed_seconds(freeze_start);
+
+    const auto frozen_start = acmacs::timestamp();
+    for (const auto& key : to_find) {
+        if (const auto* found = frozen.find(key); found)
+            found_frozen += *found;
+    }
+    const auto frozen_time = acmacs::elapsed_seconds(frozen_start);
+
+    std::vector<size_t> found_by_thread(threads, 0);
+    std::vector<std::thread> readers;
+    const auto threads_start = acmacs::timestamp();
+    for (size_t thread_no = 0; thread_no < threads; ++thread_no) {
+        readers.emplace_back([&, thread_no]() {
+            for (const auto& key : to_find) {
+                if (const auto* found = frozen.find(key); found)
+                    found_by_thread[thread_no] += *found;
+            }
+        });
+    }
+    for (auto& reader : readers)
+        reader.join();
+    const auto threads_time = acmacs::elapsed_seconds(threads_start);
+
+    fmt::print("{:8s} entries: {}  lookups: {}\n  std::lower_bound {:7.3f}s\n  frozen: freeze   {:7.3f}s  find {:7.3f}s  x{:.2f}\n  {} threads       {:7.3f}s\n", name, sorted.size(), lookups,
+               lower_bound_time, freeze_time, frozen_time, lower_bound_time / frozen_time, threads, threads_time);
+    if (found_frozen != found_lower_bound || std::any_of(std::begin(found_by_thread), std::end(found_by_thread), [found_frozen](size_t found) { return found != found_frozen; }))
+        throw std::runtime_error{fmt::format("{}: lookup results differ", name)};
+}
+
+// ----------------------------------------------------------------------
+
+template <typename Exc, typename F> static bool throws(F&& func)
+{
+    try {
+        func();
+    }
+    catch (Exc&) {
+        return true;
+    }
+    return false;
+}
+
+// keys: present (from source), absent below, between and above them
+template <typename Key> static std::vector<Key> keys_to_find(const std::vector<Key>& source, const std::vector<Key>& absent)
+{
+    std::vector<Key> keys{source};
+    keys.insert(std::end(keys), std::begin(absent), std::end(absent));
+    return keys;
+}
+
+template <typename Key> static void check_frozen(const std::vector<Key>& source, const std::vector<Key>& absent)
+{
+    // unique keys
+    acmacs::frozen_map_with_unique_keys_t<Key, size_t> unique;
+    std::map<Key, size_t> unique_expected;
+    for (size_t no = 0; no < source.size(); ++no) {
+        if (unique_expected.emplace(source[no], no).second)
+            unique.emplace(source[no], no);
+    }
+    for (const auto& key : keys_to_find(source, absent)) {
+        const auto* found = unique.find(key);
+        if (const auto expected = unique_expected.find(key); expected != unique_expected.end())
+            assert(found && *found == expected->second);
+        else
+            assert(found == nullptr);
+    }
+    const auto same_entry = [](const auto& e1, const auto& e2) { return e1.first == e2.first && e1.second == e2.second; };
+    assert(std::equal(unique.begin(), unique.end(), unique_expected.begin(), unique_expected.end(), same_entry));
+    assert(throws<acmacs::frozen_map_error>([&] { unique.emplace(Key{}, 0ul); }));
+
+    const auto copy{unique}; // copy is frozen again
+    for (const auto& key : keys_to_find(source, absent))
+        assert((copy.find(key) == nullptr) == (unique_expected.find(key) == unique_expected.end()));
+
+    // duplicating keys, order of values for the same key is the order of emplace
+    acmacs::frozen_map_with_duplicating_keys_t<Key, size_t> duplicating;
+    std::multimap<Key, size_t> duplicating_expected;
+    for (size_t no = 0; no < source.size(); ++no) {
+        duplicating.emplace(source[no], no);
+        duplicating_expected.emplace(source[no], no);
+    }
+    for (const auto& key : keys_to_find(source, absent)) {
+        const auto [first, last] = duplicating.find(key);
+        const auto [expected_first, expected_last] = duplicating_expected.equal_range(key);
+        assert(std::equal(first, last, expected_first, expected_last, same_entry));
+    }
+
+    // concurrent readers freezing the map
+    acmacs::frozen_map_with_unique_keys_t<Key, size_t> concurrent;
+    for (const auto& [key, value] : unique_expected)
+        concurrent.emplace(key, value);
+    std::vector<std::thread> readers;
+    std::vector<size_t> found_by_thread(4, 0);
+    for (size_t thread_no = 0; thread_no < found_by_thread.size(); ++thread_no) {
+        readers.emplace_back([&, thread_no]() {
+            for (const auto& key : source) {
+                if (const auto* found = concurrent.find(key); found)
+                    ++found_by_thread[thread_no];
+            }
+        });
+    }
+    for (auto& reader : readers)
+        reader.join();
+    assert(std::all_of(std::begin(found_by_thread), std::end(found_by_thread), [&source](size_t found) { return found == source.size(); }));
+}
+
+// small map: lookups by key types hashed the same way, below, at and above index_threshold, after replace, sort, copy and assignment
+template <size_t index_threshold> static void check_small_map(size_t size)
+{
+    using map_t = acmacs::small_map_with_unique_keys_t<std::string, size_t, index_threshold>;
+    const auto key_of = [](size_t no) { return fmt::format("key-{}", no); };
+
+    const auto check_lookups = [&key_of, size](const map_t& map, const std::map<std::string, size_t>& expected) {
+        assert(map.size() == expected.size());
+        for (size_t no = 0; no < size + 3; ++no) {
+            const auto key = key_of(no);
+            const auto found = map.find(key);
+            if (const auto exp = expected.find(key); exp != expected.end()) {
+                assert(found != map.end() && found->first == key && found->second == exp->second);
+                assert(map.find(std::string_view{key}) == found);
+                assert(map.find(key.c_str()) == found);
+                assert(map.get(key) == exp->second);
+            }
+            else {
+                assert(found == map.end());
+                assert(map.find(std::string_view{key}) == map.end());
+                assert(throws<std::out_of_range>([&] { map.get(key); }));
+            }
+        }
+    };
+
+    map_t map;
+    std::map<std::string, size_t> expected;
+    for (size_t no = 0; no < size; ++no) {
+        map.emplace_or_replace(key_of(no), no);
+        expected[key_of(no)] = no;
+        check_lookups(map, expected);
+    }
+    for (size_t no = 0; no < size; no += 3) { // replaced values, the same entries
+        assert(&map.emplace_or_replace(key_of(no), no + 1000) == &*map.find(key_of(no)));
+        expected[key_of(no)] = no + 1000;
+        assert(map.emplace_not_replace(key_of(no), no).second == no + 1000);
+    }
+    check_lookups(map, expected);
+
+    map.sort([](const auto& e1, const auto& e2) { return e1.first > e2.first; }); // positions changed
+    assert(std::is_sorted(map.begin(), map.end(), [](const auto& e1, const auto& e2) { return e1.first > e2.first; }));
+    check_lookups(map, expected);
+
+    const map_t copy{map};
+    check_lookups(copy, expected);
+
+    map_t assigned{{key_of(size + 1), 1}, {key_of(size + 2), 2}};
+    assigned = map;
+    check_lookups(assigned, expected);
+    const auto& self = assigned;
+    assigned = self;
+    check_lookups(assigned, expected);
+
+    map_t larger;
+    for (size_t no = 0; no < index_threshold * 2; ++no)
+        larger.emplace_or_replace(key_of(no + size + 10), no);
+    larger = map; // index of the larger map is replaced
+    check_lookups(larger, expected);
+
+    map.emplace_or_replace(key_of(size), size); // copies are independent
+    check_lookups(copy, expected);
+    check_lookups(assigned, expected);
+    expected[key_of(size)] = size;
+    check_lookups(map, expected);
+
+    const map_t moved{std::move(map)};
+    check_lookups(moved, expected);
+}
+
+static void check()
+{
+    using namespace std::string_view_literals;
+
+    // integer keys: sizes around full leaves and full layers of the index (16 keys per node, 17 children)
+    std::mt19937_64 generator{2};
+    for (const size_t size : {0ul, 1ul, 2ul, 15ul, 16ul, 17ul, 272ul, 273ul, 1000ul, 4624ul, 4625ul, 100000ul}) {
+        std::vector<int64_t> source(size);
+        for (auto& key : source)
+            key = static_cast<int64_t>(generator() % (size * 2 + 1)) * 2; // even keys, some of them duplicated
+        check_frozen<int64_t>(source, {-1, 1, 3, static_cast<int64_t>(size) + 1, static_cast<int64_t>(size * 4 + 10), std::numeric_limits<int64_t>::min(), std::numeric_limits<int64_t>::max()});
+    }
+
+    // lookup by other integer types, keys out of range of the map key type
+    {
+        acmacs::frozen_map_with_unique_keys_t<uint32_t, int> map;
+        for (uint32_t key = 0; key < 1000; ++key)
+            map.emplace(key * 3, static_cast<int>(key));
+        assert(map.find(uint16_t{30}) && *map.find(uint16_t{30}) == 10);
+        assert(map.find(uint16_t{31}) == nullptr);
+        assert(map.find(size_t{2997}) && *map.find(size_t{2997}) == 999);
+        assert(map.find((uint64_t{1} << 40) + 30) == nullptr);
+    }
+
+    // floating point keys, -0.0 is found as 0.0
+    check_frozen<double>({-1e300, -2.5, -0.0, 1e-300, 0.5, 2.5, 3.0, std::numeric_limits<double>::infinity()}, {-std::numeric_limits<double>::infinity(), -3.0, -1e-300, 1.0, 1e300});
+    {
+        acmacs::frozen_map_with_unique_keys_t<double, int> map;
+        map.emplace(-0.0, 1);
+        assert(map.find(0.0) && *map.find(0.0) == 1);
+    }
+
+    // string_view keys: different and the same 8 byte prefixes, keys shorter than prefix, prefix with zero and 0xFF bytes
+    const std::vector<std::string_view> words{"B"sv, "H1"sv, "H3"sv, "A"sv, "H1"sv, "N2"sv, "B"sv, "Yamagata"sv, "Victoria"sv, "Victoria/2/87"sv, "Victoria/2/87"sv, "Victoria/1/88"sv,
+                                              "A/TEXAS/50/2012"sv, "A/TEXAS/5/2012"sv, "A/TEXAS/500/2012"sv, "ab"sv, "ab\0"sv, "ab\0\0c"sv,
+                                              "\xff\xff\xff\xff\xff\xff\xff\xff"sv, "\xff\xff\xff\xff\xff\xff\xff\xff\x01"sv, "\xff\xff\xff\xff\xff\xff\xff\xff\xff"sv};
+    check_frozen<std::string_view>(words, {""sv, "0"sv, "C"sv, "H2"sv, "Z"sv, "Victoria/1"sv, "Victoria/3"sv, "A/TEXAS/"sv, "A/TEXAS/51/2012"sv, "A/TEXAS/6"sv, "ab\0\0"sv,
+                                           "\xff\xff\xff\xff\xff\xff\xff"sv, "\xff\xff\xff\xff\xff\xff\xff\xff\x00"sv, "\xff\xff\xff\xff\xff\xff\xff\xff\xff\xff"sv});
+    std::vector<std::string> names(20000);
+    for (auto& name : names)
+        name = fmt::format("A/TEXAS/{}/20{:02d}", generator() % 5000, generator() % 30);
+    // keys sharing a prefix, the same key in every entry, lookup of keys before, within and after the common prefix
+    check_frozen<std::string_view>(std::vector<std::string_view>(std::begin(names), std::end(names)), {""sv, "A/TEX"sv, "A/TEXAR/1/2000"sv, "A/TEXAS/"sv, "A/TEXAS/5000/2000"sv, "A/TEXAS/1/2031"sv, "A/TEXAT"sv});
+    check_frozen<std::string>(names, {"", "A/TEX", "A/TEXAR/1/2000", "A/TEXAS/", "A/TEXAS/5000/2000", "A/TEXAS/1/2031", "A/TEXAT"});
+    check_frozen<std::string_view>({"Victoria/2/87"sv, "Victoria/2/87"sv}, {""sv, "Victoria"sv, "Victoria/2/8"sv, "Victoria/2/870"sv, "Victoria/3"sv, "W"sv});
+
+    // duplicating keys in the map with unique keys: every lookup throws, the map is not re-sorted
+    {
+        acmacs::frozen_map_with_unique_keys_t<int, int> map;
+        map.emplace(2, 20);
+        map.emplace(1, 10);
+        map.emplace(2, 21);
+        assert(throws<acmacs::map_with_unique_keys_error>([&] { map.freeze(); }));
+        assert(throws<acmacs::map_with_unique_keys_error>([&] { map.find(1); }));
+        assert(throws<acmacs::map_with_unique_keys_error>([&] { map.find(3); }));
+        assert(throws<acmacs::frozen_map_error>([&] { map.emplace(3, 30); })); // frozen anyway
+        assert(map.size() == 3);
+    }
+
+    // small maps with hash index
+    for (const size_t size : {0ul, 1ul, 31ul, 32ul, 33ul, 100ul})
+        check_small_map<32>(size);
+    for (const size_t size : {3ul, 4ul, 5ul, 200ul}) // index grows several times
+        check_small_map<4>(size);
+    {
+        acmacs::small_map_with_unique_keys_t<int, int, 4> map;
+        for (int key = 0; key < 50; ++key)
+            map.emplace_or_replace(key * 7, key);
+        assert(map.find(21)->second == 3);
+        assert(map.find(22) == map.end());
+        assert(map.get_or(22, -1) == -1);
+    }
+
+    // lazily sorted maps
+    {
+        acmacs::map_with_unique_keys_t<int, std::string> map;
+        map.emplace(3, "three");
+        map.emplace(1, "one");
+        assert(map.find(1) && *map.find(1) == "one");
+        assert(map.find(2) == nullptr);
+        map.emplace(1, "uno");
+        assert(throws<acmacs::map_with_unique_keys_error>([&] { map.check(); }));
+
+        acmacs::map_with_duplicating_keys_t<int, int> duplicating;
+        for (const auto& [key, value] : std::vector<std::pair<int, int>>{{2, 1}, {1, 2}, {2, 3}})
+            duplicating.emplace(key, value);
+        const auto [first, last] = duplicating.find(2);
+        assert(std::distance(first, last) == 2);
+    }
+}
+
+// ----------------------------------------------------------------------
+
+int main(int argc, const char* const argv[])
+{
+    int exit_code = 0;
+    try {
+        Options opt(argc, argv);
+        if (!opt.benchmark) {
+            check();
+            return 0;
+        }
+        std::mt19937_64 generator{0};
+
+        std::vector<uint64_t> integers(*opt.entries);
+        for (auto& key : integers)
+            key = generator();
+        compare<uint64_t>("uint64", integers, *opt.lookups, *opt.threads);
+
+        std::vector<std::string> hashes(*opt.entries);
+        for (size_t no = 0; no < hashes.size(); ++no)
+            hashes[no] = acmacs::hash(fmt::format("sequence {}", no));
+        std::sort(std::begin(hashes), std::end(hashes)); // XXH32 collides on a million entries
+        hashes.erase(std::unique(std::begin(hashes), std::end(hashes)), std::end(hashes));
+        std::shuffle(std::begin(hashes), std::end(hashes), generator);
+        std::vector<std::string_view> hash_views(std::begin(hashes), std::end(hashes));
+        compare<std::string_view>("hash", hash_views, *opt.lookups, *opt.threads);
+
+        std::vector<std::string> names(*opt.entries); // the same 8 byte prefix
+        for (size_t no = 0; no < names.size(); ++no)
+            names[no] = fmt::format("A/TEXAS/{}/2012", no);
+        std::shuffle(std::begin(names), std::end(names), generator);
+        compare<std::string_view>("names", std::vector<std::string_view>(std::begin(names), std::end(names)), *opt.lookups, *opt.threads);
+    }
+    catch (std::exception& err) {
+        fmt::print(stderr, "ERROR: {}\n", err);
+        exit_code = 1;
+    }
+    return exit_code;
+}
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
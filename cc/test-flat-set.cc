@@ -0,0 +1,111 @@
+#ifdef NDEBUG
+#undef NDEBUG
+#endif
+
+#include <cassert>
+#include <random>
+#include <set>
+
+#include "acmacs-base/flat-set.hh"
+#include "acmacs-base/log.hh"
+
+// ----------------------------------------------------------------------
+
+// set operations on sorted and unsorted flat sets of strings are compared with std::set,
+// elements are longer than the small string buffer, contents of elements kept in place are checked
+
+using expected_t = std::set<std::string>;
+
+static std::string element(size_t no) { return fmt::format("A/SINGAPORE/{:05d}/2016 MDCK1/SIAT2", no); }
+
+static std::vector<std::string> random_elements(std::mt19937& generator, size_t count, size_t range)
+{
+    std::vector<std::string> result(count);
+    for (auto& elt : result)
+        elt = element(generator() % range);
+    return result;
+}
+
+static acmacs::flat_set_t<std::string> make_set(const std::vector<std::string>& source, bool sorted)
+{
+    acmacs::flat_set_t<std::string> result;
+    for (const auto& elt : source)
+        result.add(elt);
+    if (sorted)
+        result.sort();
+    return result;
+}
+
+static bool same(const acmacs::flat_set_t<std::string>& set, const expected_t& expected)
+{
+    if (set.sorted())
+        return std::equal(set.begin(), set.end(), expected.begin(), expected.end());
+    else
+        return set.size() == expected.size() && std::all_of(set.begin(), set.end(), [&expected](const auto& elt) { return expected.count(elt) == 1; });
+}
+
+// ----------------------------------------------------------------------
+
+int main(int /*argc*/, const char* /*argv*/[])
+{
+    int exit_code = 0;
+    try {
+        std::mt19937 generator{3};
+        // sizes of the second set relative to the first one select merge and galloping paths
+        for (const auto& [size1, size2] : std::vector<std::pair<size_t, size_t>>{{0, 0}, {0, 10}, {10, 0}, {1, 1}, {100, 100}, {500, 20}, {20, 500}, {1000, 3}, {3, 1000}}) {
+            for (const bool sorted1 : {true, false}) {
+                for (const bool sorted2 : {true, false}) {
+                    const auto source1 = random_elements(generator, size1, size1 + size2 + 1);
+                    const auto source2 = random_elements(generator, size2, size1 + size2 + 1);
+                    const expected_t expected1(source1.begin(), source1.end()), expected2(source2.begin(), source2.end());
+                    const auto set2 = make_set(source2, sorted2);
+
+                    {
+                        auto set = make_set(source1, sorted1);
+                        set.remove(set2);
+                        expected_t expected;
+                        std::set_difference(expected1.begin(), expected1.end(), expected2.begin(), expected2.end(), std::inserter(expected, expected.end()));
+                        assert(same(set, expected));
+                    }
+
+                    {
+                        auto set = make_set(source1, sorted1);
+                        set.intersect_with(set2);
+                        expected_t expected;
+                        std::set_intersection(expected1.begin(), expected1.end(), expected2.begin(), expected2.end(), std::inserter(expected, expected.end()));
+                        assert(same(set, expected));
+                    }
+
+                    expected_t expected_union{expected1};
+                    expected_union.insert(expected2.begin(), expected2.end());
+                    for (const auto a_sort : {acmacs::flat_set_sort_afterwards::no, acmacs::flat_set_sort_afterwards::yes}) {
+                        auto set = make_set(source1, sorted1);
+                        set.merge_from(set2, a_sort);
+                        assert(same(set, expected_union));
+                        assert(set.sorted() == (sorted1 || a_sort == acmacs::flat_set_sort_afterwards::yes));
+                    }
+
+                    {
+                        auto set = make_set(source1, sorted1);
+                        set.add_range(source2);
+                        assert(set.sorted());
+                        assert(same(set, expected_union));
+                        for (const auto& elt : expected_union)
+                            assert(set.exists(elt));
+                        assert(!set.exists(element(size1 + size2 + 1)));
+                    }
+                }
+            }
+        }
+    }
+    catch (std::exception& err) {
+        AD_ERROR("{}", err);
+        exit_code = 1;
+    }
+    return exit_code;
+}
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
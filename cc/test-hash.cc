@@ -0,0 +1,113 @@
+#ifdef NDEBUG
+#undef NDEBUG
+#endif
+
+#include <cassert>
+#include <cstring>
+#include <new>
+
+#include "acmacs-base/hash.hh"
+#include "acmacs-base/hash-file.hh"
+#include "acmacs-base/read-file.hh"
+#include "acmacs-base/log.hh"
+#include "../test/file-test.hh"
+
+// ----------------------------------------------------------------------
+
+// incremental digests against one-shot hashes, hex format of hash128_t, transparent lookup in string_hash_map, file hashes
+
+static void check_incremental(std::string_view source, uint64_t seed)
+{
+    acmacs::hasher64 h64{seed};
+    acmacs::hasher128 h128{seed};
+    size_t offset = 0;
+    for (size_t piece = 1; offset < source.size(); piece = piece * 3 + 1) { // uneven chunks, some smaller and some larger than XXH3 internal buffer
+        const auto chunk = source.substr(offset, piece);
+        h64.update(chunk);
+        h128.update(chunk);
+        offset += chunk.size();
+    }
+    assert(h64.digest() == acmacs::hash64(source, seed));
+    assert(h128.digest() == acmacs::hash128(source, seed));
+    assert(h64.digest() == acmacs::hash64(source, seed)); // digest does not change state
+
+    // reset starts a new digest
+    h64.reset(seed);
+    h128.reset(seed);
+    assert(h64.update(source).digest() == acmacs::hash64(source, seed));
+    assert(h128.update(source).digest() == acmacs::hash128(source, seed));
+}
+
+// hasher constructed in memory that looks like a state already reset with the same seed, i.e. with stale custom secret
+template <typename Hasher, typename Hash> static void check_constructed_in_dirty_memory(std::string_view source, uint64_t seed, Hash hash)
+{
+    alignas(Hasher) unsigned char storage[sizeof(Hasher)];
+    for (size_t offset = 0; offset + sizeof(seed) <= sizeof(storage); offset += sizeof(seed))
+        std::memcpy(storage + offset, &seed, sizeof(seed));
+    auto* hasher = new (storage) Hasher{seed};
+    assert(hasher->update(source).digest() == hash(source, seed));
+    hasher->~Hasher();
+}
+
+// ----------------------------------------------------------------------
+
+int main(int /*argc*/, const char* /*argv*/[])
+{
+    int exit_code = 0;
+    try {
+        const auto source = acmacs::file::test::make_source(1024 * 1024 + 13, 3);
+
+        // reference values of XXH3
+        assert(acmacs::hash64("") == 0x2D06800538D394C2ull);
+        assert((acmacs::hash128("") == acmacs::hash128_t{0x99AA06D3014798D8ull, 0x6001C324468D497Full}));
+
+        for (const uint64_t seed : {uint64_t{0}, uint64_t{0x9E3779B97F4A7C15ull}}) {
+            for (const size_t size : {size_t{0}, size_t{3}, size_t{240}, size_t{241}, size_t{10000}, source.size()})
+                check_incremental(std::string_view{source}.substr(0, size), seed);
+        }
+        for (const uint64_t seed : {uint64_t{1}, uint64_t{0x9E3779B97F4A7C15ull}}) {
+            check_constructed_in_dirty_memory<acmacs::hasher64>(source, seed, [](std::string_view src, uint64_t sd) { return acmacs::hash64(src, sd); });
+            check_constructed_in_dirty_memory<acmacs::hasher128>(source, seed, [](std::string_view src, uint64_t sd) { return acmacs::hash128(src, sd); });
+        }
+        assert(acmacs::hash64(source) != acmacs::hash64(source, 1));
+        assert(acmacs::hash128(source) != acmacs::hash128(source, 1));
+
+        // hex: 32 lowercase digits, high first, formatter gives the same
+        assert((acmacs::hash128_t{0, 1}.hex() == "00000000000000000000000000000001"));
+        assert((acmacs::hash128_t{0xABCull, 0}.hex() == "0000000000000abc0000000000000000"));
+        const auto digest = acmacs::hash128(source);
+        assert(digest.hex().size() == 32);
+        assert(fmt::format("{}", digest) == digest.hex());
+
+        // transparent lookup
+        acmacs::string_hash_map<size_t> map;
+        for (size_t no = 0; no < 1000; ++no)
+            map.emplace(fmt::format("key-{}", no), no);
+        const std::string_view key_view{"key-517"};
+        assert(map.find(key_view) != map.end() && map.find(key_view)->second == 517);
+        const char* key_chars = "key-33";
+        assert(map.find(key_chars) != map.end() && map.find(key_chars)->second == 33);
+        assert(map.find(std::string_view{"key-1000"}) == map.end());
+        acmacs::string_hash_set set{"A/SINGAPORE", "B/VICTORIA"};
+        assert(set.contains(std::string_view{"B/VICTORIA"}) && !set.contains("A/VICTORIA"));
+
+        // file hashes are of raw (compressed) content
+        const acmacs::file::test::temp_directory dir{"hash"};
+        const auto filename = (dir / "data.json.xz").native();
+        acmacs::file::write(filename, source, acmacs::file::force_compression::no, acmacs::file::backup_file::no);
+        const auto raw = acmacs::file::read(filename);
+        assert(acmacs::hash128_file(filename) == acmacs::hash128(raw.raw()));
+        assert(acmacs::hash64_file(filename) == acmacs::hash64(raw.raw()));
+        assert(acmacs::hash128_file(filename) != acmacs::hash128(source));
+    }
+    catch (std::exception& err) {
+        AD_ERROR("{}", err);
+        exit_code = 1;
+    }
+    return exit_code;
+}
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
@@ -0,0 +1,330 @@
+#include <random>
+
+#include "acmacs-base/argv.hh"
+#include "acmacs-base/timeit.hh"
+#include "acmacs-base/layout-soa.hh"
+#include "acmacs-base/layout-distances.hh"
+#include "acmacs-base/layout-spatial-index.hh"
+
+// compares Layout (point-major) and LayoutSoA (dimension-major) on per-dimension reductions,
+// checks and times transform kernels, distance matrix and spatial index against straightforward implementations
+
+using namespace acmacs::argv;
+
+struct Options : public argv
+{
+    Options(int a_argc, const char* const a_argv[], on_error on_err = on_error::exit) : argv() { parse(a_argc, a_argv, on_err); }
+
+    option<size_t> points{*this, 'p', "points", dflt{200'000UL}};
+    option<size_t> dimensions{*this, 'd', "dimensions", dflt{2UL}, desc{"2 or 3"}};
+    option<size_t> repeat{*this, 'r', "repeat", dflt{20UL}};
+    option<size_t> distance_points{*this, 'n', "distance-points", dflt{5'000UL}, desc{"number of points for the distance matrix"}};
+};
+
+// ----------------------------------------------------------------------
+
+template <typename F> static double time_it(size_t repeat, F&& func)
+{
+    const auto start = acmacs::timestamp();
+    for (size_t rep = 0; rep < repeat; ++rep)
+        func();
+    return acmacs::elapsed_seconds(start);
+}
+
+static void compare(std::string_view name, double layout_time, double soa_time)
+{
+    fmt::print("  {:24s} Layout {:7.4f}s  LayoutSoA {:7.4f}s  x{:.2f}\n", name, layout_time, soa_time, layout_time / soa_time);
+}
+
+template <typename T> static void check(std::string_view name, const T& layout_result, const T& soa_result)
+{
+    if (layout_result != soa_result)
+        throw std::runtime_error{fmt::format("{}: results differ", name)};
+}
+
+// LayoutDistances and LayoutDistancesAntigensSera against Layout::distance() for every pair, for the generic (1, 4, 5 dimensions)
+// and the specialized (2, 3 dimensions) kernels, more points than a tile has rows and columns
+static void check_distances(acmacs::number_of_dimensions_t num_dim)
+{
+    constexpr size_t num_points = 700, number_of_antigens = 600;
+    std::mt19937_64 generator{*num_dim};
+    std::uniform_real_distribution<double> coordinate{-10.0, 10.0};
+    acmacs::Layout layout(num_points, num_dim);
+    for (size_t point_no = 0; point_no < num_points; ++point_no) {
+        if (point_no % 50 != 3) { // disconnected points
+            for (acmacs::number_of_dimensions_t dim{0}; dim < num_dim; ++dim)
+                layout.coordinate(point_no, dim) = coordinate(generator);
+        }
+    }
+
+    const auto same = [](double v1, double v2) { return std::abs(v1 - v2) < 1e-9 || (v1 < 0.0 && v2 < 0.0); };
+    for (const size_t threads : {1UL, 4UL}) {
+        const acmacs::LayoutDistances distances{layout, threads};
+        const acmacs::LayoutDistancesAntigensSera antigens_sera{layout, number_of_antigens, threads};
+        for (size_t p1 = 0; p1 < num_points; ++p1) {
+            for (size_t p2 = 0; p2 < num_points; ++p2) {
+                const auto expected = p1 == p2 ? 0.0 : layout.distance(p1, p2, -1.0);
+                if (!same(distances(p1, p2, -1.0), expected))
+                    throw std::runtime_error{fmt::format("distances {}d: results differ for {} {}", num_dim, p1, p2)};
+                if (p1 < number_of_antigens && p2 >= number_of_antigens && !same(antigens_sera(p1, p2 - number_of_antigens, -1.0), expected))
+                    throw std::runtime_error{fmt::format("antigens-sera distances {}d: results differ for AG {} SR {}", num_dim, p1, p2 - number_of_antigens)};
+            }
+        }
+    }
+}
+
+// ----------------------------------------------------------------------
+
+int main(int argc, const char* const argv[])
+{
+    int exit_code = 0;
+    try {
+        Options opt(argc, argv);
+        for (size_t dim = 1; dim <= 5; ++dim)
+            check_distances(acmacs::number_of_dimensions_t{dim});
+
+        const acmacs::number_of_dimensions_t num_dim{*opt.dimensions};
+        std::mt19937_64 generator{0};
+        std::normal_distribution<double> coordinate{0.0, 5.0};
+        acmacs::Layout layout(*opt.points, num_dim);
+        for (size_t point_no = 0; point_no < layout.number_of_points(); ++point_no) {
+            if (point_no % 100 != 7) { // every 100th point is disconnected
+                for (acmacs::number_of_dimensions_t dim{0}; dim < num_dim; ++dim)
+                    layout.coordinate(point_no, dim) = coordinate(generator);
+            }
+        }
+
+        acmacs::LayoutSoA soa;
+        const auto to_soa_time = time_it(*opt.repeat, [&]() { soa = acmacs::LayoutSoA{layout}; });
+        acmacs::Layout back;
+        const auto to_layout_time = time_it(*opt.repeat, [&]() { back = soa.to_layout(); });
+        for (size_t point_no = 0; point_no < layout.number_of_points(); ++point_no) {
+            if (layout[point_no] != back[point_no])
+                throw std::runtime_error{"conversion round trip failed"};
+        }
+
+        if (acmacs::LayoutSoA(10, acmacs::number_of_dimensions_t{0}).number_of_points() != 0)
+            throw std::runtime_error{"LayoutSoA without dimensions has points"};
+
+        fmt::print("{} points {}d, {} repetitions\n  conversion  to LayoutSoA {:.4f}s  to Layout {:.4f}s\n", layout.number_of_points(), num_dim, *opt.repeat, to_soa_time, to_layout_time);
+
+        std::vector<std::pair<double, double>> minmax_layout, minmax_soa;
+        compare("minmax", time_it(*opt.repeat, [&]() { minmax_layout = layout.minmax(); }), time_it(*opt.repeat, [&]() { minmax_soa = soa.minmax(); }));
+        check("minmax", minmax_layout, minmax_soa);
+
+        std::pair<std::vector<size_t>, std::vector<size_t>> indexes_layout, indexes_soa;
+        compare("min_max_point_indexes", time_it(*opt.repeat, [&]() { indexes_layout = layout.min_max_point_indexes(); }),
+                time_it(*opt.repeat, [&]() { indexes_soa = soa.min_max_point_indexes(); }));
+        check("min_max_point_indexes", indexes_layout, indexes_soa);
+
+        double area_layout{0}, area_soa{0};
+        compare("area", time_it(*opt.repeat, [&]() { area_layout = layout.area().area(); }), time_it(*opt.repeat, [&]() { area_soa = soa.area().area(); }));
+        check("area", area_layout, area_soa);
+
+        acmacs::PointCoordinates centroid_layout(num_dim), centroid_soa(num_dim);
+        compare("centroid", time_it(*opt.repeat, [&]() { centroid_layout = layout.centroid(); }), time_it(*opt.repeat, [&]() { centroid_soa = soa.centroid(); }));
+        if (acmacs::distance(centroid_layout, centroid_soa) > 1e-9)
+            throw std::runtime_error{"centroid: results differ"};
+
+        const acmacs::number_of_dimensions_t last_dim{*num_dim - 1};
+        double sum_layout{0}, sum_soa{0};
+        compare("dimension iterator", time_it(*opt.repeat, [&]() { sum_layout += std::accumulate(layout.begin_dimension(last_dim), layout.end_dimension(last_dim), 0.0); }),
+                time_it(*opt.repeat, [&]() { sum_soa += std::accumulate(soa.begin_dimension(last_dim), soa.end_dimension(last_dim), 0.0); }));
+        check("dimension iterator", sum_layout, sum_soa);
+
+        acmacs::Transformation transformation(num_dim);
+        transformation.rotate(0.5);
+        std::shared_ptr<acmacs::Layout> transformed_layout;
+        std::shared_ptr<acmacs::LayoutSoA> transformed_soa;
+        compare("transform", time_it(*opt.repeat, [&]() { transformed_layout = layout.transform(transformation); }),
+                time_it(*opt.repeat, [&]() { transformed_soa = soa.transform(transformation); }));
+        const auto transformed_back = transformed_soa->to_layout();
+        for (size_t point_no = 0; point_no < layout.number_of_points(); ++point_no) {
+            if (const auto dist = transformed_layout->at(point_no).exists() ? acmacs::distance(transformed_layout->at(point_no), transformed_back.at(point_no)) : 0.0; dist > 1e-9)
+                throw std::runtime_error{fmt::format("transform: results differ for point {}", point_no)};
+        }
+
+        // Layout::transform kernels against transforming point by point via Transformation::transform(PointCoordinates)
+        acmacs::Layout per_point(layout.number_of_points(), num_dim), into(layout.number_of_points(), num_dim), in_place{layout};
+        const auto per_point_time = time_it(*opt.repeat, [&]() {
+            for (size_t point_no = 0; point_no < layout.number_of_points(); ++point_no)
+                per_point.update(point_no, transformation.transform(layout.at(point_no)));
+        });
+        const auto into_time = time_it(*opt.repeat, [&]() { layout.transform(transformation, into, 1); });
+        const auto into_threads_time = time_it(*opt.repeat, [&]() { layout.transform(transformation, into, 0); });
+        const auto in_place_time = time_it(*opt.repeat, [&]() { in_place.transform_in_place(transformation, 1); });
+        fmt::print("  transform per point {:7.4f}s  into output {:7.4f}s x{:.2f}  into output all threads {:7.4f}s x{:.2f}  in place {:7.4f}s x{:.2f}\n", per_point_time, into_time,
+                   per_point_time / into_time, into_threads_time, per_point_time / into_threads_time, in_place_time, per_point_time / in_place_time);
+        for (size_t point_no = 0; point_no < layout.number_of_points(); ++point_no) {
+            if (const auto dist = per_point.at(point_no).exists() ? acmacs::distance(per_point.at(point_no), into.at(point_no)) : 0.0; dist > 1e-9 || per_point.at(point_no).exists() != into.at(point_no).exists())
+                throw std::runtime_error{fmt::format("transform into output: results differ for point {}", point_no)};
+        }
+
+        // batch of projections, the same transformation is applied to every projection once
+        std::vector<acmacs::Layout> projections(*opt.repeat, layout);
+        std::vector<acmacs::Layout*> projection_ptrs;
+        for (auto& projection : projections)
+            projection_ptrs.push_back(&projection);
+        in_place = layout;
+        in_place.transform_in_place(transformation);
+        const auto batch_time = time_it(1, [&]() { acmacs::transform_in_place(transformation, projection_ptrs); });
+        fmt::print("  transform {} projections in place {:7.4f}s\n", projections.size(), batch_time);
+        const auto same = [](double v1, double v2) { return v1 == v2 || (std::isnan(v1) && std::isnan(v2)); };
+        for (const auto& projection : projections) {
+            if (!std::equal(std::begin(projection.as_flat_vector_double()), std::end(projection.as_flat_vector_double()), std::begin(in_place.as_flat_vector_double()), same))
+                throw std::runtime_error{"batch transform: results differ"};
+        }
+
+        // unsupported number of dimensions is reported, also when several threads would be used
+        {
+            acmacs::Layout four_dim(3 * (1 << 16), acmacs::number_of_dimensions_t{4});
+            acmacs::Layout four_dim_output;
+            for (const size_t threads : {1UL, 4UL}) {
+                bool thrown = false;
+                try {
+                    four_dim.transform(transformation, four_dim_output, threads);
+                }
+                catch (std::runtime_error&) {
+                    thrown = true;
+                }
+                if (!thrown)
+                    throw std::runtime_error{fmt::format("transform of 4D layout with {} threads: no error reported", threads)};
+            }
+        }
+
+        // distance matrix against Layout::distance() for every pair
+        const acmacs::Layout distance_layout(layout, [num_points = std::min(*opt.distance_points, layout.number_of_points())]() {
+            std::vector<size_t> indexes(num_points);
+            std::iota(std::begin(indexes), std::end(indexes), 0UL);
+            return indexes;
+        }());
+        const auto num_points = distance_layout.number_of_points();
+        std::vector<double> per_pair(num_points * (num_points - 1) / 2);
+        const auto per_pair_time = time_it(1, [&]() {
+            auto target = std::begin(per_pair);
+            for (size_t p1 = 0; p1 < num_points; ++p1) {
+                for (size_t p2 = p1 + 1; p2 < num_points; ++p2, ++target)
+                    *target = distance_layout.distance(p1, p2);
+            }
+        });
+        acmacs::LayoutDistances distances;
+        const auto distances_time = time_it(1, [&]() { distances = acmacs::LayoutDistances{distance_layout, 1}; });
+        const auto distances_threads_time = time_it(1, [&]() { distances = acmacs::LayoutDistances{distance_layout, 0}; });
+        fmt::print("  distances {} points: per pair {:7.4f}s  matrix {:7.4f}s x{:.2f}  matrix all threads {:7.4f}s x{:.2f}\n", num_points, per_pair_time, distances_time, per_pair_time / distances_time,
+                   distances_threads_time, per_pair_time / distances_threads_time);
+        if (!std::equal(std::begin(per_pair), std::end(per_pair), std::begin(distances.packed()), [](double v1, double v2) { return std::abs(v1 - v2) < 1e-9 || (std::isnan(v1) && std::isnan(v2)); }))
+            throw std::runtime_error{"distances: results differ"};
+
+        const size_t number_of_antigens = num_points * 4 / 5;
+        const acmacs::LayoutDistancesAntigensSera antigens_sera{distance_layout, number_of_antigens};
+        for (size_t antigen_no = 0; antigen_no < number_of_antigens; ++antigen_no) {
+            for (size_t serum_no = 0; serum_no < antigens_sera.number_of_sera(); ++serum_no) {
+                if (const auto dist = antigens_sera(antigen_no, serum_no, -1.0); dist != distances(antigen_no, number_of_antigens + serum_no, -1.0))
+                    throw std::runtime_error{fmt::format("antigens-sera distances: results differ for AG {} SR {}", antigen_no, serum_no)};
+            }
+        }
+
+        // spatial index queries against scanning the whole layout
+        acmacs::Layout moving{layout};
+        acmacs::LayoutSpatialIndex index{moving};
+        const auto build_time = time_it(*opt.repeat, [&]() { index.rebuild(); });
+        const auto scan_within = [&moving](const acmacs::PointCoordinates& center, double radius) {
+            std::vector<size_t> result;
+            for (size_t point_no = 0; point_no < moving.number_of_points(); ++point_no) {
+                if (moving.point_has_coordinates(point_no) && acmacs::distance(moving[point_no], center) <= radius)
+                    result.push_back(point_no);
+            }
+            return result;
+        };
+        const auto scan_nearest = [&moving](size_t point_no, size_t k) {
+            std::vector<acmacs::LayoutSpatialIndex::neighbour_t> result;
+            if (!moving.point_has_coordinates(point_no))
+                return result;
+            for (size_t other = 0; other < moving.number_of_points(); ++other) {
+                if (other != point_no && moving.point_has_coordinates(other))
+                    result.emplace_back(other, moving.distance(point_no, other));
+            }
+            std::sort(std::begin(result), std::end(result), [](const auto& e1, const auto& e2) { return e1.second == e2.second ? e1.first < e2.first : e1.second < e2.second; });
+            result.resize(std::min(k, result.size()));
+            return result;
+        };
+
+        constexpr size_t number_of_queries = 100, k = 10;
+        std::vector<std::vector<size_t>> within_scan(number_of_queries), within_index(number_of_queries);
+        const auto within_scan_time = time_it(1, [&]() {
+            for (size_t query_no = 0; query_no < number_of_queries; ++query_no)
+                within_scan[query_no] = scan_within(acmacs::PointCoordinates(num_dim, static_cast<double>(query_no) * 0.1 - 5.0), 2.0);
+        });
+        const auto within_index_time = time_it(1, [&]() {
+            for (size_t query_no = 0; query_no < number_of_queries; ++query_no)
+                within_index[query_no] = index.within(acmacs::PointCoordinates(num_dim, static_cast<double>(query_no) * 0.1 - 5.0), 2.0);
+        });
+        check("spatial index within", within_scan, within_index);
+
+        std::vector<std::vector<acmacs::LayoutSpatialIndex::neighbour_t>> nearest_scan(number_of_queries), nearest_index(number_of_queries);
+        const auto nearest_scan_time = time_it(1, [&]() {
+            for (size_t query_no = 0; query_no < number_of_queries; ++query_no)
+                nearest_scan[query_no] = scan_nearest(query_no * 17, k);
+        });
+        const auto nearest_index_time = time_it(1, [&]() {
+            for (size_t query_no = 0; query_no < number_of_queries; ++query_no)
+                nearest_index[query_no] = index.nearest(query_no * 17, k);
+        });
+        check("spatial index nearest", nearest_scan, nearest_index);
+        std::vector<std::vector<acmacs::LayoutSpatialIndex::neighbour_t>> nearest_all;
+        const auto nearest_all_time = time_it(1, [&]() { nearest_all = index.nearest_for_all(k); });
+        fmt::print("  spatial index {} cells: build {:7.4f}s\n    {} radius queries: scan {:7.4f}s index {:7.4f}s x{:.0f}\n    {} nearest {}: scan {:7.4f}s index {:7.4f}s x{:.0f}\n    nearest {} for all points {:7.4f}s\n",
+                   index.number_of_cells(), build_time / static_cast<double>(*opt.repeat), number_of_queries, within_scan_time, within_index_time, within_scan_time / within_index_time, number_of_queries, k,
+                   nearest_scan_time, nearest_index_time, nearest_scan_time / nearest_index_time, k, nearest_all_time);
+        for (size_t query_no = 0; query_no < number_of_queries; ++query_no)
+            check("spatial index nearest for all", nearest_scan[query_no], nearest_all[query_no * 17]);
+
+        // move some points (disconnect, connect, move far outside of the indexed area) and query again, incremental updates are followed by a rebuild
+        std::mt19937_64 move_generator{1};
+        for (size_t move_no = 0; move_no < moving.number_of_points() / 16; ++move_no) {
+            const auto point_no = move_generator() % moving.number_of_points();
+            switch (move_no % 3) {
+                case 0:
+                    moving.set_nan(point_no);
+                    break;
+                case 1:
+                    moving.update(point_no, acmacs::PointCoordinates(num_dim, coordinate(generator)));
+                    break;
+                default:
+                    moving.update(point_no, acmacs::PointCoordinates(num_dim, 100.0 + static_cast<double>(move_no)));
+                    break;
+            }
+            index.update(point_no);
+            if (move_no % 1000 == 0) {
+                const auto center = acmacs::PointCoordinates(num_dim, 0.5);
+                check("spatial index within after update", scan_within(center, 1.0), index.within(center, 1.0));
+                check("spatial index nearest after update", scan_nearest(move_no, k), index.nearest(move_no, k));
+            }
+        }
+        const acmacs::Area area{acmacs::PointCoordinates(num_dim, -1.0), acmacs::PointCoordinates(num_dim, 200.0)};
+        std::vector<size_t> in_area;
+        for (size_t point_no = 0; point_no < moving.number_of_points(); ++point_no) {
+            bool inside = moving.point_has_coordinates(point_no);
+            for (acmacs::number_of_dimensions_t dim{0}; inside && dim < num_dim; ++dim)
+                inside = moving(point_no, dim) >= area.min[dim] && moving(point_no, dim) <= area.max[dim];
+            if (inside)
+                in_area.push_back(point_no);
+        }
+        check("spatial index area", in_area, index.within(area));
+
+        // query box far outside of the grid
+        const auto origin = acmacs::PointCoordinates(num_dim, 0.0);
+        check("spatial index within infinite radius", scan_within(origin, std::numeric_limits<double>::infinity()), index.within(origin, std::numeric_limits<double>::infinity()));
+        check("spatial index within huge radius", scan_within(origin, 1e300), index.within(origin, 1e300));
+    }
+    catch (std::exception& err) {
+        fmt::print(stderr, "ERROR: {}\n", err);
+        exit_code = 1;
+    }
+    return exit_code;
+}
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
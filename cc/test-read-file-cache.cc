@@ -0,0 +1,150 @@
+#ifdef NDEBUG
+#undef NDEBUG
+#endif
+
+#include <cassert>
+#include <sys/stat.h>
+#include <fcntl.h>
+
+#include "acmacs-base/filesystem.hh"
+#include "acmacs-base/file-writer.hh"
+#include "acmacs-base/settings-v3.hh"
+#include "acmacs-base/log.hh"
+#include "../test/file-test.hh"
+
+// ----------------------------------------------------------------------
+
+static void write_file(const fs::path& filename, std::string_view content, time_t mtime)
+{
+    acmacs::file::writer{filename.native(), acmacs::file::force_compression::no, acmacs::file::backup_file::no} << content;
+    const timespec times[2]{{mtime, 0}, {mtime, 0}};
+    if (::utimensat(AT_FDCWD, filename.c_str(), times, 0) != 0)
+        throw std::runtime_error{fmt::format("cannot set mtime of {}", filename)};
+}
+
+static ino_t inode(const fs::path& filename)
+{
+    struct stat st;
+    ::stat(filename.c_str(), &st);
+    return st.st_ino;
+}
+
+class TestData : public acmacs::settings::v3::Data
+{
+  public:
+    int answer() const { return getenv("answer").to<int>(); }
+};
+
+// ----------------------------------------------------------------------
+
+int main(int /*argc*/, const char* /*argv*/[])
+{
+    namespace cache = acmacs::file::content_cache;
+
+    int exit_code = 0;
+    const acmacs::file::test::temp_directory dir{"read-file-cache"};
+
+    try {
+        cache::clear();
+        const auto filename = (dir / "content.txt").native();
+        constexpr time_t mtime = 1600000000;
+
+        // unchanged file is not re-read, the same buffer is returned
+        write_file(filename, "content-1", mtime);
+        const auto content1 = acmacs::file::read_cached(filename);
+        assert(*content1 == "content-1");
+        assert(cache::statistics().misses == 1);
+        assert(acmacs::file::read_cached(filename) == content1);
+        assert(cache::statistics().hits == 1);
+
+        // mtime changed, the same size
+        write_file(filename, "content-2", mtime + 1);
+        const auto content2 = acmacs::file::read_cached(filename);
+        assert(*content2 == "content-2");
+        assert(*content1 == "content-1"); // returned buffers are immutable
+        assert(cache::statistics().misses == 2);
+
+        // size changed, the same mtime
+        write_file(filename, "content-three", mtime + 1);
+        assert(*acmacs::file::read_cached(filename) == "content-three");
+        assert(cache::statistics().misses == 3);
+
+        // inode changed (file replaced by rename), the same size and mtime
+        {
+            const auto replacement = (dir / "replacement.txt").native();
+            write_file(replacement, "content-four!", mtime + 1);
+            const auto old_inode = inode(filename);
+            fs::rename(replacement, filename);
+            assert(inode(filename) != old_inode);
+        }
+        assert(*acmacs::file::read_cached(filename) == "content-four!");
+        assert(cache::statistics().misses == 4);
+        assert(*acmacs::file::read_cached(filename) == "content-four!");
+        assert(cache::statistics().hits == 2);
+        assert(cache::statistics().entries == 1);
+
+        // compressed file content is cached decompressed
+        {
+            const auto compressed = (dir / "content.txt.xz").native();
+            acmacs::file::writer{compressed, acmacs::file::force_compression::no, acmacs::file::backup_file::no} << "decompressed";
+            assert(*acmacs::file::read_cached(compressed) == "decompressed");
+            assert(cache::statistics().memory_used == std::string_view{"content-four!decompressed"}.size());
+        }
+
+        // eviction, evicted buffer stays valid
+        {
+            const auto held = acmacs::file::read_cached(filename);
+            cache::set_memory_budget(15);
+            assert(cache::statistics().entries == 1);
+            assert(cache::statistics().evicted == 1);
+            assert(*held == "content-four!");
+            cache::set_memory_budget(0); // disables caching
+            assert(cache::statistics().entries == 0);
+            assert(*acmacs::file::read_cached(filename) == "content-four!");
+            assert(cache::statistics().entries == 0);
+            cache::set_memory_budget(1024 * 1024);
+        }
+
+        // missing file
+        {
+            bool thrown = false;
+            try {
+                acmacs::file::read_cached((dir / "missing").native());
+            }
+            catch (acmacs::file::not_found&) {
+                thrown = true;
+            }
+            assert(thrown);
+        }
+
+        // settings reload() does not re-read or re-parse unchanged file
+        {
+            cache::clear();
+            const auto settings_file = (dir / "settings.json").native();
+            write_file(settings_file, R"({"init": [{"N": "set", "answer": 42}]})", mtime);
+            TestData settings;
+            settings.load(settings_file);
+            assert(settings.answer() == 42);
+            const auto misses = cache::statistics().misses;
+            settings.reload();
+            assert(cache::statistics().misses == misses);
+            assert(settings.answer() == 42);
+
+            write_file(settings_file, R"({"init": [{"N": "set", "answer": 43}]})", mtime + 1);
+            settings.reload();
+            assert(cache::statistics().misses == misses + 1);
+            assert(settings.answer() == 43);
+        }
+    }
+    catch (std::exception& err) {
+        AD_ERROR("{}", err);
+        exit_code = 1;
+    }
+
+    return exit_code;
+}
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
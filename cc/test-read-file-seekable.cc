@@ -0,0 +1,140 @@
+#ifdef NDEBUG
+#undef NDEBUG
+#endif
+
+#include <cassert>
+#include <cstdlib>
+
+#include "acmacs-base/filesystem.hh"
+#include "acmacs-base/file-writer.hh"
+#include "acmacs-base/xz.hh"
+#include "acmacs-base/log.hh"
+#include "../test/file-test.hh"
+
+// ----------------------------------------------------------------------
+
+static void write_file(const fs::path& filename, std::string_view data)
+{
+    acmacs::file::writer{filename.native(), acmacs::file::force_compression::no, acmacs::file::backup_file::no} << data;
+}
+
+// reads ranges around block boundaries and compares with the source
+static void check_ranges(acmacs::file::seekable_reader& reader, std::string_view source, const std::vector<acmacs::file::xz_block_t>& blocks)
+{
+    assert(reader.size() == source.size());
+    std::string output;
+    for (const auto& block : blocks) {
+        const auto boundary = block.uncompressed_offset;
+        for (const auto& [offset, length] : std::vector<std::pair<size_t, size_t>>{
+                 {boundary, block.uncompressed_size},                          // whole block
+                 {boundary > 10 ? boundary - 10 : 0, 20},                      // crossing boundary
+                 {boundary + 1, block.uncompressed_size / 2},                  // within the block, cached
+                 {boundary + 2, block.uncompressed_size / 3},                  // the same block again
+                 {boundary > 5 ? boundary - 5 : 0, block.uncompressed_size * 2 + 10}, // spanning several blocks
+             }) {
+            reader.read_range(offset, length, output);
+            assert(output == source.substr(offset, length));
+        }
+    }
+    assert(reader.read_range(source.size() - 3, 100) == source.substr(source.size() - 3)); // clipped at the end
+    assert(reader.read_range(source.size(), 10).empty());
+    assert(reader.read_range(source.size() + 100, 10).empty());
+    assert(reader.read_range(7, 0).empty());
+}
+
+// ----------------------------------------------------------------------
+
+int main(int /*argc*/, const char* /*argv*/[])
+{
+    int exit_code = 0;
+    const acmacs::file::test::temp_directory dir{"read-file-seekable"};
+
+    try {
+        const auto source1 = acmacs::file::test::make_source(5 * 1024 * 1024 + 333, 0);
+        const auto source2 = acmacs::file::test::make_source(1024 * 1024 + 77, 1);
+        constexpr size_t block_size = 256 * 1024;
+
+        // written with compression_policy::block_size
+        const auto multi_block = (dir / "multi-block.xz").native();
+        const auto stream1 = acmacs::file::xz_compress(source1, acmacs::file::compression_policy{.speed = acmacs::file::compression_speed::fastest, .threads = 2, .block_size = block_size});
+        write_file(dir / "multi-block.xz.raw", stream1);
+        fs::rename(dir / "multi-block.xz.raw", multi_block);
+        {
+            acmacs::file::seekable_reader reader{multi_block};
+            assert(reader.seekable());
+            assert(reader.number_of_blocks() == (source1.size() + block_size - 1) / block_size);
+            check_ranges(reader, source1, acmacs::file::xz_block_index(stream1));
+        }
+
+        // concatenated streams with stream padding between and after them
+        const auto stream2 = acmacs::file::xz_compress(source2, acmacs::file::compression_policy{.speed = acmacs::file::compression_speed::fastest, .threads = 1, .block_size = block_size / 2});
+        const auto concatenated = (dir / "concatenated.xz").native();
+        write_file(dir / "concatenated.xz.raw", stream1 + std::string(4, '\0') + stream2 + std::string(8, '\0'));
+        fs::rename(dir / "concatenated.xz.raw", concatenated);
+        {
+            acmacs::file::seekable_reader reader{concatenated};
+            const auto blocks = acmacs::file::xz_block_index(acmacs::file::read(concatenated).raw());
+            assert(reader.number_of_blocks() == blocks.size());
+            assert(blocks.size() == acmacs::file::xz_block_index(stream1).size() + acmacs::file::xz_block_index(stream2).size());
+            check_ranges(reader, source1 + source2, blocks);
+            assert(reader.read_range(source1.size() - 100, 200) == (source1 + source2).substr(source1.size() - 100, 200)); // crossing streams
+        }
+
+        // single block xz and other codecs are decompressed completely on the first access
+        for (const char* name : {"single-block.xz", "data.gz", "data.zst", "data.bz2", "data.br", "plain.txt"}) {
+            const auto filename = dir / name;
+            write_file(filename, source2);
+            acmacs::file::seekable_reader reader{filename.native()};
+            assert(reader.seekable() == (std::string_view{name} == "plain.txt"));
+            assert(reader.size() == source2.size());
+            assert(reader.read_range(100, 1000) == source2.substr(100, 1000));
+            assert(reader.read_range(source2.size() - 10, 1000) == source2.substr(source2.size() - 10));
+        }
+
+        // written by xz -T (multi-threaded xz utility), skipped if xz is not available
+        const auto xz_utility = dir / "xz-utility.xz";
+        write_file(dir / "xz-utility.txt", source1);
+        if (std::system(fmt::format("xz -T2 --block-size={} -1 -c '{}' > '{}' 2>/dev/null", block_size, (dir / "xz-utility.txt").native(), xz_utility.native()).c_str()) == 0) {
+            acmacs::file::seekable_reader reader{xz_utility.native()};
+            assert(reader.seekable());
+            const auto blocks = acmacs::file::xz_block_index(acmacs::file::read(xz_utility.native()).raw());
+            assert(reader.number_of_blocks() == blocks.size());
+            assert(blocks.size() > 1);
+            check_ranges(reader, source1, blocks);
+        }
+        else
+            AD_WARNING("xz utility is not available, xz -T output is not checked");
+
+        // broken block is reported, reader remains usable
+        {
+            auto broken_data = stream1;
+            const auto blocks = acmacs::file::xz_block_index(stream1);
+            broken_data[blocks[1].compressed_offset + blocks[1].compressed_size / 2] ^= 0x55;
+            const auto broken = dir / "broken.xz";
+            write_file(dir / "broken.xz.raw", broken_data);
+            fs::rename(dir / "broken.xz.raw", broken);
+            acmacs::file::seekable_reader reader{broken.native()};
+            assert(reader.read_range(10, 100) == source1.substr(10, 100));
+            bool thrown = false;
+            try {
+                reader.read_range(blocks[1].uncompressed_offset + 10, 100);
+            }
+            catch (std::exception&) {
+                thrown = true;
+            }
+            assert(thrown);
+            assert(reader.read_range(20, 100) == source1.substr(20, 100));
+        }
+    }
+    catch (std::exception& err) {
+        AD_ERROR("{}", err);
+        exit_code = 1;
+    }
+
+    return exit_code;
+}
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
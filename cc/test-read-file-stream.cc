@@ -0,0 +1,116 @@
+#ifdef NDEBUG
+#undef NDEBUG
+#endif
+
+#include <cassert>
+#include <filesystem>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "acmacs-base/file-writer.hh"
+#include "acmacs-base/log.hh"
+#include "../test/file-test.hh"
+
+// ----------------------------------------------------------------------
+
+// compressed files are read through a file descriptor (decompressed on the fly) and as stdin with read_access("-"),
+// raw() of stdin must be the same as raw() of the file
+
+static std::string read_fd(const std::filesystem::path& filename, size_t chunk_size)
+{
+    const int fd = ::open(filename.c_str(), O_RDONLY);
+    assert(fd >= 0);
+    try {
+        auto result = acmacs::file::read_from_file_descriptor(fd, chunk_size);
+        ::close(fd);
+        return result;
+    }
+    catch (std::exception&) {
+        ::close(fd);
+        throw;
+    }
+}
+
+// stdin is read by read_access("-") on first use, func is called while stdin is redirected
+template <typename F> static auto with_stdin(const std::filesystem::path& filename, F&& func)
+{
+    const int saved_stdin = ::dup(0);
+    const int fd = ::open(filename.c_str(), O_RDONLY);
+    assert(saved_stdin >= 0 && fd >= 0);
+    ::dup2(fd, 0);
+    ::close(fd);
+    auto result = func();
+    ::dup2(saved_stdin, 0);
+    ::close(saved_stdin);
+    return result;
+}
+
+static acmacs::file::read_access read_as_stdin(const std::filesystem::path& filename)
+{
+    return with_stdin(filename, []() {
+        auto result = acmacs::file::read("-");
+        result.raw(); // read while redirected
+        return result;
+    });
+}
+
+// ----------------------------------------------------------------------
+
+int main(int /*argc*/, const char* /*argv*/[])
+{
+    int exit_code = 0;
+    const acmacs::file::test::temp_directory dir{"read-file-stream"};
+
+    try {
+        const auto source = acmacs::file::test::make_source(3 * 1024 * 1024 + 17, 1);
+
+        for (const char* name : {"plain.txt", "data.gz", "data.xz", "data.bz2", "data.br", "data.zst"}) {
+            const auto filename = dir / name;
+            acmacs::file::writer{filename.string(), acmacs::file::force_compression::no, acmacs::file::backup_file::no} << source;
+
+            assert(read_fd(filename, 1024 * 1024) == source);
+            assert(read_fd(filename, 1000) == source); // many chunks, each smaller than decoder output
+
+            const auto file = acmacs::file::read(filename.string());
+            auto piped = read_as_stdin(filename);
+            assert(piped.raw() == file.raw());
+            assert(static_cast<std::string>(piped) == source);
+            assert(static_cast<std::string>(std::move(piped)) == source);
+            // raw data not requested: decompressed on the fly
+            assert(with_stdin(filename, []() { return static_cast<std::string>(acmacs::file::read("-")); }) == source);
+
+            // truncated compressed input is reported
+            if (std::string_view{name} != "plain.txt") {
+                const auto truncated = dir / fmt::format("{}.truncated", name); // plain writer, no suffix recognized
+                acmacs::file::writer{truncated.string(), acmacs::file::force_compression::no, acmacs::file::backup_file::no} << file.raw().substr(0, file.raw().size() / 2);
+                bool thrown = false;
+                try {
+                    read_fd(truncated, 1000);
+                }
+                catch (std::exception&) {
+                    thrown = true;
+                }
+                assert(thrown);
+            }
+        }
+
+        // input shorter than any signature
+        {
+            const auto filename = dir / "short.txt";
+            acmacs::file::writer{filename.string(), acmacs::file::force_compression::no, acmacs::file::backup_file::no} << "{}";
+            assert(read_fd(filename, 1000) == "{}");
+            assert(read_as_stdin(filename).raw() == "{}");
+        }
+    }
+    catch (std::exception& err) {
+        AD_ERROR("{}", err);
+        exit_code = 1;
+    }
+
+    return exit_code;
+}
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
@@ -276,10 +276,11 @@ std::pair<date::year_month_day, date::year_month_day> acmacs::time_series::v2::s
     };
 
     std::vector<std::pair<date::year_month_day, date::year_month_day>> chunks;
-    auto it = std::begin(stat.counter());
+    const auto entries = stat.sorted_by_key();
+    auto it = std::begin(entries);
     auto prev{it->first};
     auto cur = prev, start = prev;
-    for (++it; it != std::end(stat.counter()); ++it) {
+    for (++it; it != std::end(entries); ++it) {
         cur = it->first;
         if (distance(prev, cur) > 2) {
             chunks.emplace_back(start, next(prev));
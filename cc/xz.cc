@@ -1,4 +1,6 @@
 #include <stdexcept>
+#include <algorithm>
+#include <cstdlib>
 
 #pragma GCC diagnostic push
 #ifdef __clang__
@@ -21,59 +23,235 @@
 
 // ----------------------------------------------------------------------
 
-constexpr ssize_t sXzBufSize = 409600;
-static std::string process(lzma_stream* strm, std::string_view input);
+constexpr size_t sXzBufSize = 409600;
+// sizes recorded in the index are not trusted beyond that ratio (LZMA2 reaches about 7000:1 on zeros), corrupt index must not force huge allocation
+constexpr size_t xz_max_ratio = 16384;
+static void process(lzma_stream* strm, std::string_view input, std::string& output, size_t initial_size);
 
 // ----------------------------------------------------------------------
 
-std::string acmacs::file::xz_compress(std::string_view input)
+static inline uint32_t xz_threads(uint32_t threads)
 {
+    if (threads == 0)
+        threads = lzma_cputhreads();
+    return threads == 0 ? 1 : threads;
+}
+
+// ----------------------------------------------------------------------
+
+std::string acmacs::file::xz_compress(std::string_view input, const compression_policy& policy)
+{
+    static_assert(xz_preset_extreme == LZMA_PRESET_EXTREME);
+    const auto preset = xz_preset(policy);
+    constexpr uint64_t min_block_size = 16 * 1024 * 1024;
+
     lzma_stream strm = LZMA_STREAM_INIT; /* alloc and init lzma_stream struct */
-    if (lzma_easy_encoder(&strm, 9 | LZMA_PRESET_EXTREME, LZMA_CHECK_CRC64) != LZMA_OK) {
+    lzma_mt mt{};
+    mt.preset = preset;
+    mt.check = LZMA_CHECK_CRC64;
+    mt.threads = xz_threads(policy.threads);
+    if (policy.block_size > 0 || (mt.threads > 1 && input.size() > min_block_size)) {
+        mt.block_size = policy.block_size > 0 ? policy.block_size : std::max<uint64_t>(min_block_size, (input.size() + mt.threads - 1) / mt.threads);
+        mt.threads = std::max(1u, std::min(mt.threads, static_cast<uint32_t>((input.size() + mt.block_size - 1) / mt.block_size)));
+        // each thread of preset 9 encoder needs several hundred MiB, do not let it go beyond half of ram
+        if (const auto physmem = lzma_physmem(); physmem > 0) {
+            while (mt.threads > 1 && lzma_stream_encoder_mt_memusage(&mt) > physmem / 2)
+                --mt.threads;
+        }
+    }
+    else
+        mt.threads = 1;
+
+    if (mt.block_size > 0) { // single threaded mt encoder still splits into blocks (seekable output)
+        if (lzma_stream_encoder_mt(&strm, &mt) != LZMA_OK)
+            throw std::runtime_error("lzma compression failed 1");
+    }
+    else if (lzma_easy_encoder(&strm, preset, LZMA_CHECK_CRC64) != LZMA_OK) {
         throw std::runtime_error("lzma compression failed 1");
     }
-    return process(&strm, input);
+    std::string output;
+    process(&strm, input, output, std::max(input.size() / 4, sXzBufSize));
+    return output;
 
 } // acmacs::file::xz_compress
 
 // ----------------------------------------------------------------------
 
-std::string acmacs::file::xz_decompress(std::string_view input)
+std::string acmacs::file::xz_decompress(std::string_view input, uint32_t threads)
+{
+    std::string output;
+    xz_decompress(input, output, threads);
+    return output;
+
+} // acmacs::file::xz_decompress
+
+// ----------------------------------------------------------------------
+
+void acmacs::file::xz_decompress(std::string_view input, std::string& output, [[maybe_unused]] uint32_t threads)
 {
+    constexpr uint32_t flags = LZMA_TELL_UNSUPPORTED_CHECK | LZMA_CONCATENATED;
     lzma_stream strm = LZMA_STREAM_INIT; /* alloc and init lzma_stream struct */
-    if (lzma_stream_decoder(&strm, UINT64_MAX, LZMA_TELL_UNSUPPORTED_CHECK | LZMA_CONCATENATED) != LZMA_OK) {
+#if LZMA_VERSION >= 50040002
+    // blocks are decoded in parallel only if the encoder stored their sizes in headers (multi-threaded encoder does it)
+    if (const auto num_threads = xz_threads(threads); num_threads > 1) {
+        lzma_mt mt{};
+        mt.flags = flags;
+        mt.threads = num_threads;
+        mt.memlimit_threading = lzma_physmem() > 0 ? lzma_physmem() / 4 : UINT64_MAX; // beyond that the decoder falls back to single thread
+        mt.memlimit_stop = UINT64_MAX;
+        if (lzma_stream_decoder_mt(&strm, &mt) != LZMA_OK)
+            throw std::runtime_error("lzma decompression failed 1");
+    }
+    else
+#endif
+    if (lzma_stream_decoder(&strm, UINT64_MAX, flags) != LZMA_OK) {
         throw std::runtime_error("lzma decompression failed 1");
     }
-    return process(&strm, input);
+    // one extra byte lets decoder reach LZMA_STREAM_END without growing output if the size is known
+    const auto size = xz_uncompressed_size(input);
+    process(&strm, input, output, size > 0 ? size + 1 : std::max(input.size() * 4, sXzBufSize));
 
 } // acmacs::file::xz_decompress
 
+// ----------------------------------------------------------------------
+
+// walks concatenated streams backwards, each one ends with the footer pointing to its index, streams may be separated by padding,
+// calls func(index, stream_offset, footer) for each stream (last stream first), returns false if input is not a valid xz file
+template <typename Func> static bool for_each_xz_index(std::string_view input, Func func)
+{
+    const auto* data = reinterpret_cast<const uint8_t*>(input.data());
+    size_t pos = input.size();
+    while (pos > 0) {
+        if (pos < 2 * LZMA_STREAM_HEADER_SIZE)
+            return false;
+        if (pos % 4 == 0 && data[pos - 1] == 0 && data[pos - 2] == 0 && data[pos - 3] == 0 && data[pos - 4] == 0) { // stream padding
+            pos -= 4;
+            continue;
+        }
+        lzma_stream_flags footer;
+        if (lzma_stream_footer_decode(&footer, data + pos - LZMA_STREAM_HEADER_SIZE) != LZMA_OK)
+            return false;
+        const size_t index_end = pos - LZMA_STREAM_HEADER_SIZE;
+        if (footer.backward_size > index_end)
+            return false;
+        lzma_index* index = nullptr;
+        uint64_t memlimit = UINT64_MAX;
+        size_t index_pos = index_end - footer.backward_size;
+        if (lzma_index_buffer_decode(&index, &memlimit, nullptr, data, &index_pos, index_end) != LZMA_OK)
+            return false;
+        const auto stream_size = lzma_index_stream_size(index);
+        if (stream_size > pos) {
+            lzma_index_end(index, nullptr);
+            return false;
+        }
+        pos -= stream_size;
+        func(index, pos, footer);
+        lzma_index_end(index, nullptr);
+    }
+    return true;
+}
+
+// ----------------------------------------------------------------------
+
+size_t acmacs::file::xz_uncompressed_size(std::string_view input)
+{
+    uint64_t total = 0;
+    if (!for_each_xz_index(input, [&total](const lzma_index* index, size_t, const lzma_stream_flags&) { total += lzma_index_uncompressed_size(index); }))
+        return 0;
+    if (total > static_cast<uint64_t>(input.size()) * xz_max_ratio)
+        return 0;
+    return static_cast<size_t>(total);
+
+} // acmacs::file::xz_uncompressed_size
+
+// ----------------------------------------------------------------------
+
+std::vector<acmacs::file::xz_block_t> acmacs::file::xz_block_index(std::string_view input)
+{
+    std::vector<std::vector<xz_block_t>> streams; // last stream first
+    const auto valid = for_each_xz_index(input, [&streams](const lzma_index* index, size_t stream_offset, const lzma_stream_flags& footer) {
+        auto& blocks = streams.emplace_back();
+        lzma_index_iter iter;
+        lzma_index_iter_init(&iter, index);
+        while (!lzma_index_iter_next(&iter, LZMA_INDEX_ITER_NONEMPTY_BLOCK)) {
+            blocks.push_back(xz_block_t{.compressed_offset = stream_offset + static_cast<size_t>(iter.block.compressed_file_offset),
+                                        .compressed_size = static_cast<size_t>(iter.block.total_size),
+                                        .uncompressed_offset = static_cast<size_t>(iter.block.uncompressed_file_offset),
+                                        .uncompressed_size = static_cast<size_t>(iter.block.uncompressed_size),
+                                        .check = static_cast<uint32_t>(footer.check)});
+        }
+    });
+    std::vector<xz_block_t> result;
+    if (!valid)
+        return result;
+    for (const auto& stream : streams) {
+        if (std::any_of(std::begin(stream), std::end(stream), [](const auto& block) { return block.uncompressed_size > block.compressed_size * xz_max_ratio; }))
+            return result; // implausible index
+    }
+    size_t uncompressed_offset = 0;
+    for (auto stream = streams.rbegin(); stream != streams.rend(); ++stream) {
+        for (auto block : *stream) {
+            block.uncompressed_offset += uncompressed_offset; // offsets in the index are relative to the stream
+            result.push_back(block);
+        }
+        if (!stream->empty())
+            uncompressed_offset = result.back().uncompressed_offset + result.back().uncompressed_size;
+    }
+    return result;
+
+} // acmacs::file::xz_block_index
+
+// ----------------------------------------------------------------------
+
+void acmacs::file::xz_decompress_block(std::string_view input, const xz_block_t& block_entry, char* output)
+{
+    if ((block_entry.compressed_offset + block_entry.compressed_size) > input.size())
+        throw std::runtime_error("lzma block decompression failed: block is beyond the end of input");
+    const auto* data = reinterpret_cast<const uint8_t*>(input.data()) + block_entry.compressed_offset;
+
+    lzma_filter filters[LZMA_FILTERS_MAX + 1];
+    lzma_block block{};
+    block.version = 0;
+    block.check = static_cast<lzma_check>(block_entry.check);
+    block.filters = filters;
+    block.header_size = lzma_block_header_size_decode(data[0]);
+    if (block.header_size > block_entry.compressed_size || lzma_block_header_decode(&block, nullptr, data) != LZMA_OK)
+        throw std::runtime_error("lzma block decompression failed: invalid block header");
+
+    size_t in_pos = block.header_size, out_pos = 0;
+    const auto res = lzma_block_buffer_decode(&block, nullptr, data, &in_pos, block_entry.compressed_size, reinterpret_cast<uint8_t*>(output), &out_pos, block_entry.uncompressed_size);
+    for (size_t filter_no = 0; filters[filter_no].id != LZMA_VLI_UNKNOWN; ++filter_no)
+        free(filters[filter_no].options); // allocated by lzma_block_header_decode
+    if (res != LZMA_OK || out_pos != block_entry.uncompressed_size)
+        throw std::runtime_error("lzma block decompression failed: " + std::to_string(res));
+
+} // acmacs::file::xz_decompress_block
+
 // ======================================================================
 
-static std::string process(lzma_stream* strm, std::string_view input)
+static void process(lzma_stream* strm, std::string_view input, std::string& output, size_t initial_size)
 {
     strm->next_in = reinterpret_cast<const uint8_t*>(input.data());
     strm->avail_in = input.size();
-    std::string output(sXzBufSize, ' ');
-    ssize_t offset = 0;
+    output.resize(initial_size);
+    size_t offset = 0;
     for (;;) {
-        strm->next_out = reinterpret_cast<uint8_t*>(&*(output.begin() + offset));
-        strm->avail_out = sXzBufSize;
+        if (offset == output.size())
+            output.resize(output.size() * 2);
+        strm->next_out = reinterpret_cast<uint8_t*>(output.data() + offset);
+        strm->avail_out = output.size() - offset;
         auto const r = lzma_code(strm, LZMA_FINISH);
+        offset = output.size() - strm->avail_out;
         if (r == LZMA_STREAM_END) {
-            output.resize(static_cast<size_t>(offset + sXzBufSize) - strm->avail_out);
+            output.resize(offset);
             break;
         }
-        else if (r == LZMA_OK) {
-            offset += sXzBufSize;
-            output.resize(static_cast<size_t>(offset + sXzBufSize));
-        }
-        else {
+        else if (r != LZMA_OK) {
+            lzma_end(strm);
             throw std::runtime_error("lzma decompression failed 2");
         }
     }
     lzma_end(strm);
-    return output;
 }
 
 // ----------------------------------------------------------------------
@@ -1,8 +1,12 @@
 #pragma once
 
+#include <cstdint>
 #include <cstring>
 #include <string>
 #include <string_view>
+#include <vector>
+
+#include "acmacs-base/compression.hh"
 
 // ----------------------------------------------------------------------
 
@@ -22,8 +26,40 @@ namespace acmacs::file
 
       // ----------------------------------------------------------------------
 
-    std::string xz_compress(std::string_view input);
-    std::string xz_decompress(std::string_view input);
+      // presets: fastest - 0, balanced - 6, best - 9e, explicit level is used as preset clamped to 0-9
+    constexpr compression_levels xz_levels{.fastest = 0, .balanced = 6, .best = 9, .min = 0, .max = 9};
+    constexpr uint32_t xz_preset_extreme = UINT32_C(1) << 31; // LZMA_PRESET_EXTREME
+    constexpr uint32_t xz_preset(const compression_policy& policy)
+    {
+        const auto preset = static_cast<uint32_t>(policy.level_for(xz_levels));
+        return (policy.level < 0 && policy.speed == compression_speed::best) ? (preset | xz_preset_extreme) : preset;
+    }
+      // with more than one thread input larger than 16MiB is split into blocks compressed in parallel, otherwise output is a single block stream
+      // multi-block output is a standard xz stream readable by single threaded decoder
+    std::string xz_compress(std::string_view input, const compression_policy& policy = default_compression_policy());
+      // threads: 0 - use all cpus, blocks of multi-block streams are decoded in parallel (liblzma 5.4+)
+    std::string xz_decompress(std::string_view input, uint32_t threads = 0);
+      // decompresses into output replacing its content, capacity of output is reused
+    void xz_decompress(std::string_view input, std::string& output, uint32_t threads = 0);
+      // uncompressed size of all streams recorded in the xz indexes, 0 if indexes cannot be decoded or the size is implausible for the input size
+    size_t xz_uncompressed_size(std::string_view input);
+
+      // ----------------------------------------------------------------------
+      // random access: blocks are independent, each one can be decompressed without decompressing preceding ones
+
+    struct xz_block_t
+    {
+        size_t compressed_offset;   // of the block header in the input
+        size_t compressed_size;     // header, data, padding and check
+        size_t uncompressed_offset; // in the concatenation of all streams
+        size_t uncompressed_size;
+        uint32_t check;             // lzma_check of the stream
+    };
+
+      // blocks of all streams in the input order taken from the xz indexes, empty if indexes cannot be decoded or sizes are implausible
+    std::vector<xz_block_t> xz_block_index(std::string_view input);
+      // decompresses one block listed by xz_block_index(), output must have room for block.uncompressed_size bytes
+    void xz_decompress_block(std::string_view input, const xz_block_t& block, char* output);
 
 } // namespace acmacs::file
 
@@ -0,0 +1,114 @@
+#include <stdexcept>
+#include <algorithm>
+#include <thread>
+#include <zstd.h>
+
+#include "acmacs-base/zstd.hh"
+
+// ----------------------------------------------------------------------
+
+constexpr size_t sZstdBufSize = 409600;
+
+// content size from the frame header is not trusted beyond that ratio (an RLE block of 128KiB takes 4 bytes), corrupt
+// header must not force huge allocation, output grows geometrically above the cap
+constexpr size_t zstd_max_ratio = 32768;
+
+// ----------------------------------------------------------------------
+
+std::string acmacs::file::zstd_compress(std::string_view input, const compression_policy& policy)
+{
+    const auto threads = policy.threads == 0 ? std::thread::hardware_concurrency() : policy.threads;
+
+    ZSTD_CCtx* ctx = ZSTD_createCCtx();
+    if (!ctx)
+        throw std::runtime_error("zstd compression failed during initialization");
+    try {
+        if (const auto res = ZSTD_CCtx_setParameter(ctx, ZSTD_c_compressionLevel, policy.level_for(zstd_levels)); ZSTD_isError(res))
+            throw std::runtime_error(std::string{"zstd compression failed: "} + ZSTD_getErrorName(res));
+        ZSTD_CCtx_setParameter(ctx, ZSTD_c_checksumFlag, 1);
+        if (threads > 1)
+            ZSTD_CCtx_setParameter(ctx, ZSTD_c_nbWorkers, static_cast<int>(threads)); // fails if libzstd is built without multi-threading, compression is then done in the calling thread
+        ZSTD_CCtx_setPledgedSrcSize(ctx, input.size()); // content size is stored in the frame header and used by zstd_decompress
+
+        std::string output(std::max(input.size() / 4, sZstdBufSize), ' ');
+        ZSTD_inBuffer in{input.data(), input.size(), 0};
+        ZSTD_outBuffer out{output.data(), output.size(), 0};
+        for (;;) {
+            const auto remaining = ZSTD_compressStream2(ctx, &out, &in, ZSTD_e_end);
+            if (ZSTD_isError(remaining))
+                throw std::runtime_error(std::string{"zstd compression failed: "} + ZSTD_getErrorName(remaining));
+            if (remaining == 0)
+                break;
+            if (out.pos == out.size) {
+                output.resize(output.size() * 2);
+                out.dst = output.data();
+                out.size = output.size();
+            }
+        }
+        output.resize(out.pos);
+        ZSTD_freeCCtx(ctx);
+        return output;
+    }
+    catch (std::exception&) {
+        ZSTD_freeCCtx(ctx);
+        throw;
+    }
+
+} // acmacs::file::zstd_compress
+
+// ----------------------------------------------------------------------
+
+std::string acmacs::file::zstd_decompress(std::string_view input)
+{
+    std::string output;
+    zstd_decompress(input, output);
+    return output;
+
+} // acmacs::file::zstd_decompress
+
+// ----------------------------------------------------------------------
+
+void acmacs::file::zstd_decompress(std::string_view input, std::string& output)
+{
+    ZSTD_DCtx* ctx = ZSTD_createDCtx();
+    if (!ctx)
+        throw std::runtime_error("zstd decompression failed during initialization");
+    try {
+        // content size of the first frame (single frame for data produced by zstd_compress), one extra byte avoids growing output at the end
+        if (const auto content_size = ZSTD_getFrameContentSize(input.data(), input.size()); content_size != ZSTD_CONTENTSIZE_UNKNOWN && content_size != ZSTD_CONTENTSIZE_ERROR)
+            output.resize(static_cast<size_t>(std::min<unsigned long long>(content_size, static_cast<unsigned long long>(input.size()) * zstd_max_ratio)) + 1);
+        else
+            output.resize(std::max(input.size() * 4, sZstdBufSize));
+
+        ZSTD_inBuffer in{input.data(), input.size(), 0};
+        ZSTD_outBuffer out{output.data(), output.size(), 0};
+        size_t last_res = 0;
+        while (in.pos < in.size || out.pos == out.size) {
+            if (out.pos == out.size) {
+                output.resize(output.size() * 2);
+                out.dst = output.data();
+                out.size = output.size();
+            }
+            const auto in_pos = in.pos, out_pos = out.pos;
+            last_res = ZSTD_decompressStream(ctx, &out, &in);
+            if (ZSTD_isError(last_res))
+                throw std::runtime_error(std::string{"zstd decompression failed: "} + ZSTD_getErrorName(last_res));
+            if (in.pos == in_pos && out.pos == out_pos && out.pos < out.size)
+                break; // no progress
+        }
+        if (last_res != 0)
+            throw std::runtime_error("zstd decompression failed: unexpected end of input");
+        output.resize(out.pos);
+        ZSTD_freeDCtx(ctx);
+    }
+    catch (std::exception&) {
+        ZSTD_freeDCtx(ctx);
+        throw;
+    }
+
+} // acmacs::file::zstd_decompress
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+#include "acmacs-base/compression.hh"
+
+// ----------------------------------------------------------------------
+
+namespace acmacs::file
+{
+    namespace zstd_internal
+    {
+        constexpr const unsigned char sZstdSig[] = { 0x28, 0xB5, 0x2F, 0xFD };
+
+    } // namespace zstd_internal
+
+      // ----------------------------------------------------------------------
+
+    inline bool zstd_compressed(const char* input) { return std::memcmp(input, zstd_internal::sZstdSig, sizeof(zstd_internal::sZstdSig)) == 0; }
+
+      // levels: fastest - 1, balanced - 6, best - 19, explicit level is clamped to 1-22
+    constexpr compression_levels zstd_levels{.fastest = 1, .balanced = 6, .best = 19, .min = 1, .max = 22};
+      // libzstd without multi-threading support always compresses in the calling thread
+    std::string zstd_compress(std::string_view input, const compression_policy& policy = default_compression_policy());
+    std::string zstd_decompress(std::string_view input);
+      // decompresses into output replacing its content, capacity of output is reused
+    void zstd_decompress(std::string_view input, std::string& output);
+
+} // namespace acmacs::file
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End:
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <unistd.h>
+
+#include "acmacs-base/filesystem.hh"
+#include "acmacs-base/fmt.hh"
+
+// ----------------------------------------------------------------------
+// helpers for tests of reading, writing, compressing and caching files
+// (kept out of cc/ so that it is not installed with the library headers)
+
+namespace acmacs::file::test
+{
+    // json-like lines, compressible but not trivially, different seeds give different data
+    inline std::string make_source(size_t size, size_t seed = 0)
+    {
+        std::string source;
+        source.reserve(size);
+        for (size_t line_no = 0; source.size() < size; ++line_no)
+            source.append(fmt::format("{{\"N\": \"A/TEXAS/{}/2012\", \"c\": [{}, {:.6f}]}},\n", (line_no * 7 + seed) % 50021, (line_no * 2654435761u + seed) % 100000, static_cast<double>(line_no) / 3.0));
+        source.resize(size);
+        return source;
+    }
+
+    // directory test-<name>-<pid> in the system temp directory, removed with its content on destruction
+    class temp_directory
+    {
+      public:
+        temp_directory(std::string_view name) : path_{fs::temp_directory_path() / fmt::format("test-{}-{}", name, getpid())} { fs::create_directories(path_); }
+        ~temp_directory()
+        {
+            std::error_code ec;
+            fs::remove_all(path_, ec);
+        }
+        temp_directory(const temp_directory&) = delete;
+        temp_directory& operator=(const temp_directory&) = delete;
+
+        const fs::path& path() const { return path_; }
+        operator const fs::path&() const { return path_; }
+        fs::path operator/(std::string_view name) const { return path_ / name; }
+
+      private:
+        fs::path path_;
+    };
+
+} // namespace acmacs::file::test
+
+// ----------------------------------------------------------------------
+/// Local Variables:
+/// eval: (if (fboundp 'eu-rename-buffer) (eu-rename-buffer))
+/// End: